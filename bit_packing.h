@@ -0,0 +1,151 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace search_server_index {
+
+// blocks of kPackedBlockSize integers are packed with the same bit width
+// value i of a block goes to lane i % 4, every lane is a stream of bits and word j of lane l is stored at 4 * j + l,
+// so four values are packed and unpacked with the same shifts and one SSE2 register handles a whole row
+static constexpr size_t kPackedBlockSize = 128;
+static constexpr size_t kPackedLaneCount = 4;
+
+// number of bits needed to store the value
+inline uint32_t GetRequiredBits(uint32_t value) {
+    uint32_t bits = 0;
+
+    while (value != 0) {
+        ++bits;
+        value >>= 1;
+    }
+
+    return bits;
+}
+
+// packed block takes 4 * bits words
+inline size_t GetPackedBlockWordCount(uint32_t bits) {
+    return kPackedLaneCount * bits;
+}
+
+// values must fit into bits, output must have room for GetPackedBlockWordCount(bits) words
+inline void PackBlock(const uint32_t* values, uint32_t bits, uint32_t* output) {
+    if (bits == 0) {
+        return;
+    }
+
+    for (size_t lane = 0; lane < kPackedLaneCount; ++lane) {
+        uint32_t* word = output + lane;
+        uint32_t shift = 0;
+        *word = 0;
+
+        for (size_t i = lane; i < kPackedBlockSize; i += kPackedLaneCount) {
+            *word |= values[i] << shift;
+
+            if (shift + bits >= 32) {
+                // the rest of the value goes to the next word of the lane
+                const uint32_t written_bits = 32 - shift;
+                shift = shift + bits - 32;
+
+                if (i + kPackedLaneCount < kPackedBlockSize || shift > 0) {
+                    word += kPackedLaneCount;
+                    *word = shift > 0 ? values[i] >> written_bits : 0;
+                }
+            } else {
+                shift += bits;
+            }
+        }
+    }
+}
+
+inline void UnpackBlockScalar(const uint32_t* input, uint32_t bits, uint32_t* values) {
+    if (bits == 0) {
+        for (size_t i = 0; i < kPackedBlockSize; ++i) {
+            values[i] = 0;
+        }
+
+        return;
+    }
+
+    const uint32_t mask = bits == 32 ? ~0u : (1u << bits) - 1;
+
+    for (size_t lane = 0; lane < kPackedLaneCount; ++lane) {
+        size_t word = lane;
+        uint32_t shift = 0;
+
+        for (size_t i = lane; i < kPackedBlockSize; i += kPackedLaneCount) {
+            uint32_t value = input[word] >> shift;
+
+            if (shift + bits >= 32) {
+                const uint32_t read_bits = 32 - shift;
+                shift = shift + bits - 32;
+                word += kPackedLaneCount;
+
+                if (shift > 0) {
+                    value |= input[word] << read_bits;
+                }
+            } else {
+                shift += bits;
+            }
+
+            values[i] = value & mask;
+        }
+    }
+}
+
+#if defined(__SSE2__)
+
+// the same as the scalar version, four lanes at a time
+inline void UnpackBlockSse2(const uint32_t* input, uint32_t bits, uint32_t* values) {
+    if (bits == 0) {
+        UnpackBlockScalar(input, bits, values);
+        return;
+    }
+
+    const __m128i mask = _mm_set1_epi32(bits == 32 ? -1 : static_cast<int>((1u << bits) - 1));
+
+    const __m128i* words = reinterpret_cast<const __m128i*>(input);
+    __m128i* output = reinterpret_cast<__m128i*>(values);
+
+    __m128i word = _mm_loadu_si128(words++);
+    uint32_t shift = 0;
+
+    for (size_t row = 0; row < kPackedBlockSize / kPackedLaneCount; ++row) {
+        __m128i value = _mm_srl_epi32(word, _mm_cvtsi32_si128(static_cast<int>(shift)));
+
+        if (shift + bits >= 32) {
+            const uint32_t read_bits = 32 - shift;
+            shift = shift + bits - 32;
+
+            // the last word of the block is not followed by another one
+            if (shift > 0 || row + 1 < kPackedBlockSize / kPackedLaneCount) {
+                word = _mm_loadu_si128(words++);
+            }
+
+            if (shift > 0) {
+                value = _mm_or_si128(value, _mm_sll_epi32(word, _mm_cvtsi32_si128(static_cast<int>(read_bits))));
+            }
+        } else {
+            shift += bits;
+        }
+
+        _mm_storeu_si128(output++, _mm_and_si128(value, mask));
+    }
+}
+
+#endif
+
+// values must have room for kPackedBlockSize integers
+inline void UnpackBlock(const uint32_t* input, uint32_t bits, uint32_t* values) {
+#if defined(__SSE2__)
+    UnpackBlockSse2(input, bits, values);
+#else
+    UnpackBlockScalar(input, bits, values);
+#endif
+}
+
+} // namespace search_server_index
@@ -0,0 +1,112 @@
+#include "concurrent_search_server.h"
+
+ConcurrentSearchServer::ConcurrentSearchServer(const std::string_view stop_words)
+    : servers_{SearchServer(stop_words), SearchServer(stop_words)} {
+}
+
+ConcurrentSearchServer::ConcurrentSearchServer(const std::string& stop_words)
+    : servers_{SearchServer(stop_words), SearchServer(stop_words)} {
+}
+
+bool ConcurrentSearchServer::AddDocument(int document_id, const std::string_view document,
+                                         DocumentStatus status, const std::vector<int>& ratings) {
+    return Write([&](SearchServer& server) {
+        return server.AddDocument(document_id, document, status, ratings);
+    });
+}
+
+bool ConcurrentSearchServer::AddDocumentKeepingText(int document_id, std::string document,
+                                                    DocumentStatus status, const std::vector<int>& ratings) {
+    const auto text = std::make_shared<const std::string>(std::move(document));
+
+    return Write([&](SearchServer& server) {
+        return server.AddDocumentKeepingText(document_id, *text, text, status, ratings);
+    });
+}
+
+void ConcurrentSearchServer::AddDocuments(const std::vector<SearchServer::NewDocument>& documents) {
+    AddDocuments(std::execution::seq, documents);
+}
+
+void ConcurrentSearchServer::RemoveDocument(const int document_id) {
+    Write([document_id](SearchServer& server) {
+        server.RemoveDocument(document_id);
+        return true;
+    });
+}
+
+void ConcurrentSearchServer::SetQueryMode(SearchServer::QueryMode query_mode) {
+    Write([query_mode](SearchServer& server) {
+        server.SetQueryMode(query_mode);
+        return true;
+    });
+}
+
+void ConcurrentSearchServer::CompactSegments() {
+    Write([](SearchServer& server) {
+        server.CompactSegments();
+        return true;
+    });
+}
+
+void ConcurrentSearchServer::LoadSnapshot(const std::string& path) {
+    // both copies are loaded before either is replaced, so a failed load changes nothing
+    std::array<SearchServer, 2> servers{SearchServer::LoadSnapshot(path), SearchServer::LoadSnapshot(path)};
+    int server_index = 0;
+
+    Write([&servers, &server_index](SearchServer& server) {
+        server = std::move(servers[server_index++]);
+        return true;
+    });
+}
+
+int ConcurrentSearchServer::GetDocumentCount() const {
+    return Read([](const SearchServer& server) {
+        return server.GetDocumentCount();
+    });
+}
+
+std::vector<Document> ConcurrentSearchServer::FindTopDocuments(const std::string_view raw_query,
+                                                               const DocumentStatus& desired_status) const {
+    return Read([raw_query, desired_status](const SearchServer& server) {
+        return server.FindTopDocuments(raw_query, desired_status);
+    });
+}
+
+// words of the result are views of the words stored by the copy, they stay valid while the document is in the server
+std::tuple<std::vector<std::string_view>, DocumentStatus> ConcurrentSearchServer::MatchDocument(const std::string_view raw_query,
+                                                                                                const int document_id) const {
+    return Read([raw_query, document_id](const SearchServer& server) {
+        return server.MatchDocument(raw_query, document_id);
+    });
+}
+
+void ConcurrentSearchServer::SwitchVersion() {
+    const int version_index = version_index_.load();
+
+    // readers of the previous switch could still be at the other version
+    while (read_indicators_[1 - version_index].reader_count.load() != 0) {
+        std::this_thread::yield();
+    }
+
+    version_index_.store(1 - version_index);
+
+    while (read_indicators_[version_index].reader_count.load() != 0) {
+        std::this_thread::yield();
+    }
+} // SwitchVersion
+
+ConcurrentSearchServer::ReadGuard::ReadGuard(const ConcurrentSearchServer& server): server_(server) {
+    version_index_ = server_.version_index_.load();
+    ++server_.read_indicators_[version_index_].reader_count;
+
+    reading_server_ = &server_.servers_[server_.reading_server_index_.load()];
+}
+
+ConcurrentSearchServer::ReadGuard::~ReadGuard() {
+    --server_.read_indicators_[version_index_].reader_count;
+}
+
+const SearchServer& ConcurrentSearchServer::ReadGuard::GetServer() const {
+    return *reading_server_;
+}
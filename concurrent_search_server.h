@@ -0,0 +1,164 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <exception>
+#include <execution>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include "document.h"
+#include "search_server.h"
+
+// search server for queries running concurrently with changes (left-right concurrency control)
+// two copies of the server are kept, readers use one of them while writers change the other one,
+// then the copies are switched and the change is repeated on the old copy once its readers have left,
+// so a query sees a server that does not change until it ends and never waits for writers
+// changes must be deterministic, they are applied twice; writers are serialized
+// a change that throws on the first copy changes nothing, a change that throws on the second copy would leave
+// the copies different, so it terminates the program
+class ConcurrentSearchServer {
+public:
+    ConcurrentSearchServer() = default;
+
+    template <typename StringCollection>
+    explicit ConcurrentSearchServer(const StringCollection& stop_words);
+
+    explicit ConcurrentSearchServer(const std::string_view stop_words);
+
+    explicit ConcurrentSearchServer(const std::string& stop_words);
+
+public:
+    bool AddDocument(int document_id, const std::string_view document,
+                     DocumentStatus status, const std::vector<int>& ratings);
+
+    // both copies keep the same buffer of the text and refer to its new words in it
+    bool AddDocumentKeepingText(int document_id, std::string document,
+                                DocumentStatus status, const std::vector<int>& ratings);
+
+    void AddDocuments(const std::vector<SearchServer::NewDocument>& documents);
+
+    template<typename ExecutionPolicy>
+    void AddDocuments(const ExecutionPolicy& policy, const std::vector<SearchServer::NewDocument>& documents);
+
+    void RemoveDocument(const int document_id);
+
+    void SetQueryMode(SearchServer::QueryMode query_mode);
+
+    void CompactSegments();
+
+    // replaces the documents of both copies by the ones of the snapshot, the copies map the same file
+    void LoadSnapshot(const std::string& path);
+
+    // calls function(const SearchServer&) on the current version of the server and returns its result
+    // the version stays the same until the function returns, even if writers go on
+    template<typename Function>
+    auto Read(Function function) const;
+
+    int GetDocumentCount() const;
+
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query,
+                                           const DocumentStatus& desired_status = DocumentStatus::ACTUAL) const;
+
+    template<typename Predicate>
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, Predicate predicate) const;
+
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::string_view raw_query, const int document_id) const;
+
+private:
+    // number of readers of one of the versions, aligned so the two counters do not share a cache line
+    struct alignas(64) ReadIndicator {
+        std::atomic<int> reader_count{0};
+    };
+
+    class ReadGuard {
+    public:
+        explicit ReadGuard(const ConcurrentSearchServer& server);
+
+        ReadGuard(const ReadGuard&) = delete;
+        ReadGuard& operator=(const ReadGuard&) = delete;
+
+        ~ReadGuard();
+
+        const SearchServer& GetServer() const;
+
+    private:
+        const ConcurrentSearchServer& server_;
+        int version_index_;
+        const SearchServer* reading_server_;
+    };
+
+private:
+    // applies operation(SearchServer&) to both copies and returns the result of the first application
+    // the operation must be deterministic and must not throw once it has succeeded on the first copy
+    template<typename Operation>
+    auto Write(Operation operation);
+
+    // waits for the readers that have arrived at the other version and switches arriving readers to it
+    void SwitchVersion();
+
+private:
+    std::array<SearchServer, 2> servers_;
+
+    // copy of the server used by readers
+    std::atomic<int> reading_server_index_{0};
+
+    std::atomic<int> version_index_{0};
+    mutable std::array<ReadIndicator, 2> read_indicators_;
+
+    std::mutex write_mutex_;
+};
+
+template <typename StringCollection>
+ConcurrentSearchServer::ConcurrentSearchServer(const StringCollection& stop_words)
+    : servers_{SearchServer(stop_words), SearchServer(stop_words)} {
+}
+
+template<typename ExecutionPolicy>
+void ConcurrentSearchServer::AddDocuments(const ExecutionPolicy& policy, const std::vector<SearchServer::NewDocument>& documents) {
+    Write([&policy, &documents](SearchServer& server) {
+        server.AddDocuments(policy, documents);
+        return true;
+    });
+}
+
+template<typename Function>
+auto ConcurrentSearchServer::Read(Function function) const {
+    const ReadGuard guard(*this);
+
+    return function(guard.GetServer());
+}
+
+template<typename Predicate>
+std::vector<Document> ConcurrentSearchServer::FindTopDocuments(const std::string_view raw_query, Predicate predicate) const {
+    return Read([raw_query, &predicate](const SearchServer& server) {
+        return server.FindTopDocuments(raw_query, predicate);
+    });
+}
+
+template<typename Operation>
+auto ConcurrentSearchServer::Write(Operation operation) {
+    const std::lock_guard guard(write_mutex_);
+
+    const int reading_server_index = reading_server_index_.load();
+
+    // nothing is changed if the operation throws on the first copy
+    auto result = operation(servers_[1 - reading_server_index]);
+
+    reading_server_index_.store(1 - reading_server_index);
+
+    SwitchVersion();
+
+    // the copies can not be made equal again, the servers are not copyable
+    try {
+        operation(servers_[reading_server_index]);
+    } catch (...) {
+        std::terminate();
+    }
+
+    return result;
+}
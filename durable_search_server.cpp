@@ -0,0 +1,402 @@
+#include "durable_search_server.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <execution>
+#include <stdexcept>
+#include <utility>
+
+using namespace std::literals;
+
+namespace {
+
+// codec of the records of the log, independent of the shard protocol, so the file format changes only with the log
+// integers are little endian, strings are prefixed with their 4 byte length
+class RecordWriter {
+public:
+    void WriteUint8(uint8_t value) {
+        data_.push_back(static_cast<char>(value));
+    }
+
+    void WriteInt32(int32_t value) {
+        for (int shift = 0; shift < 32; shift += 8) {
+            data_.push_back(static_cast<char>(static_cast<uint32_t>(value) >> shift & 0xFF));
+        }
+    }
+
+    void WriteUint64(uint64_t value) {
+        for (int shift = 0; shift < 64; shift += 8) {
+            data_.push_back(static_cast<char>(value >> shift & 0xFF));
+        }
+    }
+
+    void WriteString(std::string_view value) {
+        WriteInt32(static_cast<int32_t>(value.size()));
+        data_.append(value);
+    }
+
+    std::string GetData() && {
+        return std::move(data_);
+    }
+
+private:
+    std::string data_;
+};
+
+// throws std::runtime_error if the record ends before the value
+class RecordReader {
+public:
+    explicit RecordReader(std::string_view data): data_(data) {}
+
+    uint8_t ReadUint8() {
+        return static_cast<uint8_t>(Take(1)[0]);
+    }
+
+    int32_t ReadInt32() {
+        const std::string_view bytes = Take(4);
+
+        uint32_t value = 0;
+        for (int i = 0; i < 4; ++i) {
+            value |= static_cast<uint32_t>(static_cast<uint8_t>(bytes[i])) << (8 * i);
+        }
+
+        return static_cast<int32_t>(value);
+    }
+
+    uint64_t ReadUint64() {
+        const std::string_view bytes = Take(8);
+
+        uint64_t value = 0;
+        for (int i = 0; i < 8; ++i) {
+            value |= static_cast<uint64_t>(static_cast<uint8_t>(bytes[i])) << (8 * i);
+        }
+
+        return value;
+    }
+
+    // a length that does not fit into the record is reported before anything is allocated for it
+    uint32_t ReadCount(size_t element_size) {
+        const uint32_t count = static_cast<uint32_t>(ReadInt32());
+
+        if (count > data_.size() / element_size) {
+            throw std::runtime_error("record is truncated"s);
+        }
+
+        return count;
+    }
+
+    std::string_view ReadString() {
+        return Take(ReadCount(1));
+    }
+
+    DocumentStatus ReadDocumentStatus() {
+        const uint8_t status = ReadUint8();
+
+        if (status > static_cast<uint8_t>(DocumentStatus::REMOVED)) {
+            throw std::runtime_error("unknown document status"s);
+        }
+
+        return static_cast<DocumentStatus>(status);
+    }
+
+private:
+    std::string_view Take(size_t size) {
+        if (size > data_.size()) {
+            throw std::runtime_error("record is truncated"s);
+        }
+
+        const std::string_view bytes = data_.substr(0, size);
+        data_.remove_prefix(size);
+
+        return bytes;
+    }
+
+private:
+    std::string_view data_;
+};
+
+} // namespace
+
+DurableSearchServer::DurableSearchServer(const std::string& log_path, const std::string_view stop_words)
+    : server_(stop_words)
+    , log_path_(log_path) {
+    WriteAheadLog::Replay(log_path_, [this](const std::vector<std::string_view>& records) {
+        Recover(records);
+    });
+
+    // a crash during a checkpoint can leave the snapshot of the next generation or the one of the previous
+    std::remove(GetSnapshotPath(generation_ + 1).c_str());
+    if (generation_ > 1) {
+        std::remove(GetSnapshotPath(generation_ - 1).c_str());
+    }
+
+    log_ = std::make_shared<WriteAheadLog>(log_path_);
+}
+
+bool DurableSearchServer::AddDocument(int document_id, const std::string_view document,
+                                      DocumentStatus status, const std::vector<int>& ratings) {
+    const SearchServer::NewDocument new_document{document_id, document, status, ratings};
+    const std::string record = MakeAddDocumentRecord(new_document);
+
+    uint64_t sequence_number = 0;
+    std::shared_ptr<WriteAheadLog> log;
+
+    {
+        const std::lock_guard guard(write_mutex_);
+
+        CheckNotFailed();
+
+        // rejected documents are neither logged nor added
+        server_.Read([&new_document](const SearchServer& server) {
+            server.CheckNewDocuments({new_document});
+            return true;
+        });
+
+        sequence_number = log_->Append(record);
+        last_sequence_number_ = sequence_number;
+        log = log_;
+
+        ApplyLogged([&] {
+            server_.AddDocument(document_id, document, status, ratings);
+        });
+    }
+
+    // the sync is shared with the writers that have appended meanwhile
+    WaitDurable(*log, sequence_number);
+
+    return true;
+}
+
+void DurableSearchServer::AddDocuments(const std::vector<SearchServer::NewDocument>& documents) {
+    std::vector<std::string> records;
+    records.reserve(documents.size());
+
+    for (const SearchServer::NewDocument& document : documents) {
+        records.push_back(MakeAddDocumentRecord(document));
+    }
+
+    uint64_t sequence_number = 0;
+    std::shared_ptr<WriteAheadLog> log;
+
+    {
+        const std::lock_guard guard(write_mutex_);
+
+        CheckNotFailed();
+
+        server_.Read([&documents](const SearchServer& server) {
+            server.CheckNewDocuments(documents);
+            return true;
+        });
+
+        for (const std::string& record : records) {
+            sequence_number = log_->Append(record);
+        }
+        last_sequence_number_ = sequence_number;
+        log = log_;
+
+        ApplyLogged([&] {
+            server_.AddDocuments(std::execution::par, documents);
+        });
+    }
+
+    WaitDurable(*log, sequence_number);
+}
+
+void DurableSearchServer::RemoveDocument(const int document_id) {
+    RecordWriter record_writer;
+    record_writer.WriteUint8(static_cast<uint8_t>(RecordType::REMOVE_DOCUMENT));
+    record_writer.WriteInt32(document_id);
+    const std::string record = std::move(record_writer).GetData();
+
+    uint64_t sequence_number = 0;
+    std::shared_ptr<WriteAheadLog> log;
+
+    {
+        const std::lock_guard guard(write_mutex_);
+
+        CheckNotFailed();
+
+        // removal of a missing document changes nothing, so it is never rejected
+        sequence_number = log_->Append(record);
+        last_sequence_number_ = sequence_number;
+        log = log_;
+
+        ApplyLogged([&] {
+            server_.RemoveDocument(document_id);
+        });
+    }
+
+    WaitDurable(*log, sequence_number);
+}
+
+int DurableSearchServer::GetDocumentCount() const {
+    CheckNotFailed();
+
+    return server_.GetDocumentCount();
+}
+
+std::vector<Document> DurableSearchServer::FindTopDocuments(const std::string_view raw_query,
+                                                            const DocumentStatus& desired_status) const {
+    CheckNotFailed();
+
+    return server_.FindTopDocuments(raw_query, desired_status);
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> DurableSearchServer::MatchDocument(const std::string_view raw_query,
+                                                                                             const int document_id) const {
+    CheckNotFailed();
+
+    return server_.MatchDocument(raw_query, document_id);
+}
+
+void DurableSearchServer::Checkpoint() {
+    const std::lock_guard guard(write_mutex_);
+
+    CheckNotFailed();
+
+    // the snapshot must have every change reported done, writers are stopped by the lock
+    WaitDurable(*log_, last_sequence_number_);
+
+    const uint64_t generation = generation_ + 1;
+    const std::string snapshot_path = GetSnapshotPath(generation);
+
+    RecordWriter record_writer;
+    record_writer.WriteUint8(static_cast<uint8_t>(RecordType::CHECKPOINT));
+    record_writer.WriteUint64(generation);
+    const std::string record = std::move(record_writer).GetData();
+
+    // until the log is replaced, the old log and the old snapshot are in use, so a failure changes nothing
+    try {
+        server_.Read([&snapshot_path](const SearchServer& server) {
+            server.SaveSnapshot(snapshot_path);
+            return true;
+        });
+
+        WriteAheadLog::Create(log_path_, {record});
+    } catch (...) {
+        std::remove(snapshot_path.c_str());
+        throw;
+    }
+
+    // writers still waiting for the old log hold it, their records are durable already
+    try {
+        log_ = std::make_shared<WriteAheadLog>(log_path_);
+    } catch (...) {
+        is_failed_.store(true);
+        throw;
+    }
+
+    last_sequence_number_ = 0;
+
+    if (generation_ > 0) {
+        std::remove(GetSnapshotPath(generation_).c_str());
+    }
+
+    generation_ = generation;
+} // Checkpoint
+
+bool DurableSearchServer::IsFailed() const {
+    return is_failed_.load();
+}
+
+void DurableSearchServer::CheckNotFailed() const {
+    if (is_failed_.load()) {
+        throw std::runtime_error("the log could not be written, the server must be recreated from the log"s);
+    }
+}
+
+template<typename Function>
+void DurableSearchServer::ApplyLogged(Function function) {
+    // the change is in the log already, so the server can no longer match it
+    try {
+        function();
+    } catch (...) {
+        is_failed_.store(true);
+        throw;
+    }
+}
+
+void DurableSearchServer::WaitDurable(WriteAheadLog& log, uint64_t sequence_number) {
+    try {
+        log.WaitDurable(sequence_number);
+    } catch (...) {
+        is_failed_.store(true);
+        throw;
+    }
+}
+
+void DurableSearchServer::Recover(const std::vector<std::string_view>& records) {
+    // texts of the batch are views of the records
+    std::vector<SearchServer::NewDocument> batch;
+
+    const auto add_batch = [this, &batch]() {
+        if (!batch.empty()) {
+            server_.AddDocuments(std::execution::par, batch);
+            batch.clear();
+        }
+    };
+
+    try {
+        for (const std::string_view record : records) {
+            RecordReader reader(record);
+
+            switch (static_cast<RecordType>(reader.ReadUint8())) {
+                case RecordType::ADD_DOCUMENT: {
+                    // documents of a batch are different, a document is added again only after its removal
+                    SearchServer::NewDocument& document = batch.emplace_back();
+                    document.document_id = reader.ReadInt32();
+                    document.text = reader.ReadString();
+                    document.status = reader.ReadDocumentStatus();
+
+                    document.ratings.resize(reader.ReadCount(4));
+                    for (int& rating : document.ratings) {
+                        rating = reader.ReadInt32();
+                    }
+                    break;
+                }
+                case RecordType::REMOVE_DOCUMENT: {
+                    add_batch();
+                    server_.RemoveDocument(reader.ReadInt32());
+                    break;
+                }
+                case RecordType::CHECKPOINT: {
+                    // the log of a checkpoint starts with it, the records after it are changes of the snapshot
+                    if (record.data() != records.front().data()) {
+                        throw std::runtime_error("checkpoint in the middle of the log"s);
+                    }
+
+                    generation_ = reader.ReadUint64();
+                    server_.LoadSnapshot(GetSnapshotPath(generation_));
+                    break;
+                }
+                default: {
+                    throw std::runtime_error("unknown record type"s);
+                }
+            }
+        }
+
+        add_batch();
+    } catch (const std::exception& error) {
+        // records have checksums, so a bad record is not a torn write
+        throw std::runtime_error("log is corrupted: "s + error.what());
+    }
+} // Recover
+
+std::string DurableSearchServer::GetSnapshotPath(uint64_t generation) const {
+    return log_path_ + ".snapshot."s + std::to_string(generation);
+}
+
+std::string DurableSearchServer::MakeAddDocumentRecord(const SearchServer::NewDocument& document) {
+    RecordWriter record;
+    record.WriteUint8(static_cast<uint8_t>(RecordType::ADD_DOCUMENT));
+    record.WriteInt32(document.document_id);
+    record.WriteString(document.text);
+    record.WriteUint8(static_cast<uint8_t>(document.status));
+
+    record.WriteInt32(static_cast<int32_t>(document.ratings.size()));
+    for (const int rating : document.ratings) {
+        record.WriteInt32(rating);
+    }
+
+    return std::move(record).GetData();
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include "concurrent_search_server.h"
+#include "document.h"
+#include "search_server.h"
+#include "write_ahead_log.h"
+
+// search server that writes every change to a write-ahead log before reporting it done,
+// a server created with the same log after a crash has all the changes that have been reported
+// a change is checked, appended to the log and applied, then the writer waits for the sync of the log,
+// writers running at the same time share the syncs of the log, queries go on during changes
+// once the log fails or a logged change fails to apply, memory and the log can differ, so the server is failed:
+// every later call throws std::runtime_error and the server must be recreated from the log
+// stop words are not logged, the server must be created with the same stop words every time
+// Checkpoint bounds the log: the server is saved to a snapshot next to the log and the log is started again,
+// its first record names the snapshot, so a crash at any step leaves a log and a snapshot that match
+class DurableSearchServer {
+public:
+    // loads the snapshot of the last checkpoint and replays the log if it exists, then goes on writing the log
+    // throws std::runtime_error if the log or the snapshot can not be read or written
+    DurableSearchServer(const std::string& log_path, const std::string_view stop_words);
+
+public:
+    bool AddDocument(int document_id, const std::string_view document,
+                     DocumentStatus status, const std::vector<int>& ratings);
+
+    // nothing is added if any of the documents can not be added
+    void AddDocuments(const std::vector<SearchServer::NewDocument>& documents);
+
+    void RemoveDocument(const int document_id);
+
+    // calls function(const SearchServer&) on the current version of the server and returns its result
+    template<typename Function>
+    auto Read(Function function) const;
+
+    // saves the server to log_path.snapshot.<generation> and replaces the log by an empty one,
+    // writers wait for the checkpoint, queries go on
+    // throws std::runtime_error if the snapshot or the log can not be written, the server goes on with the old ones
+    void Checkpoint();
+
+    bool IsFailed() const;
+
+    int GetDocumentCount() const;
+
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query,
+                                           const DocumentStatus& desired_status = DocumentStatus::ACTUAL) const;
+
+    template<typename Predicate>
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, Predicate predicate) const;
+
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::string_view raw_query, const int document_id) const;
+
+private:
+    enum class RecordType : uint8_t {
+        ADD_DOCUMENT = 1,
+        REMOVE_DOCUMENT = 2,
+        CHECKPOINT = 3,
+    };
+
+private:
+    // consecutive added documents are added in parallel batches, removals split the batches
+    void Recover(const std::vector<std::string_view>& records);
+
+    std::string GetSnapshotPath(uint64_t generation) const;
+
+    static std::string MakeAddDocumentRecord(const SearchServer::NewDocument& document);
+
+    void CheckNotFailed() const;
+
+    // applies a change that is already logged, the server is failed if the change throws
+    template<typename Function>
+    void ApplyLogged(Function function);
+
+    // the server is failed if the log could not be synced
+    void WaitDurable(WriteAheadLog& log, uint64_t sequence_number);
+
+private:
+    ConcurrentSearchServer server_;
+
+    std::string log_path_;
+    // writers waiting for their sync keep the log they appended to, a checkpoint replaces it
+    std::shared_ptr<WriteAheadLog> log_;
+    uint64_t last_sequence_number_ = 0;
+
+    // number of the last checkpoint, 0 if the log has none
+    uint64_t generation_ = 0;
+
+    // changes are logged in the order they are applied
+    std::mutex write_mutex_;
+
+    std::atomic<bool> is_failed_{false};
+};
+
+template<typename Function>
+auto DurableSearchServer::Read(Function function) const {
+    CheckNotFailed();
+
+    return server_.Read(function);
+}
+
+template<typename Predicate>
+std::vector<Document> DurableSearchServer::FindTopDocuments(const std::string_view raw_query, Predicate predicate) const {
+    CheckNotFailed();
+
+    return server_.FindTopDocuments(raw_query, predicate);
+}
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "memory_usage.h"
+#include "slot_bitmap.h"
+
+namespace search_server_index {
+
+// term of a document and the number of its occurrences, the frequency is the count divided by the length of the document
+struct TermCount {
+    int32_t term_id = 0;
+    uint32_t count = 0;
+};
+
+// terms of every document slot in order of term ids, all slots share one buffer
+// entries of removed slots stay in the buffer until it is compacted
+class ForwardIndex {
+public:
+    // slots are added in order, term_counts must be in order of term ids
+    void AddSlot(const std::vector<std::pair<int, uint32_t>>& term_counts) {
+        for (const auto& [term_id, count] : term_counts) {
+            entries_.push_back({term_id, count});
+        }
+
+        slot_ends_.push_back(entries_.size());
+    }
+
+    void AddSlot(const TermCount* begin, const TermCount* end) {
+        entries_.insert(entries_.end(), begin, end);
+        slot_ends_.push_back(entries_.size());
+    }
+
+    // adds the slots of the other index after the slots of this one
+    void Append(const ForwardIndex& other) {
+        for (int slot = 0; slot < other.GetSlotCount(); ++slot) {
+            AddSlot(other.begin(slot), other.end(slot));
+        }
+    }
+
+    int GetSlotCount() const {
+        return static_cast<int>(slot_ends_.size());
+    }
+
+    const TermCount* begin(int slot) const {
+        return entries_.data() + (slot == 0 ? 0 : slot_ends_[slot - 1]);
+    }
+
+    const TermCount* end(int slot) const {
+        return entries_.data() + slot_ends_[slot];
+    }
+
+    // returns nullptr if the slot does not have the term
+    const TermCount* Find(int slot, int term_id) const {
+        const TermCount* slot_end = end(slot);
+        const TermCount* entry = std::lower_bound(begin(slot), slot_end, term_id, [](const TermCount& entry, int term_id) {
+            return entry.term_id < term_id;
+        });
+
+        return entry != slot_end && entry->term_id == term_id ? entry : nullptr;
+    }
+
+    // the entries of the slot are dropped by the next compaction
+    void RemoveSlot(int slot) {
+        removed_entry_count_ += end(slot) - begin(slot);
+    }
+
+    size_t GetRemovedEntryCount() const {
+        return removed_entry_count_;
+    }
+
+    // entries of the live and of the removed slots
+    size_t GetEntryCount() const {
+        return entries_.size();
+    }
+
+    // drops the entries of the removed slots, the slots stay without terms
+    void Compact(const SlotBitmap& removed_slots) {
+        if (removed_entry_count_ == 0) {
+            return;
+        }
+
+        std::vector<TermCount> entries;
+        entries.reserve(entries_.size() - removed_entry_count_);
+
+        size_t slot_begin = 0;
+
+        for (int slot = 0; slot < GetSlotCount(); ++slot) {
+            const size_t slot_end = slot_ends_[slot];
+
+            if (!removed_slots.Contains(slot)) {
+                entries.insert(entries.end(), entries_.begin() + slot_begin, entries_.begin() + slot_end);
+            }
+
+            slot_begin = slot_end;
+            slot_ends_[slot] = entries.size();
+        }
+
+        entries_ = std::move(entries);
+        removed_entry_count_ = 0;
+    }
+
+    // drops the removed slots with their entries, the slots after them move down
+    void EraseSlots(const SlotBitmap& removed_slots) {
+        std::vector<TermCount> entries;
+        entries.reserve(entries_.size() - removed_entry_count_);
+
+        std::vector<size_t> slot_ends;
+        slot_ends.reserve(slot_ends_.size() - removed_slots.GetCount());
+
+        size_t slot_begin = 0;
+
+        for (int slot = 0; slot < GetSlotCount(); ++slot) {
+            const size_t slot_end = slot_ends_[slot];
+
+            if (!removed_slots.Contains(slot)) {
+                entries.insert(entries.end(), entries_.begin() + slot_begin, entries_.begin() + slot_end);
+                slot_ends.push_back(entries.size());
+            }
+
+            slot_begin = slot_end;
+        }
+
+        entries_ = std::move(entries);
+        slot_ends_ = std::move(slot_ends);
+        removed_entry_count_ = 0;
+    }
+
+    // entries of the live slots are payload, slot bounds and entries of removed slots are overhead
+    MemoryUsage GetMemoryUsage() const {
+        MemoryUsage usage = GetVectorMemoryUsage(entries_);
+        usage.payload_bytes -= removed_entry_count_ * sizeof(TermCount);
+        usage.overhead_bytes += removed_entry_count_ * sizeof(TermCount);
+        usage.overhead_bytes += GetVectorMemoryUsage(slot_ends_).GetTotalBytes();
+
+        return usage;
+    }
+
+private:
+    std::vector<TermCount> entries_;
+
+    // end of the entries of every slot, the entries of a slot start at the end of the previous one
+    std::vector<size_t> slot_ends_;
+
+    size_t removed_entry_count_ = 0;
+};
+
+} // namespace search_server_index
@@ -0,0 +1,270 @@
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace search_server_index {
+
+// snapshot file is a header and sections of arrays, every array starts at an offset aligned to kSnapshotAlignment,
+// so arrays of a mapped file are read in place
+// values are stored in the byte order of the machine, the header tells a file of another byte order apart
+static constexpr char kSnapshotMagic[8] = {'S', 'S', 'N', 'A', 'P', 'S', 'H', 'T'};
+static constexpr uint32_t kSnapshotVersion = 3;
+static constexpr uint32_t kSnapshotByteOrderMark = 0x01020304;
+static constexpr size_t kSnapshotAlignment = 8;
+
+struct SnapshotHeader {
+    char magic[8] = {};
+    uint32_t version = 0;
+    uint32_t byte_order_mark = 0;
+    uint64_t file_size = 0;
+};
+
+// read only mapping of a whole file, pages are shared with other processes mapping the same file
+class MappedFile {
+public:
+    // throws std::runtime_error if the file can not be mapped
+    explicit MappedFile(const std::string& path) {
+        using namespace std::literals;
+
+        const int file = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (file < 0) {
+            throw std::runtime_error("failed to open "s + path + ": "s + std::strerror(errno));
+        }
+
+        struct stat file_status;
+        if (fstat(file, &file_status) < 0) {
+            const std::string error = std::strerror(errno);
+            close(file);
+
+            throw std::runtime_error("failed to open "s + path + ": "s + error);
+        }
+
+        size_ = static_cast<size_t>(file_status.st_size);
+
+        if (size_ > 0) {
+            void* data = mmap(nullptr, size_, PROT_READ, MAP_SHARED, file, 0);
+
+            if (data == MAP_FAILED) {
+                const std::string error = std::strerror(errno);
+                close(file);
+
+                throw std::runtime_error("failed to map "s + path + ": "s + error);
+            }
+
+            data_ = static_cast<const char*>(data);
+        }
+
+        // the mapping stays valid without the descriptor
+        close(file);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+        if (data_ != nullptr) {
+            munmap(const_cast<char*>(data_), size_);
+        }
+    }
+
+    const char* GetData() const {
+        return data_;
+    }
+
+    size_t GetSize() const {
+        return size_;
+    }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+// writes a snapshot to a temporary file that replaces the target file only when it is complete
+class SnapshotWriter {
+public:
+    explicit SnapshotWriter(const std::string& path)
+        : path_(path)
+        , temporary_path_(path + ".tmp")
+        , output_(temporary_path_, std::ios::binary | std::ios::trunc) {
+        using namespace std::literals;
+
+        if (!output_) {
+            throw std::runtime_error("failed to create "s + temporary_path_);
+        }
+
+        SnapshotHeader header;
+        std::memcpy(header.magic, kSnapshotMagic, sizeof(header.magic));
+        header.version = kSnapshotVersion;
+        header.byte_order_mark = kSnapshotByteOrderMark;
+
+        Write(header);
+    }
+
+    SnapshotWriter(const SnapshotWriter&) = delete;
+    SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+
+    ~SnapshotWriter() {
+        if (!is_finished_) {
+            output_.close();
+            std::remove(temporary_path_.c_str());
+        }
+    }
+
+    template<typename T>
+    void Write(const T& value) {
+        WriteArray(&value, 1);
+    }
+
+    // the array starts at an aligned offset
+    template<typename T>
+    void WriteArray(const T* values, size_t count) {
+        static_assert(std::is_trivially_copyable_v<T> && alignof(T) <= kSnapshotAlignment);
+
+        Align();
+
+        output_.write(reinterpret_cast<const char*>(values), static_cast<std::streamsize>(count * sizeof(T)));
+        offset_ += count * sizeof(T);
+    }
+
+    void WriteString(std::string_view value) {
+        Write<uint64_t>(value.size());
+        WriteArray(value.data(), value.size());
+    }
+
+    // writes the size of the file into the header and puts the file in place of the target file
+    // the file is synced before the rename and its directory after it, so a crash leaves the old or the new snapshot
+    void Finish() {
+        using namespace std::literals;
+
+        Align();
+
+        output_.seekp(offsetof(SnapshotHeader, file_size));
+        const uint64_t file_size = offset_;
+        output_.write(reinterpret_cast<const char*>(&file_size), sizeof(file_size));
+
+        output_.close();
+
+        if (!output_ || !SyncFile(temporary_path_, O_RDONLY) || std::rename(temporary_path_.c_str(), path_.c_str()) != 0
+            || !SyncFile(GetDirectory(path_), O_RDONLY | O_DIRECTORY)) {
+            throw std::runtime_error("failed to write "s + path_);
+        }
+
+        is_finished_ = true;
+    }
+
+private:
+    static bool SyncFile(const std::string& path, int flags) {
+        const int file = open(path.c_str(), flags | O_CLOEXEC);
+
+        if (file < 0) {
+            return false;
+        }
+
+        const bool is_synced = fsync(file) == 0;
+        close(file);
+
+        return is_synced;
+    }
+
+    static std::string GetDirectory(const std::string& path) {
+        const size_t separator = path.rfind('/');
+
+        return separator == std::string::npos ? "." : separator == 0 ? "/" : path.substr(0, separator);
+    }
+
+    void Align() {
+        static constexpr char kPadding[kSnapshotAlignment] = {};
+
+        const size_t padding = (kSnapshotAlignment - offset_ % kSnapshotAlignment) % kSnapshotAlignment;
+
+        output_.write(kPadding, static_cast<std::streamsize>(padding));
+        offset_ += padding;
+    }
+
+private:
+    std::string path_;
+    std::string temporary_path_;
+    std::ofstream output_;
+    size_t offset_ = 0;
+    bool is_finished_ = false;
+};
+
+// reads arrays of a snapshot in place
+// throws std::runtime_error if the snapshot is not valid or an array does not fit into it
+class SnapshotReader {
+public:
+    // data must be aligned to kSnapshotAlignment, as mapped files are
+    SnapshotReader(const char* data, size_t size): data_(data), size_(size) {
+        using namespace std::literals;
+
+        const SnapshotHeader header = Read<SnapshotHeader>();
+
+        if (std::memcmp(header.magic, kSnapshotMagic, sizeof(header.magic)) != 0) {
+            throw std::runtime_error("file is not a snapshot"s);
+        }
+
+        if (header.byte_order_mark != kSnapshotByteOrderMark) {
+            throw std::runtime_error("snapshot is written on a machine with another byte order"s);
+        }
+
+        if (header.version != kSnapshotVersion) {
+            throw std::runtime_error("unsupported snapshot version "s + std::to_string(header.version));
+        }
+
+        if (header.file_size != size_) {
+            throw std::runtime_error("snapshot is truncated"s);
+        }
+    }
+
+    template<typename T>
+    T Read() {
+        return *ReadArray<T>(1);
+    }
+
+    template<typename T>
+    const T* ReadArray(size_t count) {
+        using namespace std::literals;
+
+        static_assert(std::is_trivially_copyable_v<T> && alignof(T) <= kSnapshotAlignment);
+
+        offset_ += (kSnapshotAlignment - offset_ % kSnapshotAlignment) % kSnapshotAlignment;
+
+        if (offset_ > size_ || count > (size_ - offset_) / sizeof(T)) {
+            throw std::runtime_error("snapshot is corrupted"s);
+        }
+
+        const T* values = reinterpret_cast<const T*>(data_ + offset_);
+        offset_ += count * sizeof(T);
+
+        return values;
+    }
+
+    // view of the string in the snapshot
+    std::string_view ReadString() {
+        const uint64_t size = Read<uint64_t>();
+
+        return {ReadArray<char>(size), size};
+    }
+
+private:
+    const char* data_;
+    size_t size_;
+    size_t offset_ = 0;
+};
+
+} // namespace search_server_index
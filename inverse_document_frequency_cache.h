@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <utility>
+
+#include "memory_usage.h"
+
+namespace search_server_index {
+
+// values are rounded to float as the cache keeps them, so every way of ranking gives the same relevances
+inline double ComputeInverseDocumentFrequency(int document_count, size_t document_frequency) {
+    return static_cast<float>(std::log(static_cast<double>(document_count) / document_frequency));
+}
+
+// inverse document frequencies of terms, computed on the first query after the index has changed
+// every value is stored as a float together with the generation of the index it was computed for,
+// both fit into one atomic word, so concurrent queries can fill the cache without locks
+class InverseDocumentFrequencyCache {
+public:
+    InverseDocumentFrequencyCache() = default;
+
+    // loaded values are copied with their generations, so they stay valid for a copy of the same index
+    InverseDocumentFrequencyCache(const InverseDocumentFrequencyCache& other)
+        : generation_(other.generation_) {
+        for (const auto& entry : other.entries_) {
+            entries_.emplace_back(entry.load(std::memory_order_relaxed));
+        }
+    }
+
+    InverseDocumentFrequencyCache& operator=(const InverseDocumentFrequencyCache& other) {
+        if (this != &other) {
+            InverseDocumentFrequencyCache copy(other);
+            *this = std::move(copy);
+        }
+
+        return *this;
+    }
+
+    InverseDocumentFrequencyCache(InverseDocumentFrequencyCache&&) = default;
+    InverseDocumentFrequencyCache& operator=(InverseDocumentFrequencyCache&&) = default;
+
+    // the new term gets the next term id
+    void AddTerm() {
+        entries_.emplace_back(0);
+    }
+
+    // must be called whenever documents are added or removed, not concurrently with Get
+    void Invalidate() {
+        if (++generation_ == 0) {
+            // old entries could be mistaken for the new generation after overflow
+            for (auto& entry : entries_) {
+                entry.store(0, std::memory_order_relaxed);
+            }
+
+            generation_ = 1;
+        }
+    }
+
+    // document_frequency must be positive
+    double Get(int term_id, size_t document_frequency, int document_count) const {
+        std::atomic<uint64_t>& entry = entries_[term_id];
+        uint64_t value = entry.load(std::memory_order_relaxed);
+
+        if (static_cast<uint32_t>(value >> 32) != generation_) {
+            const float inverse_document_frequency = static_cast<float>(ComputeInverseDocumentFrequency(document_count, document_frequency));
+
+            uint32_t bits;
+            std::memcpy(&bits, &inverse_document_frequency, sizeof(bits));
+
+            value = static_cast<uint64_t>(generation_) << 32 | bits;
+            entry.store(value, std::memory_order_relaxed);
+        }
+
+        const uint32_t bits = static_cast<uint32_t>(value);
+
+        float inverse_document_frequency;
+        std::memcpy(&inverse_document_frequency, &bits, sizeof(bits));
+
+        return inverse_document_frequency;
+    }
+
+    MemoryUsage GetMemoryUsage() const {
+        return GetDequeMemoryUsage(entries_);
+    }
+
+private:
+    // deque does not move elements when it grows
+    mutable std::deque<std::atomic<uint64_t>> entries_;
+    uint32_t generation_ = 1;
+};
+
+} // namespace search_server_index
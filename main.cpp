@@ -1,14 +1,58 @@
 #include "process_queries.h"
 #include "search_server.h"
+#include "shard_socket_server.h"
 #include "test_search_server.h"
 
+#include <csignal>
 #include <execution>
+#include <exception>
 #include <iostream>
 #include <string>
+#include <thread>
 #include <vector>
 
+#include <pthread.h>
+#include <unistd.h>
+
 using namespace std;
 
+// search_server --shard <socket path> [stop words]
+// serves one shard of a RemoteShardedSearchServer until SIGTERM or SIGINT, then removes the socket file
+int ServeShard(const string& socket_path, const string& stop_words) {
+    // the signals are blocked in all threads and taken by one of them, so Stop is not called from a handler
+    sigset_t stop_signals;
+    sigemptyset(&stop_signals);
+    sigaddset(&stop_signals, SIGTERM);
+    sigaddset(&stop_signals, SIGINT);
+    pthread_sigmask(SIG_BLOCK, &stop_signals, nullptr);
+
+    try {
+        ShardSocketServer server(socket_path, stop_words);
+
+        thread signal_thread([&server, &stop_signals] {
+            int signal = 0;
+            sigwait(&stop_signals, &signal);
+            server.Stop();
+        });
+
+        try {
+            server.Serve();
+        } catch (...) {
+            // the signal thread waits for a signal, it is sent to the process itself
+            kill(getpid(), SIGTERM);
+            signal_thread.join();
+            throw;
+        }
+
+        signal_thread.join();
+    } catch (const exception& error) {
+        cerr << "shard "s << socket_path << ": "s << error.what() << endl;
+        return 1;
+    }
+
+    return 0;
+}
+
 // void PrintDocument(const Document& document) {
 //     cout << "{ "s
 //          << "document_id = "s << document.id << ", "s
@@ -16,7 +60,11 @@ using namespace std;
 //          << "rating = "s << document.rating << " }"s << endl;
 // }
 
-int main() {
+int main(int argc, char* argv[]) {
+    if (argc >= 3 && argv[1] == "--shard"s) {
+        return ServeShard(argv[2], argc >= 4 ? argv[3] : ""s);
+    }
+
     TestSearchServer();
 
     SearchServer search_server("and with"s);
@@ -47,7 +95,7 @@ int main() {
 
     cout << "Even ids:"s << endl;
         // параллельная версия
-    for (const Document& document : search_server.FindTopDocuments(execution::par, "curly nasty cat"s, [](int document_id, DocumentStatus status, int rating) { return document_id % 2 == 0; })) {
+    for (const Document& document : search_server.FindTopDocuments(execution::par, "curly nasty cat"s, [](int document_id, DocumentStatus, int) { return document_id % 2 == 0; })) {
         PrintDocument(document);
     }
 
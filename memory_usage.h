@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <list>
+#include <map>
+#include <set>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+namespace search_server_index {
+
+// bytes taken by a part of the server
+// payload is the bytes of the stored values, overhead is the bytes of tree and list nodes, hash buckets and unused capacity
+// node sizes follow the layouts of libstdc++, headers of the heap allocator are not counted
+struct MemoryUsage {
+    size_t payload_bytes = 0;
+    size_t overhead_bytes = 0;
+
+    size_t GetTotalBytes() const {
+        return payload_bytes + overhead_bytes;
+    }
+
+    MemoryUsage& operator+=(const MemoryUsage& other) {
+        payload_bytes += other.payload_bytes;
+        overhead_bytes += other.overhead_bytes;
+
+        return *this;
+    }
+};
+
+// color and three pointers of a red-black tree node
+static constexpr size_t kTreeNodeHeaderBytes = 32;
+
+// two pointers of a list node
+static constexpr size_t kListNodeHeaderBytes = 16;
+
+// next pointer of a hash table node
+static constexpr size_t kHashNodeHeaderBytes = 8;
+
+// heap bytes of the characters of a string, short strings are kept inside the object
+inline MemoryUsage GetStringMemoryUsage(const std::string& value) {
+    MemoryUsage usage;
+
+    if (value.capacity() > std::string().capacity()) {
+        usage.payload_bytes = value.size();
+        usage.overhead_bytes = value.capacity() + 1 - value.size();
+    }
+
+    return usage;
+}
+
+template<typename T>
+MemoryUsage GetVectorMemoryUsage(const std::vector<T>& values) {
+    return {values.size() * sizeof(T), (values.capacity() - values.size()) * sizeof(T)};
+}
+
+template<typename Key, typename Compare>
+MemoryUsage GetSetMemoryUsage(const std::set<Key, Compare>& values) {
+    return {values.size() * sizeof(Key), values.size() * kTreeNodeHeaderBytes};
+}
+
+template<typename Key, typename Value, typename Compare>
+MemoryUsage GetMapMemoryUsage(const std::map<Key, Value, Compare>& values) {
+    return {values.size() * (sizeof(Key) + sizeof(Value)), values.size() * kTreeNodeHeaderBytes};
+}
+
+template<typename T>
+MemoryUsage GetListMemoryUsage(const std::list<T>& values) {
+    return {values.size() * sizeof(T), values.size() * kListNodeHeaderBytes};
+}
+
+// libstdc++ keeps the hash in the node for all keys but integers, whose hash is the value itself,
+// a single bucket is kept inside the object
+template<typename Key, typename Value, typename Hash>
+MemoryUsage GetHashMapMemoryUsage(const std::unordered_map<Key, Value, Hash>& values) {
+    const size_t hash_bytes = std::is_integral_v<Key> ? 0 : sizeof(size_t);
+    const size_t bucket_bytes = values.bucket_count() > 1 ? values.bucket_count() * sizeof(void*) : 0;
+
+    return {values.size() * (sizeof(Key) + sizeof(Value)),
+            values.size() * (kHashNodeHeaderBytes + hash_bytes) + bucket_bytes};
+}
+
+// deque keeps its values in blocks of 512 bytes
+template<typename T>
+MemoryUsage GetDequeMemoryUsage(const std::deque<T>& values) {
+    constexpr size_t kBlockBytes = 512;
+    const size_t values_per_block = sizeof(T) < kBlockBytes ? kBlockBytes / sizeof(T) : 1;
+    const size_t block_count = values.size() / values_per_block + 1;
+
+    return {values.size() * sizeof(T), block_count * values_per_block * sizeof(T) - values.size() * sizeof(T)};
+}
+
+} // namespace search_server_index
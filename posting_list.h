@@ -0,0 +1,478 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "bit_packing.h"
+#include "memory_usage.h"
+
+namespace search_server_index {
+
+// postings of a single term, sorted by document slot
+// a posting is a slot and the number of occurrences of the term in the document,
+// term frequency is the count divided by the document length, which is kept by the caller
+// every kBlockSize postings are compressed into a block: gaps between slots and counts are bit packed,
+// the last postings that do not fill a block stay uncompressed in the tail
+// every block keeps an upper bound of term frequencies of its postings
+// a list either owns its arrays or borrows them from memory of the caller, such as a mapped snapshot file,
+// borrowed lists are read only
+class PostingList {
+public:
+    static constexpr size_t kBlockSize = kPackedBlockSize;
+
+    // header of a compressed block, it is written to snapshots as is
+    struct Block {
+        int last_slot = 0;
+        uint32_t offset = 0;
+        uint8_t slot_bits = 0;
+        uint8_t count_bits = 0;
+        uint8_t padding[6] = {};
+        double max_term_frequency = 0.0;
+    };
+
+    static_assert(sizeof(Block) == 24 && alignof(Block) == 8, "blocks are stored in snapshots as is");
+
+    // arrays and totals of a list
+    struct Data {
+        const uint32_t* words = nullptr;
+        size_t word_count = 0;
+
+        const Block* blocks = nullptr;
+        size_t block_count = 0;
+
+        const int* tail_slots = nullptr;
+        const uint32_t* tail_counts = nullptr;
+        size_t tail_size = 0;
+
+        double tail_max_term_frequency = 0.0;
+        size_t posting_count = 0;
+        double max_term_frequency = 0.0;
+    };
+
+public:
+    PostingList() = default;
+
+    // list that reads the arrays of the data without copying them, the arrays must outlive the list
+    static PostingList Borrow(const Data& data) {
+        PostingList posting_list;
+        posting_list.is_borrowed_ = true;
+        posting_list.borrowed_words_ = data.words;
+        posting_list.borrowed_blocks_ = data.blocks;
+        posting_list.borrowed_tail_slots_ = data.tail_slots;
+        posting_list.borrowed_tail_counts_ = data.tail_counts;
+        posting_list.borrowed_block_count_ = static_cast<uint32_t>(data.block_count);
+        posting_list.borrowed_tail_size_ = static_cast<uint32_t>(data.tail_size);
+        posting_list.tail_max_term_frequency_ = data.tail_max_term_frequency;
+        posting_list.posting_count_ = data.posting_count;
+        posting_list.max_term_frequency_ = data.max_term_frequency;
+
+        return posting_list;
+    }
+
+    Data GetData() const {
+        Data data;
+
+        data.words = GetWords();
+        data.blocks = GetBlocks();
+        data.block_count = GetCompressedBlockCount();
+
+        // blocks are packed one after another
+        if (data.block_count > 0) {
+            const Block& last_block = data.blocks[data.block_count - 1];
+            data.word_count = last_block.offset + GetPackedBlockWordCount(last_block.slot_bits) + GetPackedBlockWordCount(last_block.count_bits);
+        }
+
+        data.tail_slots = GetTailSlots();
+        data.tail_counts = GetTailCounts();
+        data.tail_size = GetTailSize();
+        data.tail_max_term_frequency = tail_max_term_frequency_;
+        data.posting_count = posting_count_;
+        data.max_term_frequency = max_term_frequency_;
+
+        return data;
+    }
+
+    // slot must be greater than slots of the postings in the list
+    void Add(int slot, uint32_t count, double term_frequency) {
+        assert(!is_borrowed_);
+        assert(count > 0);
+        assert(posting_count_ == 0 || GetLastSlot() < slot);
+
+        tail_slots_.push_back(slot);
+        tail_counts_.push_back(count);
+
+        tail_max_term_frequency_ = std::max(tail_max_term_frequency_, term_frequency);
+        max_term_frequency_ = std::max(max_term_frequency_, term_frequency);
+        ++posting_count_;
+
+        if (tail_slots_.size() == kBlockSize) {
+            CompressTail();
+        }
+    }
+
+    bool Contains(int slot) const {
+        const size_t block = FindBlock(slot);
+
+        if (block == GetBlockCount()) {
+            return false;
+        }
+
+        if (block == GetCompressedBlockCount()) {
+            return std::binary_search(GetTailSlots(), GetTailSlots() + GetTailSize(), slot);
+        }
+
+        std::array<int, kBlockSize> block_slots;
+        std::array<uint32_t, kBlockSize> block_counts;
+
+        DecodeBlock(block, block_slots.data(), block_counts.data());
+
+        return std::binary_search(block_slots.begin(), block_slots.end(), slot);
+    }
+
+    // calls function(slot, count) for postings with slots in [begin_slot, end_slot) in order of slots
+    template<typename Function>
+    void ForEachPosting(int begin_slot, int end_slot, Function function) const {
+        std::array<int, kBlockSize> block_slots;
+        std::array<uint32_t, kBlockSize> block_counts;
+
+        for (size_t block = FindBlock(begin_slot); block < GetBlockCount(); ++block) {
+            const size_t block_size = DecodeBlock(block, block_slots.data(), block_counts.data());
+
+            for (size_t i = 0; i < block_size; ++i) {
+                if (block_slots[i] >= end_slot) {
+                    return;
+                }
+
+                if (block_slots[i] >= begin_slot) {
+                    function(block_slots[i], block_counts[i]);
+                }
+            }
+        }
+    }
+
+    template<typename Function>
+    void ForEachPosting(Function function) const {
+        ForEachPosting(std::numeric_limits<int>::min(), std::numeric_limits<int>::max(), function);
+    }
+
+    size_t size() const {
+        return posting_count_;
+    }
+
+    bool empty() const {
+        return posting_count_ == 0;
+    }
+
+    double GetMaxTermFrequency() const {
+        return max_term_frequency_;
+    }
+
+    // heap memory of the arrays, borrowed arrays are not counted
+    // packed postings and the tail are the payload, block headers are the overhead
+    MemoryUsage GetMemoryUsage() const {
+        MemoryUsage usage = GetVectorMemoryUsage(words_);
+        usage += GetVectorMemoryUsage(tail_slots_);
+        usage += GetVectorMemoryUsage(tail_counts_);
+
+        usage.overhead_bytes += GetVectorMemoryUsage(blocks_).GetTotalBytes();
+
+        return usage;
+    }
+
+    // compressed blocks go first, the tail is the last block if it is not empty
+    size_t GetBlockCount() const {
+        return GetCompressedBlockCount() + (GetTailSize() == 0 ? 0 : 1);
+    }
+
+    int GetBlockLastSlot(size_t block) const {
+        return block < GetCompressedBlockCount() ? GetBlocks()[block].last_slot : GetTailSlots()[GetTailSize() - 1];
+    }
+
+    double GetBlockMaxTermFrequency(size_t block) const {
+        return block < GetCompressedBlockCount() ? GetBlocks()[block].max_term_frequency : tail_max_term_frequency_;
+    }
+
+    // first block with the last slot not less than the given one, GetBlockCount() if there is no such block
+    size_t FindBlock(int slot) const {
+        const Block* blocks = GetBlocks();
+        const size_t block_count = GetCompressedBlockCount();
+
+        const Block* block = std::lower_bound(blocks, blocks + block_count, slot, [](const Block& block, int slot) {
+            return block.last_slot < slot;
+        });
+
+        if (block != blocks + block_count) {
+            return block - blocks;
+        }
+
+        return GetTailSize() != 0 && GetTailSlots()[GetTailSize() - 1] >= slot ? block_count : GetBlockCount();
+    }
+
+    // slots and counts must have room for kBlockSize values, returns number of postings in the block
+    size_t DecodeBlock(size_t block, int* slots, uint32_t* counts) const {
+        const Block* blocks = GetBlocks();
+
+        if (block == GetCompressedBlockCount()) {
+            std::copy(GetTailSlots(), GetTailSlots() + GetTailSize(), slots);
+            std::copy(GetTailCounts(), GetTailCounts() + GetTailSize(), counts);
+
+            return GetTailSize();
+        }
+
+        const Block& header = blocks[block];
+        const uint32_t* block_words = GetWords() + header.offset;
+
+        // gaps are decoded in place of slots
+        uint32_t* gaps = reinterpret_cast<uint32_t*>(slots);
+        UnpackBlock(block_words, header.slot_bits, gaps);
+        UnpackBlock(block_words + GetPackedBlockWordCount(header.slot_bits), header.count_bits, counts);
+
+        int slot = block == 0 ? -1 : blocks[block - 1].last_slot;
+        for (size_t i = 0; i < kBlockSize; ++i) {
+            slot += static_cast<int>(gaps[i]) + 1;
+            slots[i] = slot;
+            ++counts[i];
+        }
+
+        return kBlockSize;
+    }
+
+    // slots of a list read from untrusted memory, such as a snapshot file: the slots must be strictly growing and
+    // inside [begin_slot, end_slot) and the counts positive, gaps of a block are summed in 64 bits and must end
+    // at the last slot of its header
+    // headers of the blocks must point inside the words of the list
+    bool HasValidPostings(int begin_slot, int end_slot) const {
+        const Block* blocks = GetBlocks();
+
+        std::array<uint32_t, kBlockSize> gaps;
+        std::array<uint32_t, kBlockSize> counts;
+
+        int64_t previous_slot = static_cast<int64_t>(begin_slot) - 1;
+
+        for (size_t block = 0; block < GetCompressedBlockCount(); ++block) {
+            const Block& header = blocks[block];
+
+            if (header.last_slot <= previous_slot || header.last_slot >= end_slot) {
+                return false;
+            }
+
+            UnpackBlock(GetWords() + header.offset, header.slot_bits, gaps.data());
+            UnpackBlock(GetWords() + header.offset + GetPackedBlockWordCount(header.slot_bits), header.count_bits, counts.data());
+
+            // the same sum as DecodeBlock, the first block starts from -1
+            int64_t slot = block == 0 ? -1 : blocks[block - 1].last_slot;
+
+            for (size_t i = 0; i < kBlockSize; ++i) {
+                slot += static_cast<int64_t>(gaps[i]) + 1;
+
+                if ((i == 0 && slot <= previous_slot) || counts[i] == std::numeric_limits<uint32_t>::max()) {
+                    return false;
+                }
+            }
+
+            if (slot != header.last_slot) {
+                return false;
+            }
+
+            previous_slot = header.last_slot;
+        }
+
+        for (size_t i = 0; i < GetTailSize(); ++i) {
+            if (GetTailSlots()[i] <= previous_slot || GetTailSlots()[i] >= end_slot || GetTailCounts()[i] == 0) {
+                return false;
+            }
+
+            previous_slot = GetTailSlots()[i];
+        }
+
+        return true;
+    }
+
+private:
+    const uint32_t* GetWords() const {
+        return is_borrowed_ ? borrowed_words_ : words_.data();
+    }
+
+    const Block* GetBlocks() const {
+        return is_borrowed_ ? borrowed_blocks_ : blocks_.data();
+    }
+
+    size_t GetCompressedBlockCount() const {
+        return is_borrowed_ ? borrowed_block_count_ : blocks_.size();
+    }
+
+    const int* GetTailSlots() const {
+        return is_borrowed_ ? borrowed_tail_slots_ : tail_slots_.data();
+    }
+
+    const uint32_t* GetTailCounts() const {
+        return is_borrowed_ ? borrowed_tail_counts_ : tail_counts_.data();
+    }
+
+    size_t GetTailSize() const {
+        return is_borrowed_ ? borrowed_tail_size_ : tail_slots_.size();
+    }
+
+    int GetLastSlot() const {
+        return tail_slots_.empty() ? blocks_.back().last_slot : tail_slots_.back();
+    }
+
+    void CompressTail() {
+        std::array<uint32_t, kBlockSize> gaps;
+        std::array<uint32_t, kBlockSize> counts;
+
+        // slots are strictly growing and counts are positive, so both are stored minus one
+        int previous_slot = blocks_.empty() ? -1 : blocks_.back().last_slot;
+        uint32_t max_gap = 0;
+        uint32_t max_count = 0;
+
+        for (size_t i = 0; i < kBlockSize; ++i) {
+            gaps[i] = static_cast<uint32_t>(tail_slots_[i] - previous_slot - 1);
+            counts[i] = tail_counts_[i] - 1;
+            previous_slot = tail_slots_[i];
+
+            max_gap = std::max(max_gap, gaps[i]);
+            max_count = std::max(max_count, counts[i]);
+        }
+
+        Block block;
+        block.last_slot = tail_slots_.back();
+        block.offset = static_cast<uint32_t>(words_.size());
+        block.slot_bits = static_cast<uint8_t>(GetRequiredBits(max_gap));
+        block.count_bits = static_cast<uint8_t>(GetRequiredBits(max_count));
+        block.max_term_frequency = tail_max_term_frequency_;
+
+        const size_t slot_word_count = GetPackedBlockWordCount(block.slot_bits);
+
+        words_.resize(words_.size() + slot_word_count + GetPackedBlockWordCount(block.count_bits));
+        PackBlock(gaps.data(), block.slot_bits, words_.data() + block.offset);
+        PackBlock(counts.data(), block.count_bits, words_.data() + block.offset + slot_word_count);
+
+        blocks_.push_back(block);
+
+        tail_slots_.clear();
+        tail_counts_.clear();
+        tail_max_term_frequency_ = 0.0;
+    }
+
+private:
+    std::vector<uint32_t> words_;
+    std::vector<Block> blocks_;
+
+    std::vector<int> tail_slots_;
+    std::vector<uint32_t> tail_counts_;
+    double tail_max_term_frequency_ = 0.0;
+
+    // arrays of a borrowed list, the vectors above stay empty
+    bool is_borrowed_ = false;
+    const uint32_t* borrowed_words_ = nullptr;
+    const Block* borrowed_blocks_ = nullptr;
+    const int* borrowed_tail_slots_ = nullptr;
+    const uint32_t* borrowed_tail_counts_ = nullptr;
+    uint32_t borrowed_block_count_ = 0;
+    uint32_t borrowed_tail_size_ = 0;
+
+    size_t posting_count_ = 0;
+    double max_term_frequency_ = 0.0;
+};
+
+// walks postings with slots in [begin_slot, end_slot) decoding one block at a time
+// score of a posting is its count divided by the document length multiplied by weight
+class PostingCursor {
+public:
+    // inverse_lengths is indexed by slot minus first_slot
+    PostingCursor(const PostingList& posting_list, int begin_slot, int end_slot, double weight, const double* inverse_lengths, int first_slot = 0)
+        : posting_list_(&posting_list), end_slot_(end_slot), weight_(weight), inverse_lengths_(inverse_lengths), first_slot_(first_slot) {
+        block_ = posting_list.FindBlock(begin_slot);
+        bound_block_ = block_;
+
+        LoadBlock();
+        NextGreaterOrEqual(begin_slot);
+    }
+
+    bool IsEnd() const {
+        return index_ >= block_size_ || slots_[index_] >= end_slot_;
+    }
+
+    int GetSlot() const {
+        return slots_[index_];
+    }
+
+    double GetScore() const {
+        return counts_[index_] * inverse_lengths_[slots_[index_] - first_slot_] * weight_;
+    }
+
+    double GetMaxScore() const {
+        return posting_list_->GetMaxTermFrequency() * weight_;
+    }
+
+    void Next() {
+        if (++index_ == block_size_ && block_ < posting_list_->GetBlockCount()) {
+            ++block_;
+            LoadBlock();
+        }
+    }
+
+    // moves to the first posting with slot not less than the given one
+    void NextGreaterOrEqual(int slot) {
+        if (IsEnd() || GetSlot() >= slot) {
+            return;
+        }
+
+        // blocks before the one that can contain the slot are not decoded
+        if (posting_list_->GetBlockLastSlot(block_) < slot) {
+            block_ = std::max(block_ + 1, bound_block_);
+
+            while (block_ < posting_list_->GetBlockCount() && posting_list_->GetBlockLastSlot(block_) < slot) {
+                ++block_;
+            }
+
+            LoadBlock();
+        }
+
+        index_ = std::lower_bound(slots_.begin() + index_, slots_.begin() + block_size_, slot) - slots_.begin();
+    }
+
+    // upper bound of the score of the posting with the given slot, if there is one
+    // moves only the block pointer, so postings are not decoded
+    // slot must not be less than slots of the previous calls
+    double GetBlockMaxScore(int slot) {
+        while (bound_block_ < posting_list_->GetBlockCount() && posting_list_->GetBlockLastSlot(bound_block_) < slot) {
+            ++bound_block_;
+        }
+
+        if (bound_block_ == posting_list_->GetBlockCount()) {
+            return 0.0;
+        }
+
+        return posting_list_->GetBlockMaxTermFrequency(bound_block_) * weight_;
+    }
+
+private:
+    void LoadBlock() {
+        index_ = 0;
+        block_size_ = block_ < posting_list_->GetBlockCount() ? posting_list_->DecodeBlock(block_, slots_.data(), counts_.data()) : 0;
+    }
+
+private:
+    const PostingList* posting_list_;
+    int end_slot_;
+    double weight_;
+    const double* inverse_lengths_;
+    int first_slot_;
+
+    size_t block_ = 0;
+    size_t bound_block_ = 0;
+
+    std::array<int, PostingList::kBlockSize> slots_;
+    std::array<uint32_t, PostingList::kBlockSize> counts_;
+    size_t index_ = 0;
+    size_t block_size_ = 0;
+};
+
+} // namespace search_server_index
@@ -1,5 +1,6 @@
 #include <execution>
 
+#include "process_queries.h"
 #include "search_server.h"
 
 std::vector<std::vector<Document>> ProcessQueries(const SearchServer& search_server,
@@ -29,3 +30,17 @@ std::vector<Document> ProcessQueriesJoined(const SearchServer& search_server,
 
    return std::reduce(std::execution::par, documents.begin(), documents.end(), std::vector<Document>{}, func);
 }
+
+std::vector<std::vector<Document>> ProcessQueries(const ConcurrentSearchServer& search_server,
+                                                 const std::vector<std::string>& queries) {
+   return search_server.Read([&queries](const SearchServer& server) {
+       return ProcessQueries(server, queries);
+   });
+}
+
+std::vector<Document> ProcessQueriesJoined(const ConcurrentSearchServer& search_server,
+                                          const std::vector<std::string>& queries) {
+   return search_server.Read([&queries](const SearchServer& server) {
+       return ProcessQueriesJoined(server, queries);
+   });
+}
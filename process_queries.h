@@ -5,6 +5,7 @@
 #include <numeric>
 #include <execution>
 
+#include "concurrent_search_server.h"
 #include "search_server.h"
 
 std::vector<std::vector<Document>> ProcessQueries(const SearchServer& search_server,
@@ -12,3 +13,10 @@ std::vector<std::vector<Document>> ProcessQueries(const SearchServer& search_ser
 
 std::vector<Document> ProcessQueriesJoined(const SearchServer& search_server,
                                           const std::vector<std::string>& queries);
+
+// all queries of the batch see the same version of the server
+std::vector<std::vector<Document>> ProcessQueries(const ConcurrentSearchServer& search_server,
+                                                 const std::vector<std::string>& queries);
+
+std::vector<Document> ProcessQueriesJoined(const ConcurrentSearchServer& search_server,
+                                          const std::vector<std::string>& queries);
@@ -0,0 +1,311 @@
+#include "remote_sharded_search_server.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <execution>
+#include <set>
+#include <stdexcept>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "shard_protocol.h"
+#include "sharded_search_server.h"
+#include "string_processing.h"
+#include "top_documents.h"
+
+using namespace std::literals;
+
+using shard_protocol::MessageType;
+using shard_protocol::ResponseStatus;
+
+ShardSocketClient::ShardSocketClient(const std::string& socket_path) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+
+    if (socket_path.empty() || socket_path.size() >= sizeof(address.sun_path)) {
+        throw std::invalid_argument("invalid socket path"s);
+    }
+
+    std::memcpy(address.sun_path, socket_path.data(), socket_path.size());
+
+    socket_ = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (socket_ < 0) {
+        throw std::runtime_error("failed to create shard socket: "s + std::strerror(errno));
+    }
+
+    if (connect(socket_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0) {
+        const std::string error = std::strerror(errno);
+        close(socket_);
+
+        throw std::runtime_error("failed to connect to shard "s + socket_path + ": "s + error);
+    }
+}
+
+ShardSocketClient::~ShardSocketClient() {
+    close(socket_);
+}
+
+std::string ShardSocketClient::Call(std::string_view request) {
+    std::string response;
+
+    {
+        const std::lock_guard guard(mutex_);
+
+        if (is_failed_) {
+            throw std::runtime_error("connection to the shard is broken"s);
+        }
+
+        // after a partial frame the stream is out of sync, so the connection is not used again
+        try {
+            shard_protocol::SendFrame(socket_, request);
+
+            if (!shard_protocol::ReceiveFrame(socket_, response)) {
+                throw std::runtime_error("shard has closed the connection"s);
+            }
+        } catch (const std::runtime_error&) {
+            is_failed_ = true;
+            throw;
+        }
+    }
+
+    shard_protocol::Reader reader(response);
+    const auto status = static_cast<ResponseStatus>(reader.ReadUint8());
+
+    switch (status) {
+        case ResponseStatus::OK:
+            return response.substr(1);
+        case ResponseStatus::INVALID_ARGUMENT:
+            throw std::invalid_argument(std::string(reader.ReadString()));
+        case ResponseStatus::OUT_OF_RANGE:
+            throw std::out_of_range(std::string(reader.ReadString()));
+        default:
+            throw std::runtime_error("shard error: "s + std::string(reader.ReadString()));
+    }
+} // Call
+
+template<typename Function>
+void RemoteShardedSearchServer::ForEachShard(Function function) const {
+    std::vector<std::exception_ptr> shard_to_error(shards_.size());
+
+    std::vector<int> shard_indexes(shards_.size());
+    for (size_t i = 0; i < shard_indexes.size(); ++i) {
+        shard_indexes[i] = static_cast<int>(i);
+    }
+
+    // the shards work in parallel anyway, threads only wait for their responses
+    std::for_each(std::execution::par, shard_indexes.begin(), shard_indexes.end(), [&](int shard_index) {
+        // exceptions must not leave a parallel algorithm
+        try {
+            function(shard_index);
+        } catch (...) {
+            shard_to_error[shard_index] = std::current_exception();
+        }
+    });
+
+    for (const auto& error : shard_to_error) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+RemoteShardedSearchServer::RemoteShardedSearchServer(const std::vector<std::string>& socket_paths) {
+    if (socket_paths.empty()) {
+        throw std::invalid_argument("there must be at least one shard"s);
+    }
+
+    shards_.reserve(socket_paths.size());
+    for (const std::string& socket_path : socket_paths) {
+        shards_.push_back(std::make_unique<ShardSocketClient>(socket_path));
+    }
+}
+
+bool RemoteShardedSearchServer::AddDocument(int document_id, const std::string_view document,
+                                            DocumentStatus status, const std::vector<int>& ratings) {
+    if (document_id < 0) {
+        throw std::invalid_argument("negative ids are not allowed"s);
+    }
+
+    shard_protocol::Writer request;
+    request.WriteUint8(static_cast<uint8_t>(MessageType::ADD_DOCUMENT));
+    request.WriteInt32(document_id);
+    request.WriteString(document);
+    request.WriteDocumentStatus(status);
+
+    request.WriteUint32(static_cast<uint32_t>(ratings.size()));
+    for (const int rating : ratings) {
+        request.WriteInt32(rating);
+    }
+
+    const std::string response = shards_[GetShardIndex(document_id)]->Call(request.GetData());
+
+    return shard_protocol::Reader(response).ReadUint8() != 0;
+}
+
+void RemoteShardedSearchServer::AddDocuments(const std::vector<SearchServer::NewDocument>& documents) {
+    // the whole batch is checked before any shard gets its part, as ShardedSearchServer does,
+    // ids already added are checked by their shards
+    std::vector<std::vector<const SearchServer::NewDocument*>> shard_to_documents(shards_.size());
+    std::set<int> new_document_ids;
+
+    for (const SearchServer::NewDocument& document : documents) {
+        if (document.document_id < 0) {
+            throw std::invalid_argument("negative ids are not allowed"s);
+        }
+
+        if (!new_document_ids.insert(document.document_id).second) {
+            throw std::invalid_argument("repeating ids are not allowed"s);
+        }
+
+        if (string_processing::ContainsControlChars(document.text)) {
+            throw std::invalid_argument("word in document contains unaccaptable symbol"s);
+        }
+
+        shard_to_documents[GetShardIndex(document.document_id)].push_back(&document);
+    }
+
+    ForEachShard([&](int shard_index) {
+        shard_protocol::Writer request;
+        request.WriteUint8(static_cast<uint8_t>(MessageType::CHECK_DOCUMENT_IDS));
+        request.WriteUint32(static_cast<uint32_t>(shard_to_documents[shard_index].size()));
+
+        for (const SearchServer::NewDocument* document : shard_to_documents[shard_index]) {
+            request.WriteInt32(document->document_id);
+        }
+
+        shards_[shard_index]->Call(request.GetData());
+    });
+
+    ForEachShard([&](int shard_index) {
+        shard_protocol::Writer request;
+        request.WriteUint8(static_cast<uint8_t>(MessageType::ADD_DOCUMENTS));
+        request.WriteUint32(static_cast<uint32_t>(shard_to_documents[shard_index].size()));
+
+        for (const SearchServer::NewDocument* document : shard_to_documents[shard_index]) {
+            request.WriteInt32(document->document_id);
+            request.WriteString(document->text);
+            request.WriteDocumentStatus(document->status);
+
+            request.WriteUint32(static_cast<uint32_t>(document->ratings.size()));
+            for (const int rating : document->ratings) {
+                request.WriteInt32(rating);
+            }
+        }
+
+        shards_[shard_index]->Call(request.GetData());
+    });
+}
+
+void RemoteShardedSearchServer::RemoveDocument(const int document_id) {
+    if (document_id < 0) {
+        return;
+    }
+
+    shard_protocol::Writer request;
+    request.WriteUint8(static_cast<uint8_t>(MessageType::REMOVE_DOCUMENT));
+    request.WriteInt32(document_id);
+
+    shards_[GetShardIndex(document_id)]->Call(request.GetData());
+}
+
+int RemoteShardedSearchServer::GetDocumentCount() const {
+    std::vector<int> shard_to_document_count(shards_.size());
+
+    ForEachShard([&](int shard_index) {
+        shard_protocol::Writer request;
+        request.WriteUint8(static_cast<uint8_t>(MessageType::GET_DOCUMENT_COUNT));
+
+        const std::string response = shards_[shard_index]->Call(request.GetData());
+        shard_to_document_count[shard_index] = shard_protocol::Reader(response).ReadInt32();
+    });
+
+    int document_count = 0;
+    for (const int shard_document_count : shard_to_document_count) {
+        document_count += shard_document_count;
+    }
+
+    return document_count;
+}
+
+int RemoteShardedSearchServer::GetShardCount() const {
+    return static_cast<int>(shards_.size());
+}
+
+std::vector<Document> RemoteShardedSearchServer::FindTopDocuments(const std::string_view raw_query,
+                                                                  const DocumentStatus& desired_status, int max_result_document_count) const {
+    // gather: document frequencies of the query words in the whole collection, bad queries are rejected here
+    std::vector<SearchServer::CollectionStatistics> shard_to_statistics(shards_.size());
+
+    ForEachShard([&](int shard_index) {
+        shard_protocol::Writer request;
+        request.WriteUint8(static_cast<uint8_t>(MessageType::GET_COLLECTION_STATISTICS));
+        request.WriteString(raw_query);
+
+        const std::string response = shards_[shard_index]->Call(request.GetData());
+        shard_to_statistics[shard_index] = shard_protocol::Reader(response).ReadCollectionStatistics();
+    });
+
+    SearchServer::CollectionStatistics statistics;
+    for (const auto& shard_statistics : shard_to_statistics) {
+        statistics += shard_statistics;
+    }
+
+    // scatter: every shard finds its own top, the request is the same for all of them
+    shard_protocol::Writer request;
+    request.WriteUint8(static_cast<uint8_t>(MessageType::FIND_TOP_DOCUMENTS));
+    request.WriteString(raw_query);
+    request.WriteDocumentStatus(desired_status);
+    request.WriteInt32(max_result_document_count);
+    request.WriteCollectionStatistics(statistics);
+
+    std::vector<search_server_index::TopDocuments> shard_to_top_documents(shards_.size(),
+                                                                          search_server_index::TopDocuments(max_result_document_count));
+
+    ForEachShard([&](int shard_index) {
+        const std::string response = shards_[shard_index]->Call(request.GetData());
+        shard_protocol::Reader reader(response);
+
+        // a document has its id, relevance and rating
+        const uint32_t document_count = reader.ReadCount(16);
+        for (uint32_t i = 0; i < document_count; ++i) {
+            shard_to_top_documents[shard_index].Push(reader.ReadDocument());
+        }
+    });
+
+    search_server_index::TopDocuments top_documents(max_result_document_count);
+    for (const auto& shard_top_documents : shard_to_top_documents) {
+        top_documents.Merge(shard_top_documents);
+    }
+
+    return top_documents.Extract();
+}
+
+std::tuple<std::vector<std::string>, DocumentStatus> RemoteShardedSearchServer::MatchDocument(const std::string_view raw_query,
+                                                                                              const int document_id) const {
+    if (document_id < 0) {
+        throw std::out_of_range("document is not found"s);
+    }
+
+    shard_protocol::Writer request;
+    request.WriteUint8(static_cast<uint8_t>(MessageType::MATCH_DOCUMENT));
+    request.WriteString(raw_query);
+    request.WriteInt32(document_id);
+
+    const std::string response = shards_[GetShardIndex(document_id)]->Call(request.GetData());
+    shard_protocol::Reader reader(response);
+
+    std::vector<std::string> words(reader.ReadCount(4));
+    for (std::string& word : words) {
+        word = reader.ReadString();
+    }
+
+    return {words, reader.ReadDocumentStatus()};
+}
+
+int RemoteShardedSearchServer::GetShardIndex(int document_id) const {
+    return ShardedSearchServer::GetShardIndex(document_id, static_cast<int>(shards_.size()));
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include "document.h"
+#include "search_server.h"
+
+// connection to a shard served by ShardSocketServer
+// calls from different threads are serialized
+// the client does not reconnect, after an error of the socket every call throws std::runtime_error
+class ShardSocketClient {
+public:
+    // throws std::runtime_error if the shard is not listening on the socket
+    explicit ShardSocketClient(const std::string& socket_path);
+
+    ShardSocketClient(const ShardSocketClient&) = delete;
+    ShardSocketClient& operator=(const ShardSocketClient&) = delete;
+
+    ~ShardSocketClient();
+
+public:
+    // sends the request and returns the response without its status
+    // errors of the shard are rethrown as std::invalid_argument, std::out_of_range or std::runtime_error
+    std::string Call(std::string_view request);
+
+private:
+    int socket_ = -1;
+    bool is_failed_ = false;
+    std::mutex mutex_;
+};
+
+// coordinator of shards running in other processes, documents are split between them as in ShardedSearchServer
+// a query is sent to all shards in parallel with the statistics of the whole collection,
+// so the merged top is the same as the top of one server with all the documents
+// documents are filtered by status on the shards, predicates can not be sent to other processes
+class RemoteShardedSearchServer {
+public:
+    explicit RemoteShardedSearchServer(const std::vector<std::string>& socket_paths);
+
+public:
+    bool AddDocument(int document_id, const std::string_view document,
+                     DocumentStatus status, const std::vector<int>& ratings);
+
+    // every shard adds its part of the documents in parallel, nothing is added if any of the documents is rejected
+    // the ids are checked by the shards before the documents are sent, a concurrent writer adding the same id
+    // in between still makes its shard reject its part
+    void AddDocuments(const std::vector<SearchServer::NewDocument>& documents);
+
+    void RemoveDocument(const int document_id);
+
+    int GetDocumentCount() const;
+
+    int GetShardCount() const;
+
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query,
+                                           const DocumentStatus& desired_status = DocumentStatus::ACTUAL,
+                                           int max_result_document_count = SearchServer::kMaxResultDocumentCount) const;
+
+    // the words are copied from the response of the shard
+    std::tuple<std::vector<std::string>, DocumentStatus> MatchDocument(const std::string_view raw_query, const int document_id) const;
+
+private:
+    int GetShardIndex(int document_id) const;
+
+    // calls function(shard_index) for every shard in parallel and rethrows the first error
+    template<typename Function>
+    void ForEachShard(Function function) const;
+
+private:
+    std::vector<std::unique_ptr<ShardSocketClient>> shards_;
+};
@@ -1,7 +1,10 @@
 #include "remove_duplicates.h"
 
-#include <set>
+#include <algorithm>
+#include <map>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <iostream>
 #include <vector>
 
@@ -10,26 +13,37 @@ using namespace std::literals;
 namespace remove_duplicates {
 
 void RemoveDuplicates(SearchServer& search_server) {
-    std::set<std::set<std::string>> unique_documents;
+    // words of a document come in order of term ids, so documents with the same words give equal vectors
+    // views of the words stay valid until the duplicates are removed
+    // documents come in order of addition, the one with the least id is kept
+    std::map<std::vector<std::string_view>, int> words_to_document_id;
     
     std::vector<int> duplicate_document_ids;
     
     for (const int document_id : search_server) {
         const auto words_to_term_frequencies = search_server.GetWordFrequencies(document_id);
         
-        std::set<std::string> words_in_document;
+        std::vector<std::string_view> words_in_document;
+        words_in_document.reserve(words_to_term_frequencies.size());
         
         for (const auto& [word, term_frequency] : words_to_term_frequencies) {
-            words_in_document.emplace(word);
+            words_in_document.push_back(word);
         }
         
-        if (!unique_documents.insert(words_in_document).second) {
-            duplicate_document_ids.push_back(document_id);
-            std::cout << "Found duplicate document id "s << document_id << std::endl;
+        const auto [iterator_to_document, is_unique] = words_to_document_id.emplace(std::move(words_in_document), document_id);
+        
+        if (!is_unique) {
+            int& kept_document_id = iterator_to_document->second;
+            
+            duplicate_document_ids.push_back(std::max(kept_document_id, document_id));
+            kept_document_id = std::min(kept_document_id, document_id);
         }
     }
     
+    std::sort(duplicate_document_ids.begin(), duplicate_document_ids.end());
+    
     for (const int duplicate_id : duplicate_document_ids) {
+        std::cout << "Found duplicate document id "s << duplicate_id << std::endl;
         search_server.RemoveDocument(duplicate_id);
     }
 }
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace search_server_index {
+
+// dense relevance accumulator indexed by document slot
+// slots touched by the current query are stamped with the query epoch and listed,
+// so starting a new query does not require clearing the arrays
+class ScoreAccumulator {
+public:
+    // prepares accumulator for a query over slots [0, slot_count)
+    void Reset(size_t slot_count) {
+        if (scores_.size() < slot_count) {
+            scores_.resize(slot_count);
+            stamps_.resize(slot_count, 0);
+        }
+
+        touched_slots_.clear();
+
+        // on overflow old stamps could be mistaken for the current epoch
+        if (++epoch_ == 0) {
+            std::fill(stamps_.begin(), stamps_.end(), 0);
+            epoch_ = 1;
+        }
+    }
+
+    void Add(int slot, double relevance) {
+        if (stamps_[slot] != epoch_) {
+            stamps_[slot] = epoch_;
+            scores_[slot] = relevance;
+            touched_slots_.push_back(slot);
+        } else {
+            scores_[slot] += relevance;
+        }
+    }
+
+    // excluded slot stays excluded whatever is added to it later
+    void Exclude(int slot) {
+        stamps_[slot] = epoch_;
+        scores_[slot] = kExcluded;
+    }
+
+    bool IsExcluded(int slot) const {
+        return scores_[slot] == kExcluded;
+    }
+
+    double GetRelevance(int slot) const {
+        return scores_[slot];
+    }
+
+    // slots that got relevance in the current query, in order of the first touch
+    const std::vector<int>& GetTouchedSlots() const {
+        return touched_slots_;
+    }
+
+private:
+    static constexpr double kExcluded = -std::numeric_limits<double>::infinity();
+
+private:
+    std::vector<double> scores_;
+    std::vector<uint32_t> stamps_;
+    std::vector<int> touched_slots_;
+    uint32_t epoch_ = 0;
+};
+
+// every thread reuses its own accumulator, so scoring does not allocate once the arrays have grown
+inline ScoreAccumulator& GetThreadScoreAccumulator() {
+    thread_local ScoreAccumulator accumulator;
+    return accumulator;
+}
+
+} // namespace search_server_index
@@ -6,27 +6,80 @@
 #include <numeric>
 
 #include "search_server.h"
+#include "index_snapshot.h"
 #include "string_processing.h"
 #include "log_duration.h"
 
 using namespace std::literals;
 
-std::set<int>::const_iterator SearchServer::begin() const {
-    return document_ids_.begin();
+namespace {
+
+// records of the snapshot sections, their layout is a part of the snapshot format
+struct SnapshotDocument {
+    int32_t document_id = 0;
+    int32_t rating = 0;
+    int32_t status = 0;
+    int32_t length = 0;
+};
+
+struct SnapshotSegment {
+    int32_t begin_slot = 0;
+    int32_t slot_count = 0;
+    int32_t purged_slot_count = 0;
+    int32_t padding = 0;
+    uint64_t term_count = 0;
+    uint64_t block_count = 0;
+    uint64_t word_count = 0;
+    uint64_t tail_posting_count = 0;
+};
+
+// offsets are indexes in the arrays of the segment
+struct SnapshotPostingList {
+    uint64_t block_offset = 0;
+    uint64_t block_count = 0;
+    uint64_t word_offset = 0;
+    uint64_t word_count = 0;
+    uint64_t tail_offset = 0;
+    uint64_t tail_size = 0;
+    uint64_t posting_count = 0;
+    double tail_max_term_frequency = 0.0;
+    double max_term_frequency = 0.0;
+};
+
+void CheckSnapshot(bool condition) {
+    if (!condition) {
+        throw std::runtime_error("snapshot is corrupted"s);
+    }
 }
 
-std::set<int>::const_iterator SearchServer::end() const {
-    return document_ids_.end();
+} // namespace
+
+SearchServer::DocumentIdIterator SearchServer::begin() const {
+    return {this, 0};
+}
+
+SearchServer::DocumentIdIterator SearchServer::end() const {
+    return {this, static_cast<int>(slot_to_document_data_.size())};
 }
 
-const std::map<std::string_view, double>& SearchServer::GetWordFrequencies(int document_id) const {
-    const static std::map<std::string_view, double> empty_map;
+SearchServer::WordFrequencies SearchServer::GetWordFrequencies(int document_id) const {
+    WordFrequencies word_frequencies;
+    word_frequencies.term_id_to_word_ = &term_id_to_word_;
+    word_frequencies.word_to_term_id_ = &word_to_term_id_;
     
-    if (document_id_to_document_data_.count(document_id) > 0) {
-        return document_id_to_document_data_.at(document_id).word_frequencies;
+    const auto iterator_to_slot = document_id_to_slot_.find(document_id);
+    
+    if (iterator_to_slot != document_id_to_slot_.end()) {
+        const int slot = iterator_to_slot->second;
+        
+        const int length = slot_to_document_data_[slot].length;
+        
+        word_frequencies.begin_ = forward_index_.begin(slot);
+        word_frequencies.end_ = forward_index_.end(slot);
+        word_frequencies.inverse_length_ = length == 0 ? 0.0 : 1.0 / static_cast<double>(length);
     }
     
-    return empty_map;
+    return word_frequencies;
 }
 
 void SearchServer::RemoveDocument(const int document_id) {
@@ -35,9 +88,7 @@ void SearchServer::RemoveDocument(const int document_id) {
 
 bool SearchServer::IsValidWord(const std::string_view word) const {
     // A valid word must not contain special characters
-    return std::none_of(word.begin(), word.end(), [](auto c) {
-        return c >= '\0' && c < ' ';
-    });
+    return !string_processing::ContainsControlChars(word);
 }
 
 SearchServer::SearchServer(const std::string& stop_words) {
@@ -57,80 +108,694 @@ SearchServer::SearchServer(const std::string_view stop_words) {
 }
 
 void SearchServer::SetStopWords(const std::string_view text) {
-    for (const auto word : string_processing::SplitIntoWords(text)) {
-        stop_words_.emplace(word);
-    }
+    const string_processing::WordRange words(text);
+    
+    stop_words_ = search_server_index::StopWordSet(std::vector<std::string>(words.begin(), words.end()));
 } // SetStopWords
 
 bool SearchServer::AddDocument(int document_id, const std::string_view document,
                                DocumentStatus status, const std::vector<int>& ratings) {
+    return IndexDocument(document_id, document, nullptr, status, ratings);
+} // AddDocument
+
+bool SearchServer::IndexDocument(int document_id, const std::string_view document, const std::shared_ptr<const void>& text_owner,
+                                 DocumentStatus status, const std::vector<int>& ratings) {
+    CheckDocumentId(document_id);
+    
+    const int slot = static_cast<int>(slot_to_document_data_.size());
+    
+    // words are interned as they are found, the text is split and validated in one pass
+    std::vector<int> term_ids;
+    
+    const bool is_valid = ForEachWordNoStop(document, [this, &term_ids, &text_owner](const std::string_view word) {
+        term_ids.push_back(AddTerm(word, text_owner)->second);
+    });
+    
+    if (!is_valid) {
+        // terms added by the words before the invalid one have no documents
+        for (const int term_id : term_ids) {
+            if (term_id_to_document_frequency_[term_id] == 0 && term_id_to_word_[term_id].data() != nullptr) {
+                ReleaseTerm(word_to_term_id_.find(term_id_to_word_[term_id]));
+            }
+        }
+        
+        throw std::invalid_argument("word in document contains unaccaptable symbol"s);
+    }
+    
+    const int word_count = static_cast<int>(term_ids.size());
+    const double inverse_word_count = word_count == 0 ? 0.0 : 1.0 / static_cast<double>(word_count);
+    
+    // postings keep numbers of occurrences
+    std::sort(term_ids.begin(), term_ids.end());
+    
+    std::vector<std::pair<int, uint32_t>> term_counts;
+    
+    for (auto begin = term_ids.begin(); begin != term_ids.end();) {
+        const auto end = std::upper_bound(begin, term_ids.end(), *begin);
+        
+        term_counts.emplace_back(*begin, static_cast<uint32_t>(end - begin));
+        ++term_id_to_document_frequency_[*begin];
+        begin = end;
+    }
+    
+    mutable_segment_->AddDocument(slot, term_counts, inverse_word_count);
+    forward_index_.AddSlot(term_counts);
+    
+    document_id_to_slot_.emplace(document_id, slot);
+    
+    slot_to_document_data_.push_back({document_id, ComputeAverageRating(ratings), status, word_count});
+    
+    term_id_to_inverse_document_frequency_.Invalidate();
+    
+    MaintainSegments();
+    
+    return true; // this return is kind of redundant
+} // IndexDocument
+
+bool SearchServer::AddDocumentKeepingText(int document_id, std::string document,
+                                          DocumentStatus status, const std::vector<int>& ratings) {
+    auto text = std::make_shared<const std::string>(std::move(document));
+    const std::string_view text_view = *text;
+    
+    return AddDocumentKeepingText(document_id, text_view, std::move(text), status, ratings);
+} // AddDocumentKeepingText
+
+bool SearchServer::AddDocumentKeepingText(int document_id, const std::string_view document, std::shared_ptr<const void> text_owner,
+                                          DocumentStatus status, const std::vector<int>& ratings) {
+    IndexDocument(document_id, document, text_owner, status, ratings);
+    
+    const int slot = document_id_to_slot_.at(document_id);
+    slot_to_text_.resize(slot + 1);
+    slot_to_text_[slot] = {document, std::move(text_owner)};
+    
+    return true;
+} // AddDocumentKeepingText
+
+std::string_view SearchServer::GetDocumentText(int document_id) const {
+    const auto iterator_to_slot = document_id_to_slot_.find(document_id);
+    
+    if (iterator_to_slot == document_id_to_slot_.end()) {
+        return {};
+    }
+    
+    const size_t slot = static_cast<size_t>(iterator_to_slot->second);
+    
+    return slot < slot_to_text_.size() ? slot_to_text_[slot].text : std::string_view();
+} // GetDocumentText
+
+void SearchServer::AddDocuments(const std::vector<NewDocument>& documents) {
+    AddDocuments(std::execution::seq, documents);
+} // AddDocuments
+
+void SearchServer::CheckDocumentId(int document_id) const {
     if (document_id < 0) {
         throw std::invalid_argument("negative ids are not allowed"s);
     }
     
-    if (document_id_to_document_data_.count(document_id) > 0) {
+    if (document_id_to_slot_.count(document_id) > 0) {
         throw std::invalid_argument("repeating ids are not allowed"s);
     }
+} // CheckDocumentId
+
+void SearchServer::CheckNewDocuments(const std::vector<NewDocument>& documents) const {
+    std::set<int> new_document_ids;
     
-    if (!IsValidWord(document)) {
-        throw std::invalid_argument("word in document contains unaccaptable symbol"s);
+    for (const NewDocument& document : documents) {
+        CheckDocumentId(document.document_id);
+        
+        if (!new_document_ids.insert(document.document_id).second) {
+            throw std::invalid_argument("repeating ids are not allowed"s);
+        }
+        
+        if (string_processing::ContainsControlChars(document.text)) {
+            throw std::invalid_argument("word in document contains unaccaptable symbol"s);
+        }
+    }
+} // CheckNewDocuments
+
+int SearchServer::GetDocumentCount() const {
+    return static_cast<int>(document_id_to_slot_.size());
+} // GetDocumentCount
+
+void SearchServer::SetQueryMode(QueryMode query_mode) {
+    query_mode_ = query_mode;
+}
+
+SearchServer::QueryMode SearchServer::GetQueryMode() const {
+    return query_mode_;
+}
+
+void SearchServer::SetMaxMutableSegmentDocumentCount(int document_count) {
+    if (document_count <= 0) {
+        throw std::invalid_argument("segment must be able to keep documents"s);
     }
     
-    const std::vector<std::string_view> words = SplitIntoWordsNoStop(document);
+    max_mutable_segment_document_count_ = document_count;
+    
+    MaintainSegments();
+}
 
-    // save words to the server
-    for (const auto word : words) {
-        words_storage_.Insert(word);
+int SearchServer::GetSegmentCount() const {
+    return static_cast<int>(sealed_segments_.size()) + 1;
+}
+
+SearchServer::MemoryStats SearchServer::GetMemoryStats() const {
+    using namespace search_server_index;
+    
+    MemoryStats stats;
+    
+    stats.stop_words = stop_words_.GetMemoryUsage();
+    
+    stats.word_storage_words = words_storage_.GetWordsMemoryUsage();
+    stats.word_storage_views = words_storage_.GetViewsMemoryUsage();
+    
+    stats.term_dictionary = GetHashMapMemoryUsage(word_to_term_id_);
+    stats.term_dictionary += GetVectorMemoryUsage(term_id_to_word_);
+    stats.term_dictionary += GetVectorMemoryUsage(term_id_to_word_owner_);
+    stats.term_dictionary += GetVectorMemoryUsage(term_id_to_document_frequency_);
+    stats.term_dictionary += GetVectorMemoryUsage(free_term_ids_);
+    stats.term_dictionary += term_id_to_inverse_document_frequency_.GetMemoryUsage();
+    
+    stats.inverted_index.overhead_bytes = GetVectorMemoryUsage(sealed_segments_).GetTotalBytes();
+    for (const Segment* segment : GetSegments()) {
+        stats.inverted_index += segment->GetMemoryUsage();
     }
     
-    const double inverse_word_count = 1.0 / static_cast<double>(words.size());
+    stats.document_data = GetHashMapMemoryUsage(document_id_to_slot_);
+    stats.document_data += GetVectorMemoryUsage(slot_to_document_data_);
     
-    std::map<std::string_view, double> word_frequencies;
+    stats.word_frequencies = forward_index_.GetMemoryUsage();
     
-    for (const std::string_view word : words) {
-        // WordStorage has all the words that have been added to the search_server 
-        const auto iterator_to_word_view_in_storage = words_storage_.Find(word);
-        assert(iterator_to_word_view_in_storage != words_storage_.end());
+    stats.document_texts = GetVectorMemoryUsage(slot_to_text_);
+    for (const DocumentText& document_text : slot_to_text_) {
+        if (document_text.owner != nullptr && document_text.owner != snapshot_) {
+            stats.document_texts.payload_bytes += document_text.text.size();
+        }
+    }
+    
+    stats.removed_documents = removed_slots_.GetMemoryUsage();
+    
+    stats.mapped_snapshot_bytes = snapshot_bytes_;
+    
+    return stats;
+} // GetMemoryStats
+
+void SearchServer::WaitForMerges() {
+    while (segment_merge_scheduler_.IsMerging()) {
+        segment_merge_scheduler_.Install(sealed_segments_, true);
+        segment_merge_scheduler_.Schedule(sealed_segments_, max_mutable_segment_document_count_, removed_slots_);
+    }
+}
 
-        // use string views that store data in words_storage_ as keys
-        word_to_document_id_to_term_frequency_[*iterator_to_word_view_in_storage][document_id] += inverse_word_count;
-        word_frequencies[*iterator_to_word_view_in_storage] += inverse_word_count;
+void SearchServer::CompactSegments() {
+    WaitForMerges();
+    
+    if (removed_slots_.GetCount() == 0) {
+        return;
     }
     
-    document_ids_.insert(document_id);
+    SealMutableSegment();
     
-    document_id_to_document_data_.emplace(document_id, DocumentData{ComputeAverageRating(ratings), status, word_frequencies});
+    // live documents get consecutive slots in the order of their old slots, so every segment is renumbered on its own
+    std::vector<int> begin_slots;
+    begin_slots.reserve(sealed_segments_.size());
     
-    return true; // this return is kind of redundant
-} // AddDocument
+    int end_slot = 0;
+    for (const auto& segment : sealed_segments_) {
+        begin_slots.push_back(end_slot);
+        end_slot += segment->GetSlotCount() - static_cast<int>(removed_slots_.Count(segment->GetBeginSlot(), segment->GetEndSlot()));
+    }
+    
+    std::vector<size_t> indexes(sealed_segments_.size());
+    for (size_t i = 0; i < indexes.size(); ++i) {
+        indexes[i] = i;
+    }
+    
+    std::for_each(std::execution::par, indexes.begin(), indexes.end(), [this, &begin_slots](size_t i) {
+        sealed_segments_[i] = std::make_shared<const search_server_index::Segment>(
+            search_server_index::Segment::Renumber(*sealed_segments_[i], removed_slots_, begin_slots[i]));
+    });
+    
+    sealed_segments_.erase(std::remove_if(sealed_segments_.begin(), sealed_segments_.end(), [](const auto& segment) {
+        return segment->GetSlotCount() == 0;
+    }), sealed_segments_.end());
+    
+    mutable_segment_ = std::make_shared<search_server_index::Segment>(end_slot);
+    
+    forward_index_.EraseSlots(removed_slots_);
+    
+    std::vector<DocumentData> slot_to_document_data;
+    slot_to_document_data.reserve(end_slot);
+    
+    std::vector<DocumentText> slot_to_text;
+    
+    for (size_t slot = 0; slot < slot_to_document_data_.size(); ++slot) {
+        if (removed_slots_.Contains(static_cast<int>(slot))) {
+            continue;
+        }
+        
+        const int new_slot = static_cast<int>(slot_to_document_data.size());
+        
+        if (slot < slot_to_text_.size() && slot_to_text_[slot].owner != nullptr) {
+            slot_to_text.resize(new_slot + 1);
+            slot_to_text[new_slot] = std::move(slot_to_text_[slot]);
+        }
+        
+        document_id_to_slot_[slot_to_document_data_[slot].document_id] = new_slot;
+        slot_to_document_data.push_back(slot_to_document_data_[slot]);
+    }
+    
+    slot_to_document_data_ = std::move(slot_to_document_data);
+    slot_to_text_ = std::move(slot_to_text);
+    
+    removed_slots_ = {};
+    
+    // the scheduler remembers the removed slots it has checked
+    segment_merge_scheduler_ = {};
+} // CompactSegments
 
-int SearchServer::GetDocumentCount() const {
-    return static_cast<int>(document_id_to_document_data_.size());
-} // GetDocumentCount
+void SearchServer::SaveSnapshot(const std::string& path) const {
+    using search_server_index::PostingList;
+    
+    search_server_index::SnapshotWriter writer(path);
+    
+    writer.Write<uint64_t>(stop_words_.size());
+    for (const std::string& stop_word : stop_words_) {
+        writer.WriteString(stop_word);
+    }
+    
+    // dictionary: words of the term ids one after another, released term ids have no words and no documents
+    const size_t term_count = term_id_to_document_frequency_.size();
+    
+    std::vector<uint64_t> word_offsets(term_count + 1, 0);
+    for (size_t term_id = 0; term_id < term_count; ++term_id) {
+        word_offsets[term_id + 1] = word_offsets[term_id] + term_id_to_word_[term_id].size();
+    }
+    
+    writer.Write<uint64_t>(term_count);
+    writer.WriteArray(word_offsets.data(), word_offsets.size());
+    
+    std::string words;
+    words.reserve(word_offsets.back());
+    for (const std::string_view word : term_id_to_word_) {
+        words += word;
+    }
+    
+    writer.WriteArray(words.data(), words.size());
+    const std::vector<uint64_t> document_frequencies(term_id_to_document_frequency_.begin(), term_id_to_document_frequency_.end());
+    writer.WriteArray(document_frequencies.data(), document_frequencies.size());
+    
+    // documents by slot, removed ones included, forward index entries are written for the documents that are not removed
+    const size_t slot_count = slot_to_document_data_.size();
+    
+    std::vector<SnapshotDocument> documents;
+    documents.reserve(slot_count);
+    
+    std::vector<uint64_t> term_count_offsets(slot_count + 1, 0);
+    std::vector<search_server_index::TermCount> term_counts;
+    
+    for (size_t slot = 0; slot < slot_count; ++slot) {
+        const DocumentData& document_data = slot_to_document_data_[slot];
+        documents.push_back({document_data.document_id, document_data.rating, static_cast<int32_t>(document_data.status), document_data.length});
+        
+        // terms of removed documents could be released
+        if (!removed_slots_.Contains(static_cast<int>(slot))) {
+            term_counts.insert(term_counts.end(), forward_index_.begin(static_cast<int>(slot)), forward_index_.end(static_cast<int>(slot)));
+        }
+        
+        term_count_offsets[slot + 1] = term_counts.size();
+    }
+    
+    writer.Write<uint64_t>(slot_count);
+    writer.WriteArray(documents.data(), documents.size());
+    writer.WriteArray(term_count_offsets.data(), term_count_offsets.size());
+    writer.WriteArray(term_counts.data(), term_counts.size());
+    
+    std::vector<int32_t> removed_slots;
+    removed_slots.reserve(removed_slots_.GetCount());
+    for (size_t slot = 0; slot < slot_count; ++slot) {
+        if (removed_slots_.Contains(static_cast<int>(slot))) {
+            removed_slots.push_back(static_cast<int32_t>(slot));
+        }
+    }
+    
+    writer.Write<uint64_t>(removed_slots.size());
+    writer.WriteArray(removed_slots.data(), removed_slots.size());
+    
+    writer.Write<int32_t>(max_mutable_segment_document_count_);
+    writer.Write<int32_t>(static_cast<int32_t>(query_mode_));
+    
+    // segments, the mutable one is written as a sealed segment with sorted terms
+    std::vector<const search_server_index::Segment*> segments = GetSegments();
+    if (segments.back()->GetSlotCount() == 0) {
+        segments.pop_back();
+    }
+    
+    writer.Write<uint64_t>(segments.size());
+    
+    for (const search_server_index::Segment* segment : segments) {
+        std::vector<std::pair<int, const PostingList*>> posting_lists;
+        segment->ForEachPostingList([&posting_lists](int term_id, const PostingList& posting_list) {
+            posting_lists.emplace_back(term_id, &posting_list);
+        });
+        
+        std::sort(posting_lists.begin(), posting_lists.end());
+        
+        SnapshotSegment header;
+        header.begin_slot = segment->GetBeginSlot();
+        header.slot_count = segment->GetSlotCount();
+        header.purged_slot_count = segment->GetPurgedSlotCount();
+        header.term_count = posting_lists.size();
+        
+        std::vector<int32_t> term_ids;
+        std::vector<SnapshotPostingList> posting_list_headers;
+        term_ids.reserve(posting_lists.size());
+        posting_list_headers.reserve(posting_lists.size());
+        
+        for (const auto& [term_id, posting_list] : posting_lists) {
+            const PostingList::Data data = posting_list->GetData();
+            
+            term_ids.push_back(term_id);
+            posting_list_headers.push_back({header.block_count, data.block_count, header.word_count, data.word_count,
+                                            header.tail_posting_count, data.tail_size, data.posting_count,
+                                            data.tail_max_term_frequency, data.max_term_frequency});
+            
+            header.block_count += data.block_count;
+            header.word_count += data.word_count;
+            header.tail_posting_count += data.tail_size;
+        }
+        
+        writer.Write(header);
+        writer.WriteArray(term_ids.data(), term_ids.size());
+        writer.WriteArray(segment->GetInverseLengths(), static_cast<size_t>(header.slot_count));
+        writer.WriteArray(posting_list_headers.data(), posting_list_headers.size());
+        
+        // arrays of all posting lists are concatenated, so a list is read in place at its offsets
+        std::vector<PostingList::Block> blocks;
+        std::vector<uint32_t> posting_words;
+        std::vector<int32_t> tail_slots;
+        std::vector<uint32_t> tail_counts;
+        
+        blocks.reserve(header.block_count);
+        posting_words.reserve(header.word_count);
+        tail_slots.reserve(header.tail_posting_count);
+        tail_counts.reserve(header.tail_posting_count);
+        
+        for (const auto& [term_id, posting_list] : posting_lists) {
+            const PostingList::Data data = posting_list->GetData();
+            
+            blocks.insert(blocks.end(), data.blocks, data.blocks + data.block_count);
+            posting_words.insert(posting_words.end(), data.words, data.words + data.word_count);
+            tail_slots.insert(tail_slots.end(), data.tail_slots, data.tail_slots + data.tail_size);
+            tail_counts.insert(tail_counts.end(), data.tail_counts, data.tail_counts + data.tail_size);
+        }
+        
+        writer.WriteArray(blocks.data(), blocks.size());
+        writer.WriteArray(posting_words.data(), posting_words.size());
+        writer.WriteArray(tail_slots.data(), tail_slots.size());
+        writer.WriteArray(tail_counts.data(), tail_counts.size());
+    }
+    
+    // kept texts of the documents in order of slots
+    std::vector<int32_t> text_slots;
+    for (size_t slot = 0; slot < slot_to_text_.size(); ++slot) {
+        if (slot_to_text_[slot].owner != nullptr) {
+            text_slots.push_back(static_cast<int32_t>(slot));
+        }
+    }
+    
+    std::vector<uint64_t> text_offsets(text_slots.size() + 1, 0);
+    std::string texts;
+    for (size_t i = 0; i < text_slots.size(); ++i) {
+        texts += slot_to_text_[text_slots[i]].text;
+        text_offsets[i + 1] = texts.size();
+    }
+    
+    writer.Write<uint64_t>(text_slots.size());
+    writer.WriteArray(text_slots.data(), text_slots.size());
+    writer.WriteArray(text_offsets.data(), text_offsets.size());
+    writer.WriteArray(texts.data(), texts.size());
+    
+    writer.Finish();
+} // SaveSnapshot
+
+SearchServer SearchServer::LoadSnapshot(const std::string& path) {
+    using search_server_index::PostingList;
+    
+    const auto snapshot = std::make_shared<const search_server_index::MappedFile>(path);
+    search_server_index::SnapshotReader reader(snapshot->GetData(), snapshot->GetSize());
+    
+    SearchServer server;
+    server.snapshot_ = snapshot;
+    server.snapshot_bytes_ = snapshot->GetSize();
+    
+    const uint64_t stop_word_count = reader.Read<uint64_t>();
+    std::vector<std::string> stop_words;
+    for (uint64_t i = 0; i < stop_word_count; ++i) {
+        stop_words.emplace_back(reader.ReadString());
+    }
+    server.stop_words_ = search_server_index::StopWordSet(std::move(stop_words));
+    
+    // words stay in the mapped file
+    const uint64_t term_count = reader.Read<uint64_t>();
+    // checked before the count is used, term_count + 1 must not wrap
+    CheckSnapshot(term_count <= static_cast<uint64_t>(std::numeric_limits<int>::max()));
+    
+    const uint64_t* word_offsets = reader.ReadArray<uint64_t>(term_count + 1);
+    const char* words = reader.ReadArray<char>(word_offsets[term_count]);
+    const uint64_t* document_frequencies = reader.ReadArray<uint64_t>(term_count);
+    
+    server.term_id_to_word_.reserve(term_count);
+    server.word_to_term_id_.reserve(term_count);
+    
+    for (uint64_t term_id = 0; term_id < term_count; ++term_id) {
+        CheckSnapshot(word_offsets[term_id] <= word_offsets[term_id + 1] && word_offsets[term_id + 1] <= word_offsets[term_count]);
+        
+        // released term ids are written without words
+        if (document_frequencies[term_id] == 0) {
+            server.term_id_to_word_.emplace_back();
+            server.free_term_ids_.push_back(static_cast<int>(term_id));
+        } else {
+            server.term_id_to_word_.emplace_back(words + word_offsets[term_id], word_offsets[term_id + 1] - word_offsets[term_id]);
+            CheckSnapshot(server.word_to_term_id_.emplace(server.term_id_to_word_.back(), static_cast<int>(term_id)).second);
+        }
+        
+        server.term_id_to_document_frequency_.push_back(document_frequencies[term_id]);
+        server.term_id_to_inverse_document_frequency_.AddTerm();
+    }
+    
+    // words stay in the mapped file
+    server.term_id_to_word_owner_.resize(term_count);
+    
+    const uint64_t slot_count = reader.Read<uint64_t>();
+    CheckSnapshot(slot_count <= static_cast<uint64_t>(std::numeric_limits<int>::max()));
+    
+    const SnapshotDocument* documents = reader.ReadArray<SnapshotDocument>(slot_count);
+    const uint64_t* term_count_offsets = reader.ReadArray<uint64_t>(slot_count + 1);
+    const search_server_index::TermCount* term_counts = reader.ReadArray<search_server_index::TermCount>(term_count_offsets[slot_count]);
+    
+    server.slot_to_document_data_.reserve(slot_count);
+    
+    for (uint64_t slot = 0; slot < slot_count; ++slot) {
+        const SnapshotDocument& document = documents[slot];
+        CheckSnapshot(document.status >= 0 && document.status <= static_cast<int32_t>(DocumentStatus::REMOVED));
+        
+        server.slot_to_document_data_.push_back({document.document_id, document.rating, static_cast<DocumentStatus>(document.status), document.length});
+        
+        const uint64_t begin = term_count_offsets[slot];
+        const uint64_t end = term_count_offsets[slot + 1];
+        CheckSnapshot(begin <= end && end <= term_count_offsets[slot_count]);
+        
+        // terms are written in order of term ids
+        for (uint64_t i = begin; i < end; ++i) {
+            CheckSnapshot(term_counts[i].term_id >= 0 && static_cast<uint64_t>(term_counts[i].term_id) < term_count
+                          && document_frequencies[term_counts[i].term_id] != 0 && term_counts[i].count > 0);
+            CheckSnapshot(i == begin || term_counts[i - 1].term_id < term_counts[i].term_id);
+        }
+        
+        server.forward_index_.AddSlot(term_counts + begin, term_counts + end);
+    }
+    
+    const uint64_t removed_slot_count = reader.Read<uint64_t>();
+    const int32_t* removed_slots = reader.ReadArray<int32_t>(removed_slot_count);
+    
+    for (uint64_t i = 0; i < removed_slot_count; ++i) {
+        CheckSnapshot(removed_slots[i] >= 0 && static_cast<uint64_t>(removed_slots[i]) < slot_count);
+        server.removed_slots_.Insert(removed_slots[i]);
+    }
+    
+    for (uint64_t slot = 0; slot < slot_count; ++slot) {
+        if (!server.removed_slots_.Contains(static_cast<int>(slot))) {
+            CheckSnapshot(server.document_id_to_slot_.emplace(server.slot_to_document_data_[slot].document_id, static_cast<int>(slot)).second);
+        }
+    }
+    
+    server.max_mutable_segment_document_count_ = reader.Read<int32_t>();
+    CheckSnapshot(server.max_mutable_segment_document_count_ > 0);
+    
+    const int32_t query_mode = reader.Read<int32_t>();
+    CheckSnapshot(query_mode == static_cast<int32_t>(QueryMode::EXHAUSTIVE) || query_mode == static_cast<int32_t>(QueryMode::MAX_SCORE));
+    server.query_mode_ = static_cast<QueryMode>(query_mode);
+    
+    // posting lists borrow the arrays of the mapped file
+    const uint64_t segment_count = reader.Read<uint64_t>();
+    int end_slot = 0;
+    
+    for (uint64_t i = 0; i < segment_count; ++i) {
+        const SnapshotSegment header = reader.Read<SnapshotSegment>();
+        CheckSnapshot(header.begin_slot == end_slot && header.slot_count > 0 && static_cast<uint64_t>(header.slot_count) <= slot_count - end_slot
+                      && header.purged_slot_count >= 0 && header.purged_slot_count <= header.slot_count);
+        
+        const int32_t* term_ids = reader.ReadArray<int32_t>(header.term_count);
+        const double* inverse_lengths = reader.ReadArray<double>(header.slot_count);
+        const SnapshotPostingList* posting_list_headers = reader.ReadArray<SnapshotPostingList>(header.term_count);
+        const PostingList::Block* blocks = reader.ReadArray<PostingList::Block>(header.block_count);
+        const uint32_t* posting_words = reader.ReadArray<uint32_t>(header.word_count);
+        const int32_t* tail_slots = reader.ReadArray<int32_t>(header.tail_posting_count);
+        const uint32_t* tail_counts = reader.ReadArray<uint32_t>(header.tail_posting_count);
+        
+        std::vector<PostingList> posting_lists;
+        posting_lists.reserve(header.term_count);
+        
+        for (uint64_t term = 0; term < header.term_count; ++term) {
+            const SnapshotPostingList& posting_list_header = posting_list_headers[term];
+            
+            CheckSnapshot(term_ids[term] >= 0 && static_cast<uint64_t>(term_ids[term]) < term_count && (term == 0 || term_ids[term - 1] < term_ids[term]));
+            CheckSnapshot(posting_list_header.block_count <= header.block_count && posting_list_header.block_offset <= header.block_count - posting_list_header.block_count);
+            CheckSnapshot(posting_list_header.word_count <= header.word_count && posting_list_header.word_offset <= header.word_count - posting_list_header.word_count);
+            CheckSnapshot(posting_list_header.tail_size < PostingList::kBlockSize && posting_list_header.tail_size <= header.tail_posting_count
+                          && posting_list_header.tail_offset <= header.tail_posting_count - posting_list_header.tail_size);
+            CheckSnapshot(posting_list_header.posting_count == posting_list_header.block_count * PostingList::kBlockSize + posting_list_header.tail_size);
+            
+            // blocks must be inside the words of the list, the postings are checked once the list is built
+            for (uint64_t block = posting_list_header.block_offset; block < posting_list_header.block_offset + posting_list_header.block_count; ++block) {
+                const PostingList::Block& block_header = blocks[block];
+                
+                CheckSnapshot(block_header.slot_bits <= 32 && block_header.count_bits <= 32
+                              && block_header.offset + search_server_index::GetPackedBlockWordCount(block_header.slot_bits)
+                                 + search_server_index::GetPackedBlockWordCount(block_header.count_bits) <= posting_list_header.word_count);
+            }
+            
+            PostingList::Data data;
+            data.words = posting_words + posting_list_header.word_offset;
+            data.word_count = posting_list_header.word_count;
+            data.blocks = blocks + posting_list_header.block_offset;
+            data.block_count = posting_list_header.block_count;
+            data.tail_slots = tail_slots + posting_list_header.tail_offset;
+            data.tail_counts = tail_counts + posting_list_header.tail_offset;
+            data.tail_size = posting_list_header.tail_size;
+            data.tail_max_term_frequency = posting_list_header.tail_max_term_frequency;
+            data.posting_count = posting_list_header.posting_count;
+            data.max_term_frequency = posting_list_header.max_term_frequency;
+            
+            posting_lists.push_back(PostingList::Borrow(data));
+            
+            // every decoded slot is used as an index of the arrays of the segment and of the scores
+            CheckSnapshot(posting_lists.back().HasValidPostings(header.begin_slot, header.begin_slot + header.slot_count));
+        }
+        
+        server.sealed_segments_.push_back(std::make_shared<const search_server_index::Segment>(search_server_index::Segment::MakeSealed(
+            header.begin_slot, std::vector<int>(term_ids, term_ids + header.term_count), std::move(posting_lists),
+            std::vector<double>(inverse_lengths, inverse_lengths + header.slot_count), header.purged_slot_count, snapshot)));
+        
+        end_slot += header.slot_count;
+    }
+    
+    CheckSnapshot(static_cast<uint64_t>(end_slot) == slot_count);
+    
+    server.mutable_segment_ = std::make_shared<search_server_index::Segment>(end_slot);
+    
+    // texts stay in the mapped file
+    const uint64_t text_count = reader.Read<uint64_t>();
+    CheckSnapshot(text_count <= slot_count);
+    
+    const int32_t* text_slots = reader.ReadArray<int32_t>(text_count);
+    const uint64_t* text_offsets = reader.ReadArray<uint64_t>(text_count + 1);
+    const char* texts = reader.ReadArray<char>(text_offsets[text_count]);
+    
+    for (uint64_t i = 0; i < text_count; ++i) {
+        CheckSnapshot(text_slots[i] >= 0 && static_cast<uint64_t>(text_slots[i]) < slot_count && !server.removed_slots_.Contains(text_slots[i])
+                      && (i == 0 || text_slots[i - 1] < text_slots[i]));
+        CheckSnapshot(text_offsets[i] <= text_offsets[i + 1] && text_offsets[i + 1] <= text_offsets[text_count]);
+        
+        server.slot_to_text_.resize(text_slots[i] + 1);
+        server.slot_to_text_[text_slots[i]] = {{texts + text_offsets[i], text_offsets[i + 1] - text_offsets[i]}, snapshot};
+    }
+    
+    // removed documents of the last written segment could be unpurged
+    server.MaintainSegments();
+    
+    return server;
+} // LoadSnapshot
+
+void SearchServer::SealMutableSegment() {
+    if (mutable_segment_->GetSlotCount() == 0) {
+        return;
+    }
+    
+    mutable_segment_->Seal(removed_slots_);
+    
+    const int end_slot = mutable_segment_->GetEndSlot();
+    
+    sealed_segments_.push_back(std::move(mutable_segment_));
+    mutable_segment_ = std::make_shared<search_server_index::Segment>(end_slot);
+} // SealMutableSegment
+
+void SearchServer::MaintainSegments() {
+    // slots of removed documents are given back once they are the most of the slots, so the work is amortized
+    // over the removals
+    if (removed_slots_.GetCount() >= static_cast<size_t>(max_mutable_segment_document_count_)
+        && removed_slots_.GetCount() * 2 >= slot_to_document_data_.size()) {
+        CompactSegments();
+    }
+    
+    // entries of removed documents are dropped from the forward index by the rule segments are compacted by,
+    // so every removed entry is copied a bounded number of times
+    const size_t removed_entry_count = forward_index_.GetRemovedEntryCount();
+    if (removed_entry_count > 0
+        && removed_entry_count >= search_server_index::SegmentMergeScheduler::kMinRemovedSlotShareToCompact * forward_index_.GetEntryCount()) {
+        forward_index_.Compact(removed_slots_);
+    }
+    
+    if (mutable_segment_->GetSlotCount() >= max_mutable_segment_document_count_) {
+        SealMutableSegment();
+    }
+    
+    segment_merge_scheduler_.Install(sealed_segments_, false);
+    segment_merge_scheduler_.Schedule(sealed_segments_, max_mutable_segment_document_count_, removed_slots_);
+} // MaintainSegments
 
 std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query,
-                                                     const DocumentStatus& desired_status) const {
+                                                     const DocumentStatus& desired_status, int max_result_document_count) const {
     const auto predicate = [desired_status](int , DocumentStatus document_status, int ) {
         return document_status == desired_status;
     };
     
-    return FindTopDocuments(std::execution::seq, raw_query, predicate);
+    return FindTopDocuments(std::execution::seq, raw_query, predicate, max_result_document_count);
 } // FindTopDocuments with status as a second argument
 
-std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(const std::string_view raw_query, int document_id) const {
-   return MatchDocument(std::execution::seq, raw_query, document_id);
-}
-
-std::vector<std::string_view> SearchServer::SplitIntoWordsNoStop(const std::string_view text) const {
-    std::vector<std::string_view> words;
-    for (const std::string_view word : string_processing::SplitIntoWords(text)) {
-        if (!IsStopWord(word)) {
-            words.push_back(word);
+SearchServer::CollectionStatistics SearchServer::GetCollectionStatistics(const std::string_view raw_query) const {
+    const Query query = ParseQuery(std::execution::seq, raw_query);
+    
+    CheckQueryStatus(query.status);
+    
+    CollectionStatistics statistics;
+    statistics.document_count = GetDocumentCount();
+    
+    for (const std::string_view word : query.plus_words) {
+        const int term_id = FindTermId(word);
+        
+        if (term_id >= 0) {
+            statistics.word_to_document_frequency.emplace(word, term_id_to_document_frequency_[term_id]);
         }
     }
     
-    return words;
-} // SplitIntoWordsNoStop
+    return statistics;
+} // GetCollectionStatistics
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(const std::string_view raw_query, int document_id) const {
+   return MatchDocument(std::execution::seq, raw_query, document_id);
+}
 
 int SearchServer::ComputeAverageRating(const std::vector<int>& ratings) {
     int rating_sum = 0;
@@ -143,56 +808,185 @@ int SearchServer::ComputeAverageRating(const std::vector<int>& ratings) {
 } // ComputeAverageRating
 
 bool SearchServer::IsStopWord(const std::string_view word) const {
-    return stop_words_.count(word) > 0;
+    return stop_words_.Contains(word);
 } // IsStopWord
 
-SearchServer::QueryWord SearchServer::ParseQueryWord(std::string_view text) const {
-    try {
-        if (text.empty()) {
-            throw std::invalid_argument("caught empty word, check for double spaces"s);
-        }
-    } catch(...) {
-        exception_pointer_in_parse_query_word = std::current_exception();
-    }    
-
+void SearchServer::CheckQueryStatus(QueryStatus status) {
+    switch (status) {
+    case QueryStatus::OK:
+        return;
+    case QueryStatus::EMPTY_MINUS_WORD:
+        throw std::invalid_argument("empty minus words are not allowed"s);
+    case QueryStatus::DOUBLE_MINUS_WORD:
+        throw std::invalid_argument("double minus words are not allowed"s);
+    case QueryStatus::SPECIAL_SYMBOL:
+        throw std::invalid_argument("special symbols in words are not allowed"s);
+    }
+} // CheckQueryStatus
 
+SearchServer::QueryWord SearchServer::ParseQueryWord(std::string_view text) const {
+    // words of the range are never empty
     bool is_minus = false;
     
-    try {
-        if (text[0] == '-') {
-            text = text.substr(1);
-            
-            if (text.empty()) {
-                throw std::invalid_argument("empty minus words are not allowed"s);
-            }
-            
-            if (text[0] == '-') {
-                throw std::invalid_argument("double minus words are not allowed"s);
-            }
-            
-            is_minus = true;
+    if (text[0] == '-') {
+        text = text.substr(1);
+        
+        if (text.empty()) {
+            return {text, true, false, QueryStatus::EMPTY_MINUS_WORD};
         }
         
-        if (!IsValidWord(text)) {
-            throw std::invalid_argument("special symbols in words are not allowed"s);
+        if (text[0] == '-') {
+            return {text, true, false, QueryStatus::DOUBLE_MINUS_WORD};
         }
-    } catch(...) {
-        exception_pointer_in_parse_query_word = std::current_exception();
+        
+        is_minus = true;
+    }
+    
+    if (!IsValidWord(text)) {
+        return {text, is_minus, false, QueryStatus::SPECIAL_SYMBOL};
     }
     
     return {text, is_minus, IsStopWord(text)};
 } // ParseQueryWord
 
-// Existence required
-double SearchServer::ComputeWordInverseDocumentFrequency(const std::string_view word) const {
-    assert(word_to_document_id_to_term_frequency_.count(word) != 0);
-    
-    const size_t number_of_documents_constains_word = word_to_document_id_to_term_frequency_.at(word).size();
+int SearchServer::FindTermId(const std::string_view word) const {
+    const auto iterator_to_term = word_to_term_id_.find(word);
+
+    // new terms get documents after they are added to the dictionary
+    if (iterator_to_term == word_to_term_id_.end() || term_id_to_document_frequency_[iterator_to_term->second] == 0) {
+        return -1;
+    }
+
+    return iterator_to_term->second;
+} // FindTermId
+
+std::unordered_map<std::string_view, int>::iterator SearchServer::AddTerm(const std::string_view word,
+                                                                          const std::shared_ptr<const void>& word_owner) {
+    auto iterator_to_term = word_to_term_id_.find(word);
+
+    if (iterator_to_term != word_to_term_id_.end()) {
+        return iterator_to_term;
+    }
+
+    // use string views that store data in words_storage_ or in the buffer of the owner as keys
+    const std::string_view word_in_storage = word_owner == nullptr ? words_storage_.Insert(word) : word;
+
+    if (free_term_ids_.empty()) {
+        iterator_to_term = word_to_term_id_.emplace(word_in_storage, static_cast<int>(term_id_to_document_frequency_.size())).first;
+        term_id_to_word_.push_back(word_in_storage);
+        term_id_to_word_owner_.push_back(word_owner);
+        term_id_to_document_frequency_.push_back(0);
+        term_id_to_inverse_document_frequency_.AddTerm();
+    } else {
+        iterator_to_term = word_to_term_id_.emplace(word_in_storage, free_term_ids_.back()).first;
+        term_id_to_word_[free_term_ids_.back()] = word_in_storage;
+        term_id_to_word_owner_[free_term_ids_.back()] = word_owner;
+        free_term_ids_.pop_back();
+    }
+
+    return iterator_to_term;
+} // AddTerm
+
+void SearchServer::ReleaseTerm(std::unordered_map<std::string_view, int>::iterator iterator_to_term) {
+    const int term_id = iterator_to_term->second;
+    const std::string_view word = iterator_to_term->first;
+
+    free_term_ids_.push_back(term_id);
+    term_id_to_word_[term_id] = {};
+    word_to_term_id_.erase(iterator_to_term);
+
+    // words of a loaded snapshot stay in the mapped file, words of kept texts stay in the buffer of their owner
+    if (term_id_to_word_owner_[term_id] == nullptr) {
+        words_storage_.Erase(word);
+    } else {
+        term_id_to_word_owner_[term_id] = nullptr;
+    }
+} // ReleaseTerm
+
+// Term with documents required
+double SearchServer::GetTermInverseDocumentFrequency(int term_id) const {
+    const size_t number_of_documents_constains_word = term_id_to_document_frequency_[term_id];
     
     assert(number_of_documents_constains_word != 0);
     
-    return std::log(static_cast<double>(GetDocumentCount()) / number_of_documents_constains_word);
-} // ComputeWordInverseDocumentFrequency
+    return term_id_to_inverse_document_frequency_.Get(term_id, number_of_documents_constains_word, GetDocumentCount());
+} // GetTermInverseDocumentFrequency
+
+std::vector<const search_server_index::Segment*> SearchServer::GetSegments() const {
+    std::vector<const search_server_index::Segment*> segments;
+    segments.reserve(sealed_segments_.size() + 1);
+    
+    for (const auto& segment : sealed_segments_) {
+        segments.push_back(segment.get());
+    }
+    
+    segments.push_back(mutable_segment_.get());
+    
+    return segments;
+} // GetSegments
+
+size_t SearchServer::FindSegmentIndex(int slot) const {
+    if (slot >= mutable_segment_->GetBeginSlot()) {
+        return sealed_segments_.size();
+    }
+    
+    return std::upper_bound(sealed_segments_.begin(), sealed_segments_.end(), slot, [](int slot, const auto& segment) {
+        return slot < segment->GetEndSlot();
+    }) - sealed_segments_.begin();
+} // FindSegmentIndex
+
+std::vector<SearchServer::QueryTerms> SearchServer::FindQueryTerms(const std::vector<const search_server_index::Segment*>& segments,
+                                                                   const Query& query, const CollectionStatistics* statistics) const {
+    std::vector<std::pair<int, double>> plus_term_ids_and_frequencies;
+    std::vector<int> minus_term_ids;
+
+    // inverse document frequencies are global, so relevance does not depend on the segment of the document
+    for (const std::string_view word : query.plus_words) {
+        const int term_id = FindTermId(word);
+
+        if (term_id < 0) {
+            continue;
+        }
+
+        if (statistics == nullptr) {
+            plus_term_ids_and_frequencies.emplace_back(term_id, GetTermInverseDocumentFrequency(term_id));
+            continue;
+        }
+
+        const auto iterator_to_frequency = statistics->word_to_document_frequency.find(word);
+
+        if (iterator_to_frequency != statistics->word_to_document_frequency.end() && iterator_to_frequency->second > 0) {
+            plus_term_ids_and_frequencies.emplace_back(term_id, search_server_index::ComputeInverseDocumentFrequency(
+                statistics->document_count, iterator_to_frequency->second));
+        }
+    }
+
+    for (const std::string_view word : query.minus_words) {
+        const int term_id = FindTermId(word);
+
+        if (term_id >= 0) {
+            minus_term_ids.push_back(term_id);
+        }
+    }
+
+    std::vector<QueryTerms> segment_to_query_terms(segments.size());
+
+    for (size_t i = 0; i < segments.size(); ++i) {
+        for (const auto& [term_id, inverse_document_frequency] : plus_term_ids_and_frequencies) {
+            if (const auto* posting_list = segments[i]->FindPostingList(term_id)) {
+                segment_to_query_terms[i].plus_terms.push_back({posting_list, inverse_document_frequency});
+            }
+        }
+
+        for (const int term_id : minus_term_ids) {
+            if (const auto* posting_list = segments[i]->FindPostingList(term_id)) {
+                segment_to_query_terms[i].minus_posting_lists.push_back(posting_list);
+            }
+        }
+    }
+
+    return segment_to_query_terms;
+} // FindQueryTerms
 
 namespace search_server_helpers {
 
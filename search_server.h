@@ -9,20 +9,251 @@
 #include <algorithm>
 #include <execution>
 #include <list>
+#include <memory>
 #include <functional>
+#include <limits>
 #include <mutex>
+#include <numeric>
+#include <thread>
+#include <unordered_map>
 
-#include "concurrent_map.h"
 #include "document.h"
+#include "forward_index.h"
+#include "inverse_document_frequency_cache.h"
+#include "posting_list.h"
+#include "score_accumulator.h"
+#include "segment.h"
+#include "segment_merge_scheduler.h"
+#include "stop_word_set.h"
+#include "top_documents.h"
 #include "string_processing.h"
 #include "word_storage.h"
-#include "copy_if_unordered.h"
 
 using namespace std::literals;
 
-static std::exception_ptr exception_pointer_in_parse_query_word = nullptr;
-
 class SearchServer {
+public:
+    // default size of the top of FindTopDocuments, wrappers of the server use it too
+    static constexpr int kMaxResultDocumentCount = 5;
+    
+    // EXHAUSTIVE scores every posting of the query terms term by term
+    // MAX_SCORE walks documents in slot order and skips postings that cannot get into the top (MaxScore with block max bounds)
+    // both modes return the same documents
+    enum class QueryMode {
+        EXHAUSTIVE,
+        MAX_SCORE,
+    };
+
+    // number of documents and document frequencies of the words of a query in a collection split between several servers
+    // servers given the statistics of the whole collection rank documents as one server with all the documents would
+    struct CollectionStatistics {
+        int document_count = 0;
+        
+        // words without documents may be missing
+        std::map<std::string, size_t, std::less<>> word_to_document_frequency;
+        
+        CollectionStatistics& operator+=(const CollectionStatistics& other) {
+            document_count += other.document_count;
+            
+            for (const auto& [word, document_frequency] : other.word_to_document_frequency) {
+                word_to_document_frequency[word] += document_frequency;
+            }
+            
+            return *this;
+        }
+    };
+    
+    struct NewDocument {
+        int document_id = 0;
+        std::string_view text;
+        DocumentStatus status = DocumentStatus::ACTUAL;
+        std::vector<int> ratings;
+    };
+    
+    // ids of the documents in order of their slots, that is in order of addition, removed slots are skipped
+    // valid until the server is changed
+    class DocumentIdIterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = int;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const int*;
+        using reference = const int&;
+        
+        DocumentIdIterator(const SearchServer* server, int slot)
+            : server_(server), slot_(slot) {
+            SkipRemovedSlots();
+        }
+        
+        reference operator*() const {
+            return server_->slot_to_document_data_[slot_].document_id;
+        }
+        
+        DocumentIdIterator& operator++() {
+            ++slot_;
+            SkipRemovedSlots();
+            return *this;
+        }
+        
+        bool operator==(const DocumentIdIterator& other) const {
+            return slot_ == other.slot_;
+        }
+        
+        bool operator!=(const DocumentIdIterator& other) const {
+            return slot_ != other.slot_;
+        }
+        
+    private:
+        void SkipRemovedSlots() {
+            const int end_slot = static_cast<int>(server_->slot_to_document_data_.size());
+            
+            while (slot_ < end_slot && server_->removed_slots_.Contains(slot_)) {
+                ++slot_;
+            }
+        }
+        
+    private:
+        const SearchServer* server_;
+        int slot_;
+    };
+    
+    // words of a document and their frequencies in order of term ids, a view of the forward index of the server
+    // valid until the server is changed
+    class WordFrequencies {
+    public:
+        class Iterator {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = std::pair<std::string_view, double>;
+            using difference_type = std::ptrdiff_t;
+            using pointer = void;
+            using reference = value_type;
+            
+            Iterator(const search_server_index::TermCount* entry, const WordFrequencies* word_frequencies)
+                : entry_(entry), word_frequencies_(word_frequencies) {
+            }
+            
+            value_type operator*() const {
+                return {(*word_frequencies_->term_id_to_word_)[entry_->term_id], entry_->count * word_frequencies_->inverse_length_};
+            }
+            
+            Iterator& operator++() {
+                ++entry_;
+                return *this;
+            }
+            
+            bool operator==(const Iterator& other) const {
+                return entry_ == other.entry_;
+            }
+            
+            bool operator!=(const Iterator& other) const {
+                return entry_ != other.entry_;
+            }
+            
+        private:
+            const search_server_index::TermCount* entry_;
+            const WordFrequencies* word_frequencies_;
+        };
+        
+        Iterator begin() const {
+            return {begin_, this};
+        }
+        
+        Iterator end() const {
+            return {end_, this};
+        }
+        
+        size_t size() const {
+            return static_cast<size_t>(end_ - begin_);
+        }
+        
+        bool empty() const {
+            return begin_ == end_;
+        }
+        
+        size_t count(const std::string_view word) const {
+            return Find(word) != nullptr ? 1 : 0;
+        }
+        
+        // throws std::out_of_range if the document does not have the word
+        double at(const std::string_view word) const {
+            using namespace std::literals;
+            
+            const search_server_index::TermCount* entry = Find(word);
+            
+            if (entry == nullptr) {
+                throw std::out_of_range("document does not have the word"s);
+            }
+            
+            return entry->count * inverse_length_;
+        }
+        
+    private:
+        friend class SearchServer;
+        
+        const search_server_index::TermCount* Find(const std::string_view word) const {
+            const auto iterator_to_term = word_to_term_id_->find(word);
+            
+            if (iterator_to_term == word_to_term_id_->end()) {
+                return nullptr;
+            }
+            
+            const auto entry = std::lower_bound(begin_, end_, iterator_to_term->second, [](const auto& entry, int term_id) {
+                return entry.term_id < term_id;
+            });
+            
+            return entry != end_ && entry->term_id == iterator_to_term->second ? entry : nullptr;
+        }
+        
+    private:
+        const search_server_index::TermCount* begin_ = nullptr;
+        const search_server_index::TermCount* end_ = nullptr;
+        double inverse_length_ = 0.0;
+        const std::vector<std::string_view>* term_id_to_word_ = nullptr;
+        const std::unordered_map<std::string_view, int>* word_to_term_id_ = nullptr;
+    };
+    
+    // heap memory of the parts of the server, see search_server_index::MemoryUsage
+    struct MemoryStats {
+        search_server_index::MemoryUsage stop_words;
+        
+        // copies of the words of the documents and the set of their views
+        search_server_index::MemoryUsage word_storage_words;
+        search_server_index::MemoryUsage word_storage_views;
+        
+        // word to term id table and back, document frequencies and cached inverse document frequencies of the terms
+        search_server_index::MemoryUsage term_dictionary;
+        
+        // postings, inverse lengths of the documents and term tables of the segments
+        search_server_index::MemoryUsage inverted_index;
+        
+        // id to slot table, ratings, statuses and lengths of the documents, set of the ids
+        search_server_index::MemoryUsage document_data;
+        
+        // forward index of the terms of the documents
+        search_server_index::MemoryUsage word_frequencies;
+        
+        // texts kept with the documents, texts of a loaded snapshot are counted in mapped_snapshot_bytes
+        search_server_index::MemoryUsage document_texts;
+        
+        search_server_index::MemoryUsage removed_documents;
+        
+        // the heap is the only allocator of the server, mapped snapshot pages are counted apart from it,
+        // they are shared with other processes and can be evicted by the kernel
+        size_t mapped_snapshot_bytes = 0;
+        
+        search_server_index::MemoryUsage GetHeapUsage() const {
+            search_server_index::MemoryUsage usage;
+            
+            for (const auto& part : {stop_words, word_storage_words, word_storage_views, term_dictionary,
+                                     inverted_index, document_data, word_frequencies, document_texts, removed_documents}) {
+                usage += part;
+            }
+            
+            return usage;
+        }
+    };
+
 public:
     SearchServer() = default;
     
@@ -33,36 +264,126 @@ public:
 
     explicit SearchServer(const std::string& stop_words);
     
+    // words of the dictionary are views of the word storage or of the mapped snapshot and a merge may be running
+    // in the background, so a server is moved but never copied
+    SearchServer(const SearchServer&) = delete;
+    SearchServer& operator=(const SearchServer&) = delete;
+    
+    SearchServer(SearchServer&&) = default;
+    SearchServer& operator=(SearchServer&&) = default;
+    
 public:
     void SetStopWords(const std::string_view text);
     
     bool AddDocument(int document_id, const std::string_view document,
                      DocumentStatus status, const std::vector<int>& ratings);
     
+    // adds the document from a buffer the server takes, the text is kept for GetDocumentText, such as for snippets
+    // new words of the text are not copied into the storage of words, the dictionary refers to them in the buffer
+    // and keeps the buffer while they are in the dictionary, so a document costs no allocation per word
+    bool AddDocumentKeepingText(int document_id, std::string document,
+                                DocumentStatus status, const std::vector<int>& ratings);
+    
+    // the text stays in the buffer of the owner, such as a mapped file or a buffer shared by several servers,
+    // the server keeps the owner while the document or any of its new words is in the server
+    bool AddDocumentKeepingText(int document_id, const std::string_view document, std::shared_ptr<const void> text_owner,
+                                DocumentStatus status, const std::vector<int>& ratings);
+    
+    // AddDocuments that keeps the texts, they and their new words stay in the buffer of the owner, such as a mapped file of a batch
+    template<typename ExecutionPolicy>
+    void AddDocumentsKeepingTexts(const ExecutionPolicy& policy, const std::vector<NewDocument>& documents, std::shared_ptr<const void> texts_owner);
+    
+    // text of a document added by AddDocumentKeepingText or AddDocumentsKeepingTexts, empty for other documents
+    // the view is valid while the document is in the server
+    std::string_view GetDocumentText(int document_id) const;
+    
+    // the index is the same as after AddDocument for every document in order
+    // documents are tokenized and indexed in parallel by parts, the parts are merged into one sealed segment
+    // nothing is added if any of the documents can not be added
+    void AddDocuments(const std::vector<NewDocument>& documents);
+    
+    template<typename ExecutionPolicy>
+    void AddDocuments(const ExecutionPolicy& policy, const std::vector<NewDocument>& documents);
+    
+    // throws std::invalid_argument if a document with the id can not be added, the text is checked separately
+    void CheckDocumentId(int document_id) const;
+    
+    // throws std::invalid_argument if AddDocuments would reject the documents, for callers that must know it
+    // before they add them, such as a log written ahead of the change
+    void CheckNewDocuments(const std::vector<NewDocument>& documents) const;
+    
     int GetDocumentCount() const;
     
+    // must not be called concurrently with queries
+    void SetQueryMode(QueryMode query_mode);
+    
+    QueryMode GetQueryMode() const;
+    
+    // new documents go to the mutable segment, it is sealed when it gets this number of documents
+    // sealed segments of the same size are merged in the background
+    void SetMaxMutableSegmentDocumentCount(int document_count);
+    
+    // number of segments of the index, the mutable one included
+    int GetSegmentCount() const;
+    
+    // segments being merged in the background are counted only once they are installed
+    MemoryStats GetMemoryStats() const;
+    
+    // waits for the background merges and puts their results in place of the merged segments
+    void WaitForMerges();
+    
+    // purges postings of the removed documents from all segments now instead of waiting for the background compaction
+    // and gives back their slots: the documents left get consecutive slots and the data kept by slot is shrunk
+    // called by the server itself once the removed documents take half of the slots
+    void CompactSegments();
+    
+    // writes the documents, the term dictionary, the segments of the index and the stop words to a binary file,
+    // the file is replaced only when the snapshot is complete
+    // throws std::runtime_error if the file can not be written
+    void SaveSnapshot(const std::string& path) const;
+    
+    // server with the contents of the snapshot, posting lists are read in place from the mapped file,
+    // so the index is not rebuilt and processes loading the same file share its pages
+    // throws std::runtime_error if the file can not be read or is not a valid snapshot
+    static SearchServer LoadSnapshot(const std::string& path);
+    
+    // at most max_result_document_count most relevant documents are returned
     template<typename Predicate>
-    std::vector<Document> FindTopDocuments(const std::string_view raw_query, Predicate predicate) const;
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, Predicate predicate,
+                                           int max_result_document_count = kMaxResultDocumentCount) const;
     
     std::vector<Document> FindTopDocuments(const std::string_view raw_query,
-                                           const DocumentStatus& desired_status = DocumentStatus::ACTUAL) const;
+                                           const DocumentStatus& desired_status = DocumentStatus::ACTUAL,
+                                           int max_result_document_count = kMaxResultDocumentCount) const;
 
     template<typename Execution, typename Predicate>
-    std::vector<Document> FindTopDocuments(Execution policy, const std::string_view raw_query, Predicate predicate) const;
+    std::vector<Document> FindTopDocuments(Execution policy, const std::string_view raw_query, Predicate predicate,
+                                           int max_result_document_count = kMaxResultDocumentCount) const;
 
     template<typename Execution>
-    std::vector<Document> FindTopDocuments(Execution policy, const std::string_view raw_query, const DocumentStatus& desired_status) const;
+    std::vector<Document> FindTopDocuments(Execution policy, const std::string_view raw_query, const DocumentStatus& desired_status,
+                                           int max_result_document_count = kMaxResultDocumentCount) const;
+    
+    // inverse document frequencies are computed from the statistics instead of the documents of the server
+    template<typename Execution, typename Predicate>
+    std::vector<Document> FindTopDocuments(Execution policy, const std::string_view raw_query, Predicate predicate,
+                                           int max_result_document_count, const CollectionStatistics& statistics) const;
     
+    // statistics of the plus words of the query in this server
+    CollectionStatistics GetCollectionStatistics(const std::string_view raw_query) const;
+    
+    // matched words are views of the stored words, they stay valid while the document is in the server
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::string_view raw_query, const int document_id) const;
 
     template<typename ExecutionPolicy>
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const ExecutionPolicy& policy, const std::string_view raw_query, const int document_id) const;
     
-    std::set<int>::const_iterator begin() const;
+    DocumentIdIterator begin() const;
     
-    std::set<int>::const_iterator end() const;
+    DocumentIdIterator end() const;
     
-    const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
+    // empty if there is no such document
+    WordFrequencies GetWordFrequencies(int document_id) const;
     
     void RemoveDocument(const int document_id);
 
@@ -71,15 +392,31 @@ public:
 
 private:
     struct DocumentData {
+        int document_id = 0;
         int rating = 0;
         DocumentStatus status = DocumentStatus::ACTUAL;
-        std::map<std::string_view, double> word_frequencies;
+        // number of words without stop words
+        int length = 0;
+    };
+    
+    // errors of parsing are returned with the parsed query, so queries parsed at the same time do not share them
+    // and a malformed query costs no exception until it reaches the caller
+    enum class QueryStatus {
+        OK,
+        EMPTY_MINUS_WORD,
+        DOUBLE_MINUS_WORD,
+        SPECIAL_SYMBOL,
     };
     
     struct Query {
         std::set<std::string_view> plus_words;
         std::set<std::string_view> minus_words;
+        QueryStatus status = QueryStatus::OK;
+        // offset of the malformed word in the text of the query, set with the status
+        size_t error_position = 0;
 
+        // of two errors the one of the word met first in the text is kept, as sequential parsing does,
+        // so the error does not depend on the order of combining
         Query& operator+=(Query other) {
             for (const auto& other_plus_word : other.plus_words) {
                 plus_words.insert(other_plus_word);
@@ -89,6 +426,11 @@ private:
                 minus_words.insert(other_minus_word);
             }
 
+            if (other.status != QueryStatus::OK && (status == QueryStatus::OK || other.error_position < error_position)) {
+                status = other.status;
+                error_position = other.error_position;
+            }
+
             return *this;
         }
     };
@@ -97,17 +439,34 @@ private:
         std::string_view data;
         bool is_minus = false;
         bool is_stop = false;
+        QueryStatus status = QueryStatus::OK;
+    };
+    
+    struct QueryTerm {
+        const search_server_index::PostingList* posting_list = nullptr;
+        double inverse_document_frequency = 0.0;
+    };
+    
+    // posting lists of the query words are looked up once per query, words without documents are skipped
+    struct QueryTerms {
+        std::vector<QueryTerm> plus_terms;
+        std::vector<const search_server_index::PostingList*> minus_posting_lists;
     };
     
 private:
-    static constexpr int kMaxResultDocumentCount = 5;
-    static constexpr double kAccuracy = 1e-6;
+    static constexpr int kMaxMutableSegmentDocumentCount = 4096;
     
 private:
-    std::vector<std::string_view> SplitIntoWordsNoStop(const std::string_view text) const;
+    // calls function(std::string_view word) for every word of the text that is not a stop word, nothing is allocated
+    // returns false without calling function for the rest of the words as soon as a word has special symbols
+    template<typename Function>
+    bool ForEachWordNoStop(const std::string_view text, Function function) const;
     
     static int ComputeAverageRating(const std::vector<int>& ratings);
     
+    // seals the mutable segment even if it is not full, new documents go to the segments after it
+    void SealMutableSegment();
+    
     bool IsStopWord(const std::string_view word) const;
     
     QueryWord ParseQueryWord(std::string_view text) const;
@@ -115,248 +474,722 @@ private:
     template<typename ExecutionPolicy>
     Query ParseQuery(const ExecutionPolicy& p, const std::string_view text) const;
     
-    // Existence required
-    double ComputeWordInverseDocumentFrequency(const std::string_view word) const;
+    // returns -1 if there are no documents containing the word
+    int FindTermId(const std::string_view word) const;
     
-    template<typename Execution>
-    std::vector<Document> FindAllDocuments(Execution policy, const Query& query) const;
+    // returns the dictionary entry of the word, a new word gets a released term id if there is one
+    // a new word is copied into words_storage_ unless it is in the buffer of the owner, which is kept then
+    std::unordered_map<std::string_view, int>::iterator AddTerm(const std::string_view word,
+                                                                const std::shared_ptr<const void>& word_owner = nullptr);
+    
+    // texts of the documents are in the buffer of the owner if it is not null
+    bool IndexDocument(int document_id, const std::string_view document, const std::shared_ptr<const void>& text_owner,
+                       DocumentStatus status, const std::vector<int>& ratings);
+    
+    template<typename ExecutionPolicy>
+    void IndexDocuments(const ExecutionPolicy& policy, const std::vector<NewDocument>& documents,
+                        const std::shared_ptr<const void>& texts_owner);
+    
+    // the word of a term without documents is erased and its term id is given to the next new word,
+    // postings of removed documents left in the segments are skipped as they are for any term
+    void ReleaseTerm(std::unordered_map<std::string_view, int>::iterator iterator_to_term);
+
+    // Term with documents required
+    double GetTermInverseDocumentFrequency(int term_id) const;
+    
+    // sealed segments in order of slots, then the mutable one
+    std::vector<const search_server_index::Segment*> GetSegments() const;
+    
+    // index of the segment that keeps postings of the slot, the mutable segment goes after the sealed ones
+    size_t FindSegmentIndex(int slot) const;
+    
+    // seals the full mutable segment, installs finished merges and starts new ones
+    void MaintainSegments();
+    
+    // indexed as segments
+    std::vector<QueryTerms> FindQueryTerms(const std::vector<const search_server_index::Segment*>& segments, const Query& query,
+                                           const CollectionStatistics* statistics) const;
+    
+    // throws std::invalid_argument if the query has an error
+    static void CheckQueryStatus(QueryStatus status);
+    
+    // statistics replace inverse document frequencies of the server if given
+    template<typename Execution, typename Predicate>
+    std::vector<Document> FindAllDocuments(Execution policy, const Query& query, Predicate predicate,
+                                           int max_result_document_count, const CollectionStatistics* statistics) const;
+
+    // finds top documents with slots in [begin_slot, end_slot) according to query_mode_
+    // the slots must belong to the segment
+    template<typename Predicate>
+    void FindDocumentsInSlotRange(const search_server_index::Segment& segment, const QueryTerms& query_terms,
+                                  int begin_slot, int end_slot, Predicate predicate,
+                                  search_server_index::TopDocuments& top_documents) const;
+
+    // term at a time, relevances are accumulated in the accumulator of the calling thread
+    template<typename Predicate>
+    void ScoreDocumentsByTerms(const search_server_index::Segment& segment, const QueryTerms& query_terms,
+                               int begin_slot, int end_slot, Predicate predicate,
+                               search_server_index::TopDocuments& top_documents) const;
+
+    // document at a time with MaxScore pruning
+    template<typename Predicate>
+    void ScoreDocumentsWithPruning(const search_server_index::Segment& segment, const QueryTerms& query_terms,
+                                   int begin_slot, int end_slot, Predicate predicate,
+                                   search_server_index::TopDocuments& top_documents) const;
 
     bool IsValidWord(const std::string_view word) const;
     
 private:
-    std::set<std::string, std::less<>> stop_words_;
+    search_server_index::StopWordSet stop_words_;
 
     search_server_storage_container::WordStorage words_storage_;
     
-    std::map<std::string_view, std::map<int, double>> word_to_document_id_to_term_frequency_;
+    // term dictionary, keys are views of words in words_storage_ or in the mapped snapshot
+    // only terms with documents are kept, so the dictionary does not grow with document churn
+    std::unordered_map<std::string_view, int> word_to_term_id_;
+    
+    // views of the keys of the dictionary, released term ids have empty words
+    std::vector<std::string_view> term_id_to_word_;
+    
+    // owners of the words that are in kept texts instead of words_storage_, null for the other words
+    std::vector<std::shared_ptr<const void>> term_id_to_word_owner_;
+    
+    // number of documents containing the term, indexed by term id
+    std::vector<size_t> term_id_to_document_frequency_;
     
-    std::map<int, DocumentData> document_id_to_document_data_;
+    // term ids without words
+    std::vector<int> free_term_ids_;
     
-    std::set<int> document_ids_;
+    // indexed by term id, invalidated by every change of the documents
+    search_server_index::InverseDocumentFrequencyCache term_id_to_inverse_document_frequency_;
+    
+    // every document gets a dense slot in order of addition, slots of removed documents are given back
+    // by CompactSegments, which renumbers the documents left
+    std::unordered_map<int, int> document_id_to_slot_;
+    
+    std::vector<DocumentData> slot_to_document_data_;
+    
+    // terms of the documents by slot
+    search_server_index::ForwardIndex forward_index_;
+    
+    struct DocumentText {
+        std::string_view text;
+        std::shared_ptr<const void> owner;
+    };
+    
+    // kept texts of the documents by slot, documents without a kept text have no owner
+    // empty until a text is kept, then it grows to the last slot with a text
+    std::vector<DocumentText> slot_to_text_;
+    
+    // inverted index split by slot ranges, postings refer to document slots
+    // sealed segments are shared with the running merge
+    std::vector<std::shared_ptr<const search_server_index::Segment>> sealed_segments_;
+    
+    std::shared_ptr<search_server_index::Segment> mutable_segment_ = std::make_shared<search_server_index::Segment>(0);
+    
+    search_server_index::SegmentMergeScheduler segment_merge_scheduler_;
+    
+    // removed documents stay in the segments until compaction, queries skip them
+    search_server_index::SlotBitmap removed_slots_;
+    
+    int max_mutable_segment_document_count_ = kMaxMutableSegmentDocumentCount;
+    
+    // mapped snapshot the server is loaded from, words of the dictionary are views of it
+    std::shared_ptr<const void> snapshot_;
+    size_t snapshot_bytes_ = 0;
+    
+    QueryMode query_mode_ = QueryMode::EXHAUSTIVE;
 };
 
+template<typename Function>
+bool SearchServer::ForEachWordNoStop(const std::string_view text, Function function) const {
+    const string_processing::WordRange words(text);
+    
+    for (auto iterator = words.begin(); iterator != words.end(); ++iterator) {
+        if (iterator.HasControlChars()) {
+            return false;
+        }
+        
+        if (!IsStopWord(*iterator)) {
+            function(*iterator);
+        }
+    }
+    
+    return true;
+} // ForEachWordNoStop
+
 template<typename ExecutionPolicy>
 SearchServer::Query SearchServer::ParseQuery(const ExecutionPolicy& policy, const std::string_view text) const {
-    auto words = string_processing::SplitIntoWords(text);
-
-    // UnaryOp
-    const auto transform_word_in_query = [this](const std::string_view word){
-        auto query_word = this->ParseQueryWord(word); 
-
+    // sequential parsing streams the words into one query, no vector of words is built
+    if constexpr (std::is_same_v<ExecutionPolicy, std::execution::sequenced_policy>) {
         Query query;
-        if (!query_word.is_stop) {
-            if (query_word.is_minus) {
-                query.minus_words.insert(query_word.data);
-            } else {
-                query.plus_words.insert(query_word.data);
+        
+        for (const std::string_view word : string_processing::WordRange(text)) {
+            const auto query_word = ParseQueryWord(word);
+            
+            // the rest of a malformed query is not parsed
+            if (query_word.status != QueryStatus::OK) {
+                query.status = query_word.status;
+                query.error_position = static_cast<size_t>(word.data() - text.data());
+                break;
+            }
+            
+            if (!query_word.is_stop) {
+                (query_word.is_minus ? query.minus_words : query.plus_words).insert(query_word.data);
             }
         }
-
+        
         return query;
-    };
+    } else {
+        auto words = string_processing::SplitIntoWords(text);
 
-    // BinaryOp
-    const auto combine_queries = [](Query first, Query second){
-        return first += second;
-    };
+        // UnaryOp
+        const auto transform_word_in_query = [this, text](const std::string_view word){
+            auto query_word = this->ParseQueryWord(word); 
+
+            Query query;
+            query.status = query_word.status;
+            query.error_position = static_cast<size_t>(word.data() - text.data());
+            
+            if (query_word.status == QueryStatus::OK && !query_word.is_stop) {
+                if (query_word.is_minus) {
+                    query.minus_words.insert(query_word.data);
+                } else {
+                    query.plus_words.insert(query_word.data);
+                }
+            }
+
+            return query;
+        };
 
-    return std::transform_reduce(policy, std::make_move_iterator(words.begin()), std::make_move_iterator(words.end()), Query{}, combine_queries, transform_word_in_query);
+        // BinaryOp
+        const auto combine_queries = [](Query first, Query second){
+            return first += second;
+        };
+
+        return std::transform_reduce(policy, std::make_move_iterator(words.begin()), std::make_move_iterator(words.end()), Query{}, combine_queries, transform_word_in_query);
+    }
 } // ParseQuery
 
 template<typename ExecutionPolicy>
 std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(const ExecutionPolicy& policy, const std::string_view raw_query, int document_id) const {
     const Query query = ParseQuery(policy, raw_query);
 
-    // error handling
-    if (exception_pointer_in_parse_query_word) {
-        auto temp_exception_holder = exception_pointer_in_parse_query_word;
-        exception_pointer_in_parse_query_word = nullptr;
-        std::rethrow_exception(temp_exception_holder);
-    }
+    CheckQueryStatus(query.status);
+    
+    const int slot = document_id_to_slot_.at(document_id);
+    
+    const auto contains_word = [&](const std::string_view word) {
+        const auto iterator_to_term = word_to_term_id_.find(word);
+
+        return iterator_to_term != word_to_term_id_.end() && forward_index_.Find(slot, iterator_to_term->second) != nullptr;
+    };
     
     std::vector<std::string_view> matched_words;
     for (const std::string_view word : query.plus_words) {
-        if (word_to_document_id_to_term_frequency_.count(word) == 0) {
-            continue;
-        }
-        
-        if (word_to_document_id_to_term_frequency_.at(word).count(document_id)) {
-            matched_words.push_back(word);
+        if (contains_word(word)) {
+            // view of the stored word outlives the query text
+            matched_words.push_back(word_to_term_id_.find(word)->first);
         }
     }
     
     for (const std::string_view word : query.minus_words) {
-        if (word_to_document_id_to_term_frequency_.count(word) == 0) {
-            continue;
-        }
-        
-        if (word_to_document_id_to_term_frequency_.at(word).count(document_id)) {
+        if (contains_word(word)) {
             matched_words.clear();
             break;
         }
     }
     
-    return std::tuple<std::vector<std::string_view>, DocumentStatus>{matched_words, document_id_to_document_data_.at(document_id).status};
+    return std::tuple<std::vector<std::string_view>, DocumentStatus>{matched_words, slot_to_document_data_[slot].status};
 } // MatchDocument
 
+// postings are not touched, so the policy does not matter
 template<typename ExecutionPolicy>
-void SearchServer::RemoveDocument(const ExecutionPolicy& policy, const int document_id) {
-    if (document_id_to_document_data_.count(document_id) == 0) {
+void SearchServer::RemoveDocument(const ExecutionPolicy&, const int document_id) {
+    const auto iterator_to_slot = document_id_to_slot_.find(document_id);
+
+    if (iterator_to_slot == document_id_to_slot_.end()) {
         return;
     }
 
-    // get list of words that are in this doc
-    const auto words_and_frequencies = GetWordFrequencies(document_id);
+    const int slot = iterator_to_slot->second;
 
-    // initialize linear container that will contain inner maps of word_to_document_id_to_term_frequency where id points to frequency
-    std::vector<std::map<int, double>> id_to_frequency;
-    id_to_frequency.reserve(words_and_frequencies.size());
+    // inverse document frequencies count only the documents that are not removed
+    for (auto entry = forward_index_.begin(slot); entry != forward_index_.end(slot); ++entry) {
+        if (--term_id_to_document_frequency_[entry->term_id] == 0) {
+            ReleaseTerm(word_to_term_id_.find(term_id_to_word_[entry->term_id]));
+        }
+    }
 
-    // populate this inner container
-    for (const auto& [word, term_frequency] : words_and_frequencies) {
-        id_to_frequency.push_back(std::move(word_to_document_id_to_term_frequency_.at(word)));
+    forward_index_.RemoveSlot(slot);
+    
+    if (static_cast<size_t>(slot) < slot_to_text_.size()) {
+        slot_to_text_[slot] = {};
     }
 
-    // change inner maps
-    std::for_each(policy, id_to_frequency.begin(), id_to_frequency.end(), [document_id](std::map<int, double>& element){
-        element.erase(document_id);
-    });
+    removed_slots_.Insert(slot);
+
+    term_id_to_inverse_document_frequency_.Invalidate();
+
+    document_id_to_slot_.erase(iterator_to_slot);
+    
+    MaintainSegments();
+}
+
+template<typename ExecutionPolicy>
+void SearchServer::AddDocuments(const ExecutionPolicy& policy, const std::vector<NewDocument>& documents) {
+    IndexDocuments(policy, documents, nullptr);
+} // AddDocuments
 
-    // and put them back
-    auto iterator_for_id_to_frequency_maps = id_to_frequency.begin();
-    for (const auto& [word, term_frequency] : words_and_frequencies) {
-        word_to_document_id_to_term_frequency_.at(word) = std::move(*(iterator_for_id_to_frequency_maps++));
+template<typename ExecutionPolicy>
+void SearchServer::IndexDocuments(const ExecutionPolicy& policy, const std::vector<NewDocument>& documents,
+                                  const std::shared_ptr<const void>& texts_owner) {
+    using namespace std::literals;
+    
+    std::set<int> new_document_ids;
+    for (const NewDocument& document : documents) {
+        CheckDocumentId(document.document_id);
+        
+        if (!new_document_ids.insert(document.document_id).second) {
+            throw std::invalid_argument("repeating ids are not allowed"s);
+        }
+    }
+    
+    if (documents.empty()) {
+        return;
+    }
+    
+    // documents are split into consecutive parts, every part is indexed by one task
+    // a part numbers its words in order of the first occurrence, so global term ids are given in the same order
+    // as by sequential insertion
+    struct Part {
+        size_t begin = 0;
+        size_t end = 0;
+        
+        std::unordered_map<std::string_view, int> word_to_local_id;
+        std::vector<std::string_view> local_id_to_word;
+        
+        // indexed by document of the part, local term ids in order of the words of the document
+        std::vector<std::vector<int>> document_to_local_term_ids;
         
-        if (word_to_document_id_to_term_frequency_.at(word).empty()) {
-            word_to_document_id_to_term_frequency_.erase(word);
+        std::vector<int> local_id_to_term_id;
+        
+        std::unique_ptr<search_server_index::Segment> segment;
+        search_server_index::ForwardIndex forward_index;
+        
+        bool has_invalid_text = false;
+    };
+    
+    const size_t part_count = std::is_same_v<ExecutionPolicy, std::execution::sequenced_policy>
+        ? 1 : std::min(documents.size(), static_cast<size_t>(std::max(1u, std::thread::hardware_concurrency())) * 4);
+    
+    std::vector<Part> parts(part_count);
+    for (size_t i = 0; i < part_count; ++i) {
+        parts[i].begin = documents.size() * i / part_count;
+        parts[i].end = documents.size() * (i + 1) / part_count;
+    }
+    
+    // texts are validated while they are split, the dictionary is not changed before all of them are
+    std::for_each(policy, parts.begin(), parts.end(), [this, &documents](Part& part) {
+        for (size_t i = part.begin; i < part.end && !part.has_invalid_text; ++i) {
+            std::vector<int> local_term_ids;
+            
+            part.has_invalid_text = !ForEachWordNoStop(documents[i].text, [&part, &local_term_ids](const std::string_view word) {
+                const auto [iterator_to_word, is_new] = part.word_to_local_id.emplace(word, static_cast<int>(part.local_id_to_word.size()));
+                
+                if (is_new) {
+                    part.local_id_to_word.push_back(word);
+                }
+                
+                local_term_ids.push_back(iterator_to_word->second);
+            });
+            
+            part.document_to_local_term_ids.push_back(std::move(local_term_ids));
+        }
+    });
+    
+    if (std::any_of(parts.begin(), parts.end(), [](const Part& part) { return part.has_invalid_text; })) {
+        throw std::invalid_argument("word in document contains unaccaptable symbol"s);
+    }
+    
+    // the dictionary is shared, so only the distinct words of the parts are looked up here, one part after another
+    for (Part& part : parts) {
+        part.local_id_to_term_id.reserve(part.local_id_to_word.size());
+        
+        for (const std::string_view word : part.local_id_to_word) {
+            part.local_id_to_term_id.push_back(AddTerm(word, texts_owner)->second);
+        }
+    }
+    
+    SealMutableSegment();
+    
+    const int begin_slot = mutable_segment_->GetBeginSlot();
+    
+    slot_to_document_data_.resize(begin_slot + documents.size());
+    
+    std::for_each(policy, parts.begin(), parts.end(), [this, &documents, begin_slot](Part& part) {
+        part.segment = std::make_unique<search_server_index::Segment>(begin_slot + static_cast<int>(part.begin));
+        
+        std::vector<std::pair<int, uint32_t>> term_counts;
+        
+        for (size_t i = part.begin; i < part.end; ++i) {
+            const int slot = begin_slot + static_cast<int>(i);
+            
+            std::vector<int> local_term_ids = std::move(part.document_to_local_term_ids[i - part.begin]);
+            
+            const double inverse_word_count = local_term_ids.empty() ? 0.0 : 1.0 / static_cast<double>(local_term_ids.size());
+            
+            std::sort(local_term_ids.begin(), local_term_ids.end());
+            
+            term_counts.clear();
+            for (auto begin = local_term_ids.begin(); begin != local_term_ids.end();) {
+                const auto end = std::upper_bound(begin, local_term_ids.end(), *begin);
+                
+                term_counts.emplace_back(part.local_id_to_term_id[*begin], static_cast<uint32_t>(end - begin));
+                begin = end;
+            }
+            
+            // the segment expects term ids in order
+            std::sort(term_counts.begin(), term_counts.end());
+            
+            part.segment->AddDocument(slot, term_counts, inverse_word_count);
+            part.forward_index.AddSlot(term_counts);
+            
+            slot_to_document_data_[slot] = {documents[i].document_id, ComputeAverageRating(documents[i].ratings), documents[i].status,
+                                            static_cast<int>(local_term_ids.size())};
         }
+        
+        part.segment->Seal(removed_slots_);
+    });
+    
+    std::vector<const search_server_index::Segment*> part_segments;
+    for (const Part& part : parts) {
+        part_segments.push_back(part.segment.get());
+    }
+    
+    auto segment = part_segments.size() == 1
+        ? std::make_shared<search_server_index::Segment>(std::move(*parts.front().segment))
+        : std::make_shared<search_server_index::Segment>(search_server_index::Segment::Merge(policy, part_segments, removed_slots_));
+    
+    segment->ForEachPostingList([this](int term_id, const search_server_index::PostingList& posting_list) {
+        term_id_to_document_frequency_[term_id] += posting_list.size();
+    });
+    
+    // parts are in order of slots
+    for (const Part& part : parts) {
+        forward_index_.Append(part.forward_index);
     }
+    
+    for (size_t i = 0; i < documents.size(); ++i) {
+        document_id_to_slot_.emplace(documents[i].document_id, begin_slot + static_cast<int>(i));
+    }
+    
+    const int end_slot = segment->GetEndSlot();
+    
+    sealed_segments_.push_back(std::move(segment));
+    mutable_segment_ = std::make_shared<search_server_index::Segment>(end_slot);
+    
+    term_id_to_inverse_document_frequency_.Invalidate();
+    
+    MaintainSegments();
+} // IndexDocuments
 
-    // not parallel
-    document_id_to_document_data_.erase(document_id);
+template<typename ExecutionPolicy>
+void SearchServer::AddDocumentsKeepingTexts(const ExecutionPolicy& policy, const std::vector<NewDocument>& documents, std::shared_ptr<const void> texts_owner) {
+    IndexDocuments(policy, documents, texts_owner);
     
-    document_ids_.erase(document_id);
-}
+    if (documents.empty()) {
+        return;
+    }
+    
+    // the batch gets consecutive slots
+    const int begin_slot = document_id_to_slot_.at(documents.front().document_id);
+    slot_to_text_.resize(begin_slot + documents.size());
+    
+    for (size_t i = 0; i < documents.size(); ++i) {
+        slot_to_text_[begin_slot + i] = {documents[i].text, texts_owner};
+    }
+} // AddDocumentsKeepingTexts
 
 template <typename StringCollection>
 SearchServer::SearchServer(const StringCollection& stop_words) {
     using namespace std::literals;
     
+    std::vector<std::string> words;
+    
     for (const auto& stop_word : stop_words) {
         if (!IsValidWord(stop_word)) {
             throw std::invalid_argument("stop word contains unaccaptable symbol"s);
         }
         
-        stop_words_.emplace(stop_word);
+        words.emplace_back(stop_word);
     }
+    
+    stop_words_ = search_server_index::StopWordSet(std::move(words));
 }
 
 template<typename Execution, typename Predicate>
-std::vector<Document> SearchServer::FindTopDocuments(Execution policy, const std::string_view raw_query, Predicate predicate) const {
+std::vector<Document> SearchServer::FindTopDocuments(Execution policy, const std::string_view raw_query, Predicate predicate,
+                                                     int max_result_document_count) const {
     const Query query = ParseQuery(policy, raw_query);
 
-    // handle exception that could have occured while ParsingQuery
-    if (exception_pointer_in_parse_query_word) {
-        auto temp_exception_holder = exception_pointer_in_parse_query_word;
-        exception_pointer_in_parse_query_word = nullptr;
-        std::rethrow_exception(temp_exception_holder);
-    }
+    CheckQueryStatus(query.status);
     
-    std::vector<Document> matched_documents = FindAllDocuments(policy, query);
-
-    std::vector<Document> filtered_documents;
-
-    if (std::is_same_v<Execution, std::execution::sequenced_policy>) {
-        for (const Document& document : matched_documents) {
-            const auto document_status = document_id_to_document_data_.at(document.id).status;
-            const auto document_rating = document_id_to_document_data_.at(document.id).rating;
-            
-            if (predicate(document.id, document_status, document_rating)) {
-                filtered_documents.push_back(document);
-            }
-        }
+    return FindAllDocuments(policy, query, predicate, max_result_document_count, nullptr);
+}
 
-    } else {
-        filtered_documents = parallel_copy::CopyIfUnordered(matched_documents, [&](Document document){
-            const auto document_status = document_id_to_document_data_.at(document.id).status;
-            const auto document_rating = document_id_to_document_data_.at(document.id).rating;
-            
-            if (predicate(document.id, document_status, document_rating)) {
-                return true;
-            }
-            
-            return false;
-        });
-    }
+template<typename Execution, typename Predicate>
+std::vector<Document> SearchServer::FindTopDocuments(Execution policy, const std::string_view raw_query, Predicate predicate,
+                                                     int max_result_document_count, const CollectionStatistics& statistics) const {
+    const Query query = ParseQuery(policy, raw_query);
 
-    std::sort(policy, filtered_documents.begin(), filtered_documents.end(),
-              [](const Document& left, const Document& right) {
-        if (std::abs(left.relevance - right.relevance) < kAccuracy) {
-            return left.rating > right.rating;
-        } else {
-            return left.relevance > right.relevance;
-        }
-    });
+    CheckQueryStatus(query.status);
     
-    if (static_cast<int>(filtered_documents.size()) > kMaxResultDocumentCount) {
-        filtered_documents.resize(static_cast<size_t>(kMaxResultDocumentCount));
-    }
-    
-    return filtered_documents;
+    return FindAllDocuments(policy, query, predicate, max_result_document_count, &statistics);
 }
 
 template<typename Predicate>
-std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, Predicate predicate) const {
-   return FindTopDocuments(std::execution::seq, raw_query, predicate); 
+std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, Predicate predicate,
+                                                     int max_result_document_count) const {
+   return FindTopDocuments(std::execution::seq, raw_query, predicate, max_result_document_count); 
 } // FindTopDocuments 
 
 template<typename Execution>
 std::vector<Document> SearchServer::FindTopDocuments(Execution policy, const std::string_view raw_query,
-                                                     const DocumentStatus& desired_status) const {
+                                                     const DocumentStatus& desired_status, int max_result_document_count) const {
     const auto predicate = [desired_status](int , DocumentStatus document_status, int ) {
         return document_status == desired_status;
     };
     
-    return FindTopDocuments(policy, raw_query, predicate);
+    return FindTopDocuments(policy, raw_query, predicate, max_result_document_count);
 } // FindTopDocuments with status as a second argument
 
-template<typename Execution>
-std::vector<Document> SearchServer::FindAllDocuments(Execution policy, const Query& query) const {
-    static constexpr int kNumberOfThreads = 4;
-    ConcurrentMap<int, double> document_id_to_relevance_concurrent(kNumberOfThreads);
+template<typename Execution, typename Predicate>
+std::vector<Document> SearchServer::FindAllDocuments(Execution policy, const Query& query, Predicate predicate,
+                                                     int max_result_document_count, const CollectionStatistics* statistics) const {
+    const int slot_count = static_cast<int>(slot_to_document_data_.size());
 
-    std::for_each(std::execution::par, query.plus_words.begin(), query.plus_words.end(),[&](std::string_view word) {
-        if (word_to_document_id_to_term_frequency_.count(word) == 0) {
-            return;
+    const std::vector<const search_server_index::Segment*> segments = GetSegments();
+
+    const std::vector<QueryTerms> segment_to_query_terms = FindQueryTerms(segments, query, statistics);
+
+    search_server_index::TopDocuments top_documents(max_result_document_count);
+
+    // results of the segments are merged in one top, so pruning of a segment uses the threshold reached in the previous ones
+    const auto find_documents_in_slot_range = [&](int begin_slot, int end_slot, search_server_index::TopDocuments& range_top_documents) {
+        for (size_t i = 0; i < segments.size(); ++i) {
+            const int segment_begin_slot = std::max(begin_slot, segments[i]->GetBeginSlot());
+            const int segment_end_slot = std::min(end_slot, segments[i]->GetEndSlot());
+
+            if (segment_begin_slot < segment_end_slot && !segment_to_query_terms[i].plus_terms.empty()) {
+                FindDocumentsInSlotRange(*segments[i], segment_to_query_terms[i], segment_begin_slot, segment_end_slot,
+                                         predicate, range_top_documents);
+            }
         }
+    };
+
+    if constexpr (std::is_same_v<Execution, std::execution::sequenced_policy>) {
+        find_documents_in_slot_range(0, slot_count, top_documents);
+    } else {
+        // every thread scores its own range of slots, so no synchronization is needed
+        const int range_count = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
 
-        const double inverse_document_frequency = ComputeWordInverseDocumentFrequency(word);
+        std::vector<int> range_indexes(range_count);
+        std::iota(range_indexes.begin(), range_indexes.end(), 0);
 
-        for (const auto &[document_id, term_frequency] : word_to_document_id_to_term_frequency_.at(word)) {
-            document_id_to_relevance_concurrent[document_id].ref_to_value += term_frequency * inverse_document_frequency;
-        } 
-    });
+        // every range keeps its own top, then the tops are merged
+        std::vector<search_server_index::TopDocuments> range_to_top_documents(range_count, top_documents);
+
+        std::for_each(policy, range_indexes.begin(), range_indexes.end(), [&](int range_index) {
+            const int begin_slot = static_cast<int>(static_cast<int64_t>(slot_count) * range_index / range_count);
+            const int end_slot = static_cast<int>(static_cast<int64_t>(slot_count) * (range_index + 1) / range_count);
 
-    std::map<int, double> document_id_to_relevance = document_id_to_relevance_concurrent.BuildOrdinaryMap();
+            find_documents_in_slot_range(begin_slot, end_slot, range_to_top_documents[range_index]);
+        });
+
+        for (const auto& range_top_documents : range_to_top_documents) {
+            top_documents.Merge(range_top_documents);
+        }
+    }
     
-    for (const std::string_view word : query.minus_words) {
-        if (word_to_document_id_to_term_frequency_.count(word) == 0) {
+    return top_documents.Extract();
+} // FindAllDocuments
+
+template<typename Predicate>
+void SearchServer::FindDocumentsInSlotRange(const search_server_index::Segment& segment, const QueryTerms& query_terms,
+                                            int begin_slot, int end_slot, Predicate predicate,
+                                            search_server_index::TopDocuments& top_documents) const {
+    if (query_mode_ == QueryMode::MAX_SCORE) {
+        ScoreDocumentsWithPruning(segment, query_terms, begin_slot, end_slot, predicate, top_documents);
+    } else {
+        ScoreDocumentsByTerms(segment, query_terms, begin_slot, end_slot, predicate, top_documents);
+    }
+} // FindDocumentsInSlotRange
+
+template<typename Predicate>
+void SearchServer::ScoreDocumentsByTerms(const search_server_index::Segment& segment, const QueryTerms& query_terms,
+                                         int begin_slot, int end_slot, Predicate predicate,
+                                         search_server_index::TopDocuments& top_documents) const {
+    auto& accumulator = search_server_index::GetThreadScoreAccumulator();
+    accumulator.Reset(slot_to_document_data_.size());
+
+    for (const auto* posting_list : query_terms.minus_posting_lists) {
+        posting_list->ForEachPosting(begin_slot, end_slot, [&accumulator](int slot, uint32_t) {
+            accumulator.Exclude(slot);
+        });
+    }
+
+    const double* inverse_lengths = segment.GetInverseLengths();
+    const int first_slot = segment.GetBeginSlot();
+
+    for (const QueryTerm& term : query_terms.plus_terms) {
+        const double inverse_document_frequency = term.inverse_document_frequency;
+
+        term.posting_list->ForEachPosting(begin_slot, end_slot, [&](int slot, uint32_t count) {
+            accumulator.Add(slot, count * inverse_lengths[slot - first_slot] * inverse_document_frequency);
+        });
+    }
+
+    // external ids are needed only for the documents that make it to the result
+    for (const int slot : accumulator.GetTouchedSlots()) {
+        if (accumulator.IsExcluded(slot) || removed_slots_.Contains(slot)) {
             continue;
         }
-        
-        for (const auto &[document_id, _] : word_to_document_id_to_term_frequency_.at(word)) {
-            document_id_to_relevance.erase(document_id);
+
+        const DocumentData& document_data = slot_to_document_data_[slot];
+
+        if (predicate(document_data.document_id, document_data.status, document_data.rating)) {
+            top_documents.Push({document_data.document_id, accumulator.GetRelevance(slot), document_data.rating});
         }
     }
-    
-    std::vector<Document> matched_documents;
-    for (const auto &[document_id, relevance] : document_id_to_relevance) {
-        matched_documents.push_back({ document_id, relevance,
-            document_id_to_document_data_.at(document_id).rating});
+} // ScoreDocumentsByTerms
+
+template<typename Predicate>
+void SearchServer::ScoreDocumentsWithPruning(const search_server_index::Segment& segment, const QueryTerms& query_terms,
+                                             int begin_slot, int end_slot, Predicate predicate,
+                                             search_server_index::TopDocuments& top_documents) const {
+    using search_server_index::PostingCursor;
+
+    const double* inverse_lengths = segment.GetInverseLengths();
+    const int first_slot = segment.GetBeginSlot();
+
+    std::vector<PostingCursor> minus_cursors;
+    for (const auto* posting_list : query_terms.minus_posting_lists) {
+        minus_cursors.emplace_back(*posting_list, begin_slot, end_slot, 0.0, inverse_lengths, first_slot);
     }
-    
-    return matched_documents;
-} // FindAllDocuments
+
+    std::vector<PostingCursor> cursors;
+    for (const auto& [posting_list, inverse_document_frequency] : query_terms.plus_terms) {
+        cursors.emplace_back(*posting_list, begin_slot, end_slot, inverse_document_frequency, inverse_lengths, first_slot);
+    }
+
+    // cursors with the lowest max scores go first, so the non essential ones are a prefix
+    std::sort(cursors.begin(), cursors.end(), [](const PostingCursor& left, const PostingCursor& right) {
+        return left.GetMaxScore() < right.GetMaxScore();
+    });
+
+    std::vector<double> max_score_prefix_sums(cursors.size());
+    std::vector<double> block_max_scores(cursors.size());
+
+    double max_score_sum = 0.0;
+    for (size_t i = 0; i < cursors.size(); ++i) {
+        max_score_sum += cursors[i].GetMaxScore();
+        max_score_prefix_sums[i] = max_score_sum;
+    }
+
+    // a document with relevance not greater than the threshold can not get into the top
+    double threshold = -std::numeric_limits<double>::infinity();
+
+    // every document that can get into the top contains at least one of the essential words
+    size_t first_essential = 0;
+
+    const auto update_threshold = [&]() {
+        if (!top_documents.IsFull()) {
+            return;
+        }
+
+        threshold = top_documents.GetLeastRelevant().relevance - search_server_index::kRelevanceAccuracy;
+
+        while (first_essential < cursors.size() && max_score_prefix_sums[first_essential] <= threshold) {
+            ++first_essential;
+        }
+    };
+
+    update_threshold();
+
+    while (true) {
+        int slot = std::numeric_limits<int>::max();
+        for (size_t i = first_essential; i < cursors.size(); ++i) {
+            if (!cursors[i].IsEnd()) {
+                slot = std::min(slot, cursors[i].GetSlot());
+            }
+        }
+
+        if (slot == std::numeric_limits<int>::max()) {
+            break;
+        }
+
+        double relevance = 0.0;
+        for (size_t i = first_essential; i < cursors.size(); ++i) {
+            if (!cursors[i].IsEnd() && cursors[i].GetSlot() == slot) {
+                relevance += cursors[i].GetScore();
+                cursors[i].Next();
+            }
+        }
+
+        const bool is_excluded = removed_slots_.Contains(slot) || std::any_of(minus_cursors.begin(), minus_cursors.end(), [slot](PostingCursor& cursor) {
+            cursor.NextGreaterOrEqual(slot);
+            return !cursor.IsEnd() && cursor.GetSlot() == slot;
+        });
+
+        if (is_excluded) {
+            continue;
+        }
+
+        const DocumentData& document_data = slot_to_document_data_[slot];
+
+        if (!predicate(document_data.document_id, document_data.status, document_data.rating)) {
+            continue;
+        }
+
+        // non essential words are added from the most valuable one while the document can still get into the top
+        if (first_essential > 0) {
+            if (relevance + max_score_prefix_sums[first_essential - 1] <= threshold) {
+                continue;
+            }
+
+            double block_max_score_sum = 0.0;
+            for (size_t i = 0; i < first_essential; ++i) {
+                block_max_scores[i] = cursors[i].GetBlockMaxScore(slot);
+                block_max_score_sum += block_max_scores[i];
+            }
+
+            bool is_pruned = false;
+            for (size_t i = first_essential; i-- > 0;) {
+                if (relevance + block_max_score_sum <= threshold) {
+                    is_pruned = true;
+                    break;
+                }
+
+                block_max_score_sum -= block_max_scores[i];
+
+                cursors[i].NextGreaterOrEqual(slot);
+
+                if (!cursors[i].IsEnd() && cursors[i].GetSlot() == slot) {
+                    relevance += cursors[i].GetScore();
+                }
+            }
+
+            if (is_pruned) {
+                continue;
+            }
+        }
+
+        top_documents.Push({document_data.document_id, relevance, document_data.rating});
+
+        update_threshold();
+    }
+} // ScoreDocumentsWithPruning
 
 namespace search_server_helpers {
 
@@ -0,0 +1,298 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <execution>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "memory_usage.h"
+#include "posting_list.h"
+#include "slot_bitmap.h"
+
+namespace search_server_index {
+
+// part of the inverted index with postings of the documents with slots in [begin slot, end slot)
+// documents are added to the mutable segment, sealed segment is never changed and keeps its terms sorted,
+// so it can be read by a background merge while the server goes on
+// removed documents are not taken out of the segment, their postings are purged when the segment is sealed or merged
+// inverse lengths of the documents are kept by the segment, so segments are merged without the server
+class Segment {
+public:
+    explicit Segment(int begin_slot): begin_slot_(begin_slot) {}
+
+    // sealed segment of a snapshot, term_ids must be sorted and posting_lists[i] must keep postings of term_ids[i]
+    // posting lists may borrow memory of the storage, the segment keeps it alive
+    static Segment MakeSealed(int begin_slot, std::vector<int> term_ids, std::vector<PostingList> posting_lists,
+                              std::vector<double> inverse_lengths, int purged_slot_count, std::shared_ptr<const void> storage) {
+        assert(term_ids.size() == posting_lists.size() && std::is_sorted(term_ids.begin(), term_ids.end()));
+
+        Segment segment(begin_slot);
+        segment.term_ids_ = std::move(term_ids);
+        segment.posting_lists_ = std::move(posting_lists);
+        segment.inverse_lengths_ = std::move(inverse_lengths);
+        segment.purged_slot_count_ = purged_slot_count;
+        segment.storage_ = std::move(storage);
+        segment.is_sealed_ = true;
+
+        return segment;
+    }
+
+    int GetBeginSlot() const {
+        return begin_slot_;
+    }
+
+    int GetEndSlot() const {
+        return begin_slot_ + static_cast<int>(inverse_lengths_.size());
+    }
+
+    // number of slots, slots of removed documents included
+    int GetSlotCount() const {
+        return static_cast<int>(inverse_lengths_.size());
+    }
+
+    bool IsSealed() const {
+        return is_sealed_;
+    }
+
+    // slot must be the end slot of the segment, term_counts are pairs of term id and count sorted by term id
+    void AddDocument(int slot, const std::vector<std::pair<int, uint32_t>>& term_counts, double inverse_length) {
+        assert(!is_sealed_ && slot == GetEndSlot());
+
+        for (const auto& [term_id, count] : term_counts) {
+            auto iterator_to_index = term_id_to_index_.find(term_id);
+
+            if (iterator_to_index == term_id_to_index_.end()) {
+                iterator_to_index = term_id_to_index_.emplace(term_id, static_cast<int>(term_ids_.size())).first;
+                term_ids_.push_back(term_id);
+                posting_lists_.emplace_back();
+            }
+
+            posting_lists_[iterator_to_index->second].Add(slot, count, count * inverse_length);
+        }
+
+        inverse_lengths_.push_back(inverse_length);
+    }
+
+    // number of removed slots with postings purged from the segment
+    int GetPurgedSlotCount() const {
+        return purged_slot_count_;
+    }
+
+    // sorts terms, purges postings of the removed slots and drops the term index of the mutable segment
+    void Seal(const SlotBitmap& removed_slots) {
+        std::vector<int> order(term_ids_.size());
+        for (size_t i = 0; i < order.size(); ++i) {
+            order[i] = static_cast<int>(i);
+        }
+
+        std::sort(order.begin(), order.end(), [this](int left, int right) {
+            return term_ids_[left] < term_ids_[right];
+        });
+
+        std::vector<int> term_ids;
+        std::vector<PostingList> posting_lists;
+        term_ids.reserve(order.size());
+        posting_lists.reserve(order.size());
+
+        const bool has_removed_slots = removed_slots.Count(begin_slot_, GetEndSlot()) > 0;
+
+        for (const int index : order) {
+            PostingList posting_list;
+
+            if (has_removed_slots) {
+                AppendPostings(posting_lists_[index], removed_slots, posting_list);
+            } else {
+                posting_list = std::move(posting_lists_[index]);
+            }
+
+            if (!posting_list.empty()) {
+                term_ids.push_back(term_ids_[index]);
+                posting_lists.push_back(std::move(posting_list));
+            }
+        }
+
+        term_ids_ = std::move(term_ids);
+        posting_lists_ = std::move(posting_lists);
+        term_id_to_index_ = {};
+        inverse_lengths_.shrink_to_fit();
+        purged_slot_count_ = static_cast<int>(removed_slots.Count(begin_slot_, GetEndSlot()));
+        is_sealed_ = true;
+    }
+
+    // returns nullptr if there are no documents of the segment containing the term
+    const PostingList* FindPostingList(int term_id) const {
+        const int index = FindTermIndex(term_id);
+
+        return index < 0 || posting_lists_[index].empty() ? nullptr : &posting_lists_[index];
+    }
+
+    // indexed by slot minus the begin slot
+    const double* GetInverseLengths() const {
+        return inverse_lengths_.data();
+    }
+
+    // heap memory of the segment, posting lists borrowed from the storage are not counted
+    // postings and inverse lengths are the payload, the terms and the headers of the posting lists are the overhead
+    MemoryUsage GetMemoryUsage() const {
+        MemoryUsage usage = GetVectorMemoryUsage(inverse_lengths_);
+
+        for (const MemoryUsage& overhead : {GetVectorMemoryUsage(term_ids_), GetVectorMemoryUsage(posting_lists_),
+                                            GetHashMapMemoryUsage(term_id_to_index_)}) {
+            usage.overhead_bytes += overhead.GetTotalBytes();
+        }
+
+        for (const PostingList& posting_list : posting_lists_) {
+            usage += posting_list.GetMemoryUsage();
+        }
+
+        return usage;
+    }
+
+    // calls function(term_id, posting_list) for the terms of the segment
+    template<typename Function>
+    void ForEachPostingList(Function function) const {
+        for (size_t i = 0; i < term_ids_.size(); ++i) {
+            if (!posting_lists_[i].empty()) {
+                function(term_ids_[i], posting_lists_[i]);
+            }
+        }
+    }
+
+    // segments must be sealed and cover consecutive slot ranges in order of slots
+    // postings of the removed slots are purged, so merge of a single segment compacts it
+    static Segment Merge(const std::vector<const Segment*>& segments, const SlotBitmap& removed_slots) {
+        return Merge(std::execution::seq, segments, removed_slots);
+    }
+
+    // posting lists of different terms are built in parallel
+    template<typename ExecutionPolicy>
+    static Segment Merge(const ExecutionPolicy& policy, const std::vector<const Segment*>& segments, const SlotBitmap& removed_slots) {
+        assert(!segments.empty());
+
+        Segment merged(segments.front()->GetBeginSlot());
+
+        std::vector<int> term_ids;
+        for (const Segment* segment : segments) {
+            assert(segment->IsSealed() && segment->GetBeginSlot() == merged.GetEndSlot());
+
+            term_ids.insert(term_ids.end(), segment->term_ids_.begin(), segment->term_ids_.end());
+            merged.inverse_lengths_.insert(merged.inverse_lengths_.end(), segment->inverse_lengths_.begin(), segment->inverse_lengths_.end());
+        }
+
+        std::sort(term_ids.begin(), term_ids.end());
+        term_ids.erase(std::unique(term_ids.begin(), term_ids.end()), term_ids.end());
+
+        std::vector<PostingList> posting_lists(term_ids.size());
+
+        std::vector<size_t> indexes(term_ids.size());
+        for (size_t i = 0; i < indexes.size(); ++i) {
+            indexes[i] = i;
+        }
+
+        // postings of a term are concatenated, slot ranges of the segments do not overlap
+        std::for_each(policy, indexes.begin(), indexes.end(), [&](size_t i) {
+            for (const Segment* segment : segments) {
+                if (const PostingList* segment_posting_list = segment->FindPostingList(term_ids[i])) {
+                    merged.AppendPostings(*segment_posting_list, removed_slots, posting_lists[i]);
+                }
+            }
+        });
+
+        for (size_t i = 0; i < term_ids.size(); ++i) {
+            if (!posting_lists[i].empty()) {
+                merged.term_ids_.push_back(term_ids[i]);
+                merged.posting_lists_.push_back(std::move(posting_lists[i]));
+            }
+        }
+
+        merged.purged_slot_count_ = static_cast<int>(removed_slots.Count(merged.begin_slot_, merged.GetEndSlot()));
+        merged.is_sealed_ = true;
+
+        return merged;
+    }
+
+    // segment must be sealed, postings of the removed slots are purged and the other slots get consecutive slots
+    // from begin_slot in the same order, so the slots of removed documents are given back
+    static Segment Renumber(const Segment& segment, const SlotBitmap& removed_slots, int begin_slot) {
+        assert(segment.IsSealed());
+
+        Segment renumbered(begin_slot);
+
+        // indexed by slot minus the begin slot of the segment, -1 for removed slots
+        std::vector<int> new_slots(segment.inverse_lengths_.size(), -1);
+
+        for (size_t i = 0; i < new_slots.size(); ++i) {
+            if (!removed_slots.Contains(segment.begin_slot_ + static_cast<int>(i))) {
+                new_slots[i] = renumbered.GetEndSlot();
+                renumbered.inverse_lengths_.push_back(segment.inverse_lengths_[i]);
+            }
+        }
+
+        for (size_t i = 0; i < segment.term_ids_.size(); ++i) {
+            PostingList posting_list;
+
+            segment.posting_lists_[i].ForEachPosting([&](int slot, uint32_t count) {
+                const int index = slot - segment.begin_slot_;
+
+                if (new_slots[index] >= 0) {
+                    posting_list.Add(new_slots[index], count, count * segment.inverse_lengths_[index]);
+                }
+            });
+
+            if (!posting_list.empty()) {
+                renumbered.term_ids_.push_back(segment.term_ids_[i]);
+                renumbered.posting_lists_.push_back(std::move(posting_list));
+            }
+        }
+
+        renumbered.is_sealed_ = true;
+
+        return renumbered;
+    }
+
+private:
+    // appends postings of the source with slots of the segment that are not removed
+    void AppendPostings(const PostingList& source, const SlotBitmap& removed_slots, PostingList& destination) const {
+        source.ForEachPosting([&](int slot, uint32_t count) {
+            if (!removed_slots.Contains(slot)) {
+                destination.Add(slot, count, count * inverse_lengths_[slot - begin_slot_]);
+            }
+        });
+    }
+
+    // returns -1 if the segment has no postings of the term
+    int FindTermIndex(int term_id) const {
+        if (!is_sealed_) {
+            const auto iterator_to_index = term_id_to_index_.find(term_id);
+
+            return iterator_to_index == term_id_to_index_.end() ? -1 : iterator_to_index->second;
+        }
+
+        const auto iterator_to_term = std::lower_bound(term_ids_.begin(), term_ids_.end(), term_id);
+
+        return iterator_to_term == term_ids_.end() || *iterator_to_term != term_id ? -1 : static_cast<int>(iterator_to_term - term_ids_.begin());
+    }
+
+private:
+    int begin_slot_;
+    bool is_sealed_ = false;
+    int purged_slot_count_ = 0;
+
+    // posting_lists_[i] keeps postings of term term_ids_[i], sealed segment keeps term ids sorted
+    std::vector<int> term_ids_;
+    std::vector<PostingList> posting_lists_;
+
+    // only the mutable segment needs it
+    std::unordered_map<int, int> term_id_to_index_;
+
+    std::vector<double> inverse_lengths_;
+
+    // memory borrowed by the posting lists, such as a mapped snapshot file
+    std::shared_ptr<const void> storage_;
+};
+
+} // namespace search_server_index
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <future>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "segment.h"
+
+namespace search_server_index {
+
+// size tiered merge policy: kMergeFactor adjacent sealed segments of the same tier are merged into one,
+// segment of tier t has about base_slot_count * kMergeFactor^t slots
+// a segment with at least kMinRemovedSlotShareToCompact of its slots removed and not purged is compacted,
+// that is merged alone
+// one merge runs at a time on a background thread, it reads only the sealed segments it merges
+// and a copy of the removed slots taken at its start, the result replaces them when the owner installs it
+class SegmentMergeScheduler {
+public:
+    static constexpr int kMergeFactor = 4;
+
+    static constexpr double kMinRemovedSlotShareToCompact = 0.25;
+
+public:
+    // starts a merge if no merge is running and there are segments to merge or compact
+    void Schedule(const std::vector<std::shared_ptr<const Segment>>& segments, int base_slot_count, const SlotBitmap& removed_slots) {
+        if (running_merge_) {
+            return;
+        }
+
+        for (size_t first = 0; first + kMergeFactor <= segments.size(); ++first) {
+            const int tier = GetTier(*segments[first], base_slot_count);
+
+            bool is_same_tier = true;
+            for (size_t i = first + 1; i < first + kMergeFactor; ++i) {
+                is_same_tier = is_same_tier && GetTier(*segments[i], base_slot_count) == tier;
+            }
+
+            if (is_same_tier) {
+                Start({segments.begin() + first, segments.begin() + first + kMergeFactor}, removed_slots);
+                return;
+            }
+        }
+
+        // counting removed slots walks the bitmap, so it is done only when there are new removals or new segments
+        if (removed_slots.GetCount() == checked_removed_slot_count_ && !has_unchecked_segments_) {
+            return;
+        }
+
+        checked_removed_slot_count_ = removed_slots.GetCount();
+        has_unchecked_segments_ = false;
+
+        for (const auto& segment : segments) {
+            const size_t unpurged_slot_count = removed_slots.Count(segment->GetBeginSlot(), segment->GetEndSlot()) - segment->GetPurgedSlotCount();
+
+            if (unpurged_slot_count > 0 && unpurged_slot_count >= kMinRemovedSlotShareToCompact * segment->GetSlotCount()) {
+                Start({segment}, removed_slots);
+                return;
+            }
+        }
+    }
+
+    // replaces the merged segments with the result of the finished merge, waits for the running merge if wait is set
+    // result is dropped if any of the merged segments has been replaced meanwhile
+    // returns true if the segments have changed
+    bool Install(std::vector<std::shared_ptr<const Segment>>& segments, bool wait) {
+        if (!running_merge_) {
+            return false;
+        }
+
+        if (!wait && running_merge_->result.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            return false;
+        }
+
+        RunningMerge merge = std::move(*running_merge_);
+        running_merge_.reset();
+
+        std::shared_ptr<const Segment> merged = merge.result.get();
+
+        // removals made during the merge are left in the result
+        has_unchecked_segments_ = true;
+
+        const auto iterator_to_first = std::find(segments.begin(), segments.end(), merge.inputs.front());
+
+        if (iterator_to_first == segments.end() || segments.end() - iterator_to_first < static_cast<std::ptrdiff_t>(merge.inputs.size())
+            || !std::equal(merge.inputs.begin(), merge.inputs.end(), iterator_to_first)) {
+            return false;
+        }
+
+        *iterator_to_first = std::move(merged);
+        segments.erase(iterator_to_first + 1, iterator_to_first + merge.inputs.size());
+
+        return true;
+    }
+
+    bool IsMerging() const {
+        return running_merge_.has_value();
+    }
+
+private:
+    struct RunningMerge {
+        std::vector<std::shared_ptr<const Segment>> inputs;
+        std::future<std::shared_ptr<const Segment>> result;
+    };
+
+private:
+    void Start(std::vector<std::shared_ptr<const Segment>> inputs, const SlotBitmap& removed_slots) {
+        RunningMerge merge;
+        merge.inputs = std::move(inputs);
+
+        // the task keeps its own references, so the inputs stay alive whatever happens to the owner's list
+        merge.result = std::async(std::launch::async, [inputs = merge.inputs, removed_slots]() {
+            std::vector<const Segment*> segments_to_merge;
+            for (const auto& input : inputs) {
+                segments_to_merge.push_back(input.get());
+            }
+
+            return std::shared_ptr<const Segment>(std::make_shared<Segment>(Segment::Merge(segments_to_merge, removed_slots)));
+        });
+
+        running_merge_ = std::move(merge);
+    }
+
+    static int GetTier(const Segment& segment, int base_slot_count) {
+        int tier = 0;
+
+        for (int slot_count = segment.GetSlotCount() / base_slot_count; slot_count >= kMergeFactor; slot_count /= kMergeFactor) {
+            ++tier;
+        }
+
+        return tier;
+    }
+
+private:
+    std::optional<RunningMerge> running_merge_;
+
+    size_t checked_removed_slot_count_ = 0;
+    bool has_unchecked_segments_ = false;
+};
+
+} // namespace search_server_index
@@ -0,0 +1,258 @@
+#include "shard_protocol.h"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <sys/socket.h>
+#include <sys/types.h>
+
+using namespace std::literals;
+
+namespace shard_protocol {
+
+void Writer::WriteUint8(uint8_t value) {
+    data_.push_back(static_cast<char>(value));
+}
+
+void Writer::WriteUint32(uint32_t value) {
+    for (int shift = 0; shift < 32; shift += 8) {
+        data_.push_back(static_cast<char>(value >> shift & 0xFF));
+    }
+}
+
+void Writer::WriteInt32(int32_t value) {
+    WriteUint32(static_cast<uint32_t>(value));
+}
+
+void Writer::WriteUint64(uint64_t value) {
+    for (int shift = 0; shift < 64; shift += 8) {
+        data_.push_back(static_cast<char>(value >> shift & 0xFF));
+    }
+}
+
+void Writer::WriteDouble(double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    WriteUint64(bits);
+}
+
+void Writer::WriteString(std::string_view value) {
+    WriteUint32(static_cast<uint32_t>(value.size()));
+    data_.append(value);
+}
+
+void Writer::WriteDocumentStatus(DocumentStatus status) {
+    WriteUint8(static_cast<uint8_t>(status));
+}
+
+void Writer::WriteDocument(const Document& document) {
+    WriteInt32(document.id);
+    WriteDouble(document.relevance);
+    WriteInt32(document.rating);
+}
+
+void Writer::WriteCollectionStatistics(const SearchServer::CollectionStatistics& statistics) {
+    WriteInt32(statistics.document_count);
+    WriteUint32(static_cast<uint32_t>(statistics.word_to_document_frequency.size()));
+
+    for (const auto& [word, document_frequency] : statistics.word_to_document_frequency) {
+        WriteString(word);
+        WriteUint64(document_frequency);
+    }
+}
+
+const std::string& Writer::GetData() const {
+    return data_;
+}
+
+Reader::Reader(std::string_view data): data_(data) {}
+
+uint8_t Reader::ReadUint8() {
+    return static_cast<uint8_t>(Take(1)[0]);
+}
+
+uint32_t Reader::ReadUint32() {
+    const std::string_view bytes = Take(4);
+
+    uint32_t value = 0;
+    for (int i = 0; i < 4; ++i) {
+        value |= static_cast<uint32_t>(static_cast<uint8_t>(bytes[i])) << (8 * i);
+    }
+
+    return value;
+}
+
+int32_t Reader::ReadInt32() {
+    return static_cast<int32_t>(ReadUint32());
+}
+
+uint64_t Reader::ReadUint64() {
+    const std::string_view bytes = Take(8);
+
+    uint64_t value = 0;
+    for (int i = 0; i < 8; ++i) {
+        value |= static_cast<uint64_t>(static_cast<uint8_t>(bytes[i])) << (8 * i);
+    }
+
+    return value;
+}
+
+double Reader::ReadDouble() {
+    const uint64_t bits = ReadUint64();
+
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+
+    return value;
+}
+
+std::string_view Reader::ReadString() {
+    return Take(ReadUint32());
+}
+
+DocumentStatus Reader::ReadDocumentStatus() {
+    const uint8_t status = ReadUint8();
+
+    if (status > static_cast<uint8_t>(DocumentStatus::REMOVED)) {
+        throw std::invalid_argument("unknown document status"s);
+    }
+
+    return static_cast<DocumentStatus>(status);
+}
+
+uint32_t Reader::ReadCount(size_t min_element_size) {
+    const uint32_t count = ReadUint32();
+
+    if (static_cast<uint64_t>(count) * min_element_size > data_.size()) {
+        throw std::runtime_error("message is truncated"s);
+    }
+
+    return count;
+}
+
+Document Reader::ReadDocument() {
+    const int id = ReadInt32();
+    const double relevance = ReadDouble();
+    const int rating = ReadInt32();
+
+    return {id, relevance, rating};
+}
+
+SearchServer::CollectionStatistics Reader::ReadCollectionStatistics() {
+    SearchServer::CollectionStatistics statistics;
+    statistics.document_count = ReadInt32();
+
+    // a word has at least its length and document frequency
+    const uint32_t word_count = ReadCount(12);
+    for (uint32_t i = 0; i < word_count; ++i) {
+        const std::string_view word = ReadString();
+        statistics.word_to_document_frequency.emplace(word, ReadUint64());
+    }
+
+    return statistics;
+}
+
+bool Reader::IsEnd() const {
+    return data_.empty();
+}
+
+std::string_view Reader::Take(size_t size) {
+    if (data_.size() < size) {
+        throw std::runtime_error("message is truncated"s);
+    }
+
+    const std::string_view bytes = data_.substr(0, size);
+    data_.remove_prefix(size);
+
+    return bytes;
+}
+
+namespace {
+
+void SendAll(int socket, const char* data, size_t size) {
+    while (size > 0) {
+        // the coordinator must not be killed by SIGPIPE when a shard goes down
+        const ssize_t sent = send(socket, data, size, MSG_NOSIGNAL);
+
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            throw std::runtime_error("failed to send to shard socket: "s + std::strerror(errno));
+        }
+
+        data += sent;
+        size -= static_cast<size_t>(sent);
+    }
+}
+
+// returns false if the peer has closed the connection before the first byte
+bool ReceiveAll(int socket, char* data, size_t size) {
+    const size_t total_size = size;
+
+    while (size > 0) {
+        const ssize_t received = recv(socket, data, size, 0);
+
+        if (received < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            throw std::runtime_error("failed to receive from shard socket: "s + std::strerror(errno));
+        }
+
+        if (received == 0) {
+            if (size == total_size) {
+                return false;
+            }
+
+            throw std::runtime_error("shard socket is closed in the middle of a message"s);
+        }
+
+        data += received;
+        size -= static_cast<size_t>(received);
+    }
+
+    return true;
+}
+
+} // namespace
+
+void SendFrame(int socket, std::string_view payload) {
+    if (payload.size() > kMaxFrameSize) {
+        throw std::invalid_argument("message is too large"s);
+    }
+
+    Writer header;
+    header.WriteUint32(static_cast<uint32_t>(payload.size()));
+
+    SendAll(socket, header.GetData().data(), header.GetData().size());
+    SendAll(socket, payload.data(), payload.size());
+}
+
+bool ReceiveFrame(int socket, std::string& payload) {
+    char header[4];
+
+    if (!ReceiveAll(socket, header, sizeof(header))) {
+        return false;
+    }
+
+    const uint32_t size = Reader(std::string_view(header, sizeof(header))).ReadUint32();
+
+    if (size > kMaxFrameSize) {
+        throw std::runtime_error("message is too large"s);
+    }
+
+    payload.resize(size);
+
+    if (size > 0 && !ReceiveAll(socket, payload.data(), size)) {
+        throw std::runtime_error("shard socket is closed in the middle of a message"s);
+    }
+
+    return true;
+}
+
+} // namespace shard_protocol
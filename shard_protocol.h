@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "document.h"
+#include "search_server.h"
+
+// binary protocol between the coordinator and shard servers over stream sockets
+// every message is a frame: 4 byte length and the payload
+// integers are little endian, doubles are sent as their 8 byte IEEE representation, strings are length prefixed
+// a request starts with its MessageType, a response starts with its ResponseStatus,
+// a response with an error status carries the error message only
+namespace shard_protocol {
+
+enum class MessageType : uint8_t {
+    ADD_DOCUMENT = 1,
+    ADD_DOCUMENTS = 2,
+    REMOVE_DOCUMENT = 3,
+    GET_DOCUMENT_COUNT = 4,
+    GET_COLLECTION_STATISTICS = 5,
+    FIND_TOP_DOCUMENTS = 6,
+    MATCH_DOCUMENT = 7,
+    // ids of a batch, the shard answers with an error if any of them is already added
+    CHECK_DOCUMENT_IDS = 8,
+};
+
+enum class ResponseStatus : uint8_t {
+    OK = 0,
+    INVALID_ARGUMENT = 1,
+    OUT_OF_RANGE = 2,
+    ERROR = 3,
+};
+
+static constexpr uint32_t kMaxFrameSize = 1u << 30;
+
+class Writer {
+public:
+    void WriteUint8(uint8_t value);
+
+    void WriteUint32(uint32_t value);
+
+    void WriteInt32(int32_t value);
+
+    void WriteUint64(uint64_t value);
+
+    void WriteDouble(double value);
+
+    void WriteString(std::string_view value);
+
+    void WriteDocumentStatus(DocumentStatus status);
+
+    void WriteDocument(const Document& document);
+
+    void WriteCollectionStatistics(const SearchServer::CollectionStatistics& statistics);
+
+    const std::string& GetData() const;
+
+private:
+    std::string data_;
+};
+
+// throws std::runtime_error if the data ends before the value
+class Reader {
+public:
+    explicit Reader(std::string_view data);
+
+    uint8_t ReadUint8();
+
+    uint32_t ReadUint32();
+
+    int32_t ReadInt32();
+
+    uint64_t ReadUint64();
+
+    double ReadDouble();
+
+    // view of the read data
+    std::string_view ReadString();
+
+    // number of the following elements, the message must have room for them,
+    // so a corrupted count can not make the reader allocate more than the message size
+    uint32_t ReadCount(size_t min_element_size);
+
+    // throws std::invalid_argument if the status is unknown
+    DocumentStatus ReadDocumentStatus();
+
+    Document ReadDocument();
+
+    SearchServer::CollectionStatistics ReadCollectionStatistics();
+
+    bool IsEnd() const;
+
+private:
+    std::string_view Take(size_t size);
+
+private:
+    std::string_view data_;
+};
+
+// both throw std::runtime_error on socket errors
+void SendFrame(int socket, std::string_view payload);
+
+// returns false if the peer has closed the connection before the frame
+bool ReceiveFrame(int socket, std::string& payload);
+
+} // namespace shard_protocol
@@ -0,0 +1,281 @@
+#include "shard_socket_server.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <execution>
+#include <stdexcept>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "shard_protocol.h"
+
+using namespace std::literals;
+
+namespace {
+
+std::string MakeErrorResponse(shard_protocol::ResponseStatus status, const std::exception& error) {
+    shard_protocol::Writer writer;
+    writer.WriteUint8(static_cast<uint8_t>(status));
+    writer.WriteString(error.what());
+
+    return writer.GetData();
+}
+
+} // namespace
+
+ShardSocketServer::ShardSocketServer(const std::string& socket_path, const std::string_view stop_words)
+    : socket_path_(socket_path)
+    , server_(stop_words) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+
+    if (socket_path_.empty() || socket_path_.size() >= sizeof(address.sun_path)) {
+        throw std::invalid_argument("invalid socket path"s);
+    }
+
+    std::memcpy(address.sun_path, socket_path_.data(), socket_path_.size());
+
+    listen_socket_ = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_socket_ < 0) {
+        throw std::runtime_error("failed to create shard socket: "s + std::strerror(errno));
+    }
+
+    // a socket file left by a stopped shard would make bind fail
+    unlink(socket_path_.c_str());
+
+    if (bind(listen_socket_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0
+        || listen(listen_socket_, SOMAXCONN) < 0) {
+        const std::string error = std::strerror(errno);
+        close(listen_socket_);
+
+        throw std::runtime_error("failed to listen on shard socket: "s + error);
+    }
+}
+
+ShardSocketServer::~ShardSocketServer() {
+    Stop();
+
+    for (std::thread& thread : connection_threads_) {
+        thread.join();
+    }
+
+    close(listen_socket_);
+    unlink(socket_path_.c_str());
+}
+
+void ShardSocketServer::Serve() {
+    while (true) {
+        const int connection_socket = accept(listen_socket_, nullptr, nullptr);
+
+        if (connection_socket < 0) {
+            if (is_stopped_.load()) {
+                return;
+            }
+
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+
+            throw std::runtime_error("failed to accept shard connection: "s + std::strerror(errno));
+        }
+
+        std::vector<std::thread> finished_threads;
+
+        {
+            const std::lock_guard guard(connections_mutex_);
+
+            // Stop could have shut the connections down before this one was registered
+            if (is_stopped_.load()) {
+                close(connection_socket);
+                return;
+            }
+
+            // threads of closed connections are reaped here, so the list does not grow with every connection
+            for (const std::thread::id thread_id : finished_thread_ids_) {
+                const auto thread = std::find_if(connection_threads_.begin(), connection_threads_.end(),
+                                                 [thread_id](const std::thread& thread) {
+                                                     return thread.get_id() == thread_id;
+                                                 });
+
+                finished_threads.push_back(std::move(*thread));
+                connection_threads_.erase(thread);
+            }
+            finished_thread_ids_.clear();
+
+            connection_sockets_.push_back(connection_socket);
+            connection_threads_.emplace_back([this, connection_socket] {
+                ServeConnection(connection_socket);
+            });
+        }
+
+        // a finished thread only returns after it released the lock, so joining it does not wait for long
+        for (std::thread& thread : finished_threads) {
+            thread.join();
+        }
+    }
+} // Serve
+
+void ShardSocketServer::Stop() {
+    const std::lock_guard guard(connections_mutex_);
+
+    is_stopped_.store(true);
+
+    // wakes up accept and recv, the sockets are closed by their owners
+    shutdown(listen_socket_, SHUT_RDWR);
+
+    for (const int connection_socket : connection_sockets_) {
+        shutdown(connection_socket, SHUT_RDWR);
+    }
+}
+
+const std::string& ShardSocketServer::GetSocketPath() const {
+    return socket_path_;
+}
+
+void ShardSocketServer::ServeConnection(int connection_socket) {
+    std::string request;
+    std::string response;
+
+    try {
+        while (shard_protocol::ReceiveFrame(connection_socket, request)) {
+            HandleRequest(request, response);
+            shard_protocol::SendFrame(connection_socket, response);
+        }
+    } catch (const std::exception&) {
+        // the connection is broken, the client of the coordinator reports the shard as failed from now on
+    }
+
+    // the socket is closed under the lock, so Stop never shuts down a reused descriptor
+    const std::lock_guard guard(connections_mutex_);
+
+    connection_sockets_.erase(std::find(connection_sockets_.begin(), connection_sockets_.end(), connection_socket));
+    close(connection_socket);
+    finished_thread_ids_.push_back(std::this_thread::get_id());
+} // ServeConnection
+
+void ShardSocketServer::HandleRequest(std::string_view request, std::string& response) {
+    using shard_protocol::MessageType;
+    using shard_protocol::ResponseStatus;
+
+    shard_protocol::Writer writer;
+    writer.WriteUint8(static_cast<uint8_t>(ResponseStatus::OK));
+
+    try {
+        shard_protocol::Reader reader(request);
+
+        switch (static_cast<MessageType>(reader.ReadUint8())) {
+            case MessageType::ADD_DOCUMENT: {
+                const int document_id = reader.ReadInt32();
+                const std::string_view document = reader.ReadString();
+                const DocumentStatus status = reader.ReadDocumentStatus();
+
+                std::vector<int> ratings(reader.ReadCount(4));
+                for (int& rating : ratings) {
+                    rating = reader.ReadInt32();
+                }
+
+                writer.WriteUint8(server_.AddDocument(document_id, document, status, ratings));
+                break;
+            }
+            case MessageType::ADD_DOCUMENTS: {
+                std::vector<SearchServer::NewDocument> documents(reader.ReadCount(13));
+                for (SearchServer::NewDocument& document : documents) {
+                    document.document_id = reader.ReadInt32();
+                    document.text = reader.ReadString();
+                    document.status = reader.ReadDocumentStatus();
+
+                    document.ratings.resize(reader.ReadCount(4));
+                    for (int& rating : document.ratings) {
+                        rating = reader.ReadInt32();
+                    }
+                }
+
+                server_.AddDocuments(std::execution::par, documents);
+                break;
+            }
+            case MessageType::CHECK_DOCUMENT_IDS: {
+                std::vector<int> document_ids(reader.ReadCount(4));
+                for (int& document_id : document_ids) {
+                    document_id = reader.ReadInt32();
+                }
+
+                server_.Read([&document_ids](const SearchServer& server) {
+                    for (const int document_id : document_ids) {
+                        server.CheckDocumentId(document_id);
+                    }
+
+                    return true;
+                });
+                break;
+            }
+            case MessageType::REMOVE_DOCUMENT: {
+                server_.RemoveDocument(reader.ReadInt32());
+                break;
+            }
+            case MessageType::GET_DOCUMENT_COUNT: {
+                writer.WriteInt32(server_.GetDocumentCount());
+                break;
+            }
+            case MessageType::GET_COLLECTION_STATISTICS: {
+                const std::string_view raw_query = reader.ReadString();
+
+                writer.WriteCollectionStatistics(server_.Read([raw_query](const SearchServer& server) {
+                    return server.GetCollectionStatistics(raw_query);
+                }));
+                break;
+            }
+            case MessageType::FIND_TOP_DOCUMENTS: {
+                const std::string_view raw_query = reader.ReadString();
+                const DocumentStatus desired_status = reader.ReadDocumentStatus();
+                const int max_result_document_count = reader.ReadInt32();
+                const SearchServer::CollectionStatistics statistics = reader.ReadCollectionStatistics();
+
+                const auto predicate = [desired_status](int , DocumentStatus document_status, int ) {
+                    return document_status == desired_status;
+                };
+
+                const std::vector<Document> documents = server_.Read([&](const SearchServer& server) {
+                    return server.FindTopDocuments(std::execution::seq, raw_query, predicate, max_result_document_count, statistics);
+                });
+
+                writer.WriteUint32(static_cast<uint32_t>(documents.size()));
+                for (const Document& document : documents) {
+                    writer.WriteDocument(document);
+                }
+                break;
+            }
+            case MessageType::MATCH_DOCUMENT: {
+                const std::string_view raw_query = reader.ReadString();
+                const int document_id = reader.ReadInt32();
+
+                // the words are written while the version of the server they point to is read
+                server_.Read([&](const SearchServer& server) {
+                    const auto [words, status] = server.MatchDocument(raw_query, document_id);
+
+                    writer.WriteUint32(static_cast<uint32_t>(words.size()));
+                    for (const std::string_view word : words) {
+                        writer.WriteString(word);
+                    }
+                    writer.WriteDocumentStatus(status);
+
+                    return true;
+                });
+                break;
+            }
+            default: {
+                throw std::invalid_argument("unknown message type"s);
+            }
+        }
+
+        response = writer.GetData();
+    } catch (const std::invalid_argument& error) {
+        response = MakeErrorResponse(ResponseStatus::INVALID_ARGUMENT, error);
+    } catch (const std::out_of_range& error) {
+        response = MakeErrorResponse(ResponseStatus::OUT_OF_RANGE, error);
+    } catch (const std::exception& error) {
+        response = MakeErrorResponse(ResponseStatus::ERROR, error);
+    }
+} // HandleRequest
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "concurrent_search_server.h"
+
+// shard of a collection served over a Unix domain socket with the shard protocol
+// meant to run in its own process, one per shard, so shards can be restarted and pinned to cores on their own,
+// the process is started as search_server --shard <socket path> [stop words] and stopped by SIGTERM
+// every connection is served by its own thread, queries of different connections run concurrently
+class ShardSocketServer {
+public:
+    // the socket file is replaced if it exists
+    // throws std::runtime_error if the socket can not be created
+    ShardSocketServer(const std::string& socket_path, const std::string_view stop_words);
+
+    ShardSocketServer(const ShardSocketServer&) = delete;
+    ShardSocketServer& operator=(const ShardSocketServer&) = delete;
+
+    ~ShardSocketServer();
+
+public:
+    // accepts connections until Stop is called
+    void Serve();
+
+    // may be called from any thread, closes all connections
+    void Stop();
+
+    const std::string& GetSocketPath() const;
+
+private:
+    void ServeConnection(int connection_socket);
+
+    // handles one request, the response is written to response
+    void HandleRequest(std::string_view request, std::string& response);
+
+private:
+    std::string socket_path_;
+    int listen_socket_ = -1;
+
+    std::atomic<bool> is_stopped_{false};
+
+    std::mutex connections_mutex_;
+    std::vector<int> connection_sockets_;
+    std::vector<std::thread> connection_threads_;
+    // threads that served their connection and wait to be joined by the next accept
+    std::vector<std::thread::id> finished_thread_ids_;
+
+    ConcurrentSearchServer server_;
+};
@@ -0,0 +1,139 @@
+#include "sharded_search_server.h"
+
+#include <set>
+#include <stdexcept>
+
+#include "string_processing.h"
+
+using namespace std::literals;
+
+ShardedSearchServer::ShardedSearchServer(int shard_count) {
+    if (shard_count <= 0) {
+        throw std::invalid_argument("there must be at least one shard"s);
+    }
+
+    shards_.resize(shard_count);
+}
+
+ShardedSearchServer::ShardedSearchServer(int shard_count, const std::string_view stop_words) {
+    if (shard_count <= 0) {
+        throw std::invalid_argument("there must be at least one shard"s);
+    }
+
+    shards_.reserve(shard_count);
+    for (int i = 0; i < shard_count; ++i) {
+        shards_.emplace_back(stop_words);
+    }
+}
+
+bool ShardedSearchServer::AddDocument(int document_id, const std::string_view document,
+                                      DocumentStatus status, const std::vector<int>& ratings) {
+    if (document_id < 0) {
+        throw std::invalid_argument("negative ids are not allowed"s);
+    }
+
+    return shards_[GetShardIndex(document_id)].AddDocument(document_id, document, status, ratings);
+}
+
+void ShardedSearchServer::AddDocuments(const std::vector<SearchServer::NewDocument>& documents) {
+    // the whole batch is checked before any shard gets its part, so the batch is added by all shards or by none
+    std::set<int> new_document_ids;
+
+    for (const SearchServer::NewDocument& document : documents) {
+        if (document.document_id < 0) {
+            throw std::invalid_argument("negative ids are not allowed"s);
+        }
+
+        shards_[GetShardIndex(document.document_id)].CheckDocumentId(document.document_id);
+
+        if (!new_document_ids.insert(document.document_id).second) {
+            throw std::invalid_argument("repeating ids are not allowed"s);
+        }
+
+        if (string_processing::ContainsControlChars(document.text)) {
+            throw std::invalid_argument("word in document contains unaccaptable symbol"s);
+        }
+    }
+
+    std::vector<std::vector<SearchServer::NewDocument>> shard_to_documents(shards_.size());
+
+    for (const SearchServer::NewDocument& document : documents) {
+        shard_to_documents[GetShardIndex(document.document_id)].push_back(document);
+    }
+
+    std::vector<std::exception_ptr> shard_to_error(shards_.size());
+
+    std::vector<int> shard_indexes(shards_.size());
+    for (size_t i = 0; i < shard_indexes.size(); ++i) {
+        shard_indexes[i] = static_cast<int>(i);
+    }
+
+    std::for_each(std::execution::par, shard_indexes.begin(), shard_indexes.end(), [&](int shard_index) {
+        try {
+            shards_[shard_index].AddDocuments(shard_to_documents[shard_index]);
+        } catch (...) {
+            shard_to_error[shard_index] = std::current_exception();
+        }
+    });
+
+    for (const auto& error : shard_to_error) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+void ShardedSearchServer::RemoveDocument(const int document_id) {
+    if (document_id >= 0) {
+        shards_[GetShardIndex(document_id)].RemoveDocument(document_id);
+    }
+}
+
+int ShardedSearchServer::GetDocumentCount() const {
+    int document_count = 0;
+
+    for (const SearchServer& shard : shards_) {
+        document_count += shard.GetDocumentCount();
+    }
+
+    return document_count;
+}
+
+int ShardedSearchServer::GetShardCount() const {
+    return static_cast<int>(shards_.size());
+}
+
+void ShardedSearchServer::SetQueryMode(SearchServer::QueryMode query_mode) {
+    for (SearchServer& shard : shards_) {
+        shard.SetQueryMode(query_mode);
+    }
+}
+
+std::vector<Document> ShardedSearchServer::FindTopDocuments(const std::string_view raw_query,
+                                                            const DocumentStatus& desired_status, int max_result_document_count) const {
+    const auto predicate = [desired_status](int , DocumentStatus document_status, int ) {
+        return document_status == desired_status;
+    };
+
+    return FindTopDocuments(raw_query, predicate, max_result_document_count);
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> ShardedSearchServer::MatchDocument(const std::string_view raw_query,
+                                                                                             const int document_id) const {
+    if (document_id < 0) {
+        throw std::out_of_range("document is not found"s);
+    }
+
+    return shards_[GetShardIndex(document_id)].MatchDocument(raw_query, document_id);
+}
+
+int ShardedSearchServer::GetShardIndex(int document_id, int shard_count) {
+    // multiplicative hash, ids that differ by the shard count still go to different shards
+    const uint32_t hash = static_cast<uint32_t>(document_id) * 2654435761u;
+
+    return static_cast<int>((hash >> 16) % static_cast<uint32_t>(shard_count));
+}
+
+int ShardedSearchServer::GetShardIndex(int document_id) const {
+    return GetShardIndex(document_id, static_cast<int>(shards_.size()));
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstdint>
+#include <exception>
+#include <execution>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include "document.h"
+#include "search_server.h"
+#include "top_documents.h"
+
+// documents are split between shard_count servers by hash of the document id
+// a query is run on all shards in parallel with the statistics of the whole collection,
+// so the merged top is the same as the top of one server with all the documents
+class ShardedSearchServer {
+public:
+    explicit ShardedSearchServer(int shard_count);
+
+    ShardedSearchServer(int shard_count, const std::string_view stop_words);
+
+public:
+    bool AddDocument(int document_id, const std::string_view document,
+                     DocumentStatus status, const std::vector<int>& ratings);
+
+    // every shard adds its part of the documents in parallel, nothing is added if any of the documents is rejected
+    void AddDocuments(const std::vector<SearchServer::NewDocument>& documents);
+
+    void RemoveDocument(const int document_id);
+
+    int GetDocumentCount() const;
+
+    int GetShardCount() const;
+
+    void SetQueryMode(SearchServer::QueryMode query_mode);
+
+    template<typename Predicate>
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, Predicate predicate,
+                                           int max_result_document_count = SearchServer::kMaxResultDocumentCount) const;
+
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query,
+                                           const DocumentStatus& desired_status = DocumentStatus::ACTUAL,
+                                           int max_result_document_count = SearchServer::kMaxResultDocumentCount) const;
+
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::string_view raw_query, const int document_id) const;
+
+    // shard of the document among shard_count shards, the same for local and remote shards
+    static int GetShardIndex(int document_id, int shard_count);
+
+private:
+    int GetShardIndex(int document_id) const;
+
+private:
+    std::vector<SearchServer> shards_;
+};
+
+template<typename Predicate>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(const std::string_view raw_query, Predicate predicate,
+                                                            int max_result_document_count) const {
+    // gather: document frequencies of the query words in the whole collection, bad queries are rejected here
+    SearchServer::CollectionStatistics statistics;
+    for (const SearchServer& shard : shards_) {
+        statistics += shard.GetCollectionStatistics(raw_query);
+    }
+
+    // scatter: every shard finds its own top
+    std::vector<std::vector<Document>> shard_to_documents(shards_.size());
+    std::vector<std::exception_ptr> shard_to_error(shards_.size());
+
+    std::vector<int> shard_indexes(shards_.size());
+    for (size_t i = 0; i < shard_indexes.size(); ++i) {
+        shard_indexes[i] = static_cast<int>(i);
+    }
+
+    std::for_each(std::execution::par, shard_indexes.begin(), shard_indexes.end(), [&](int shard_index) {
+        // exceptions must not leave a parallel algorithm
+        try {
+            shard_to_documents[shard_index] = shards_[shard_index].FindTopDocuments(std::execution::seq, raw_query, predicate,
+                                                                                    max_result_document_count, statistics);
+        } catch (...) {
+            shard_to_error[shard_index] = std::current_exception();
+        }
+    });
+
+    for (const auto& error : shard_to_error) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    search_server_index::TopDocuments top_documents(max_result_document_count);
+    for (const auto& documents : shard_to_documents) {
+        for (const Document& document : documents) {
+            top_documents.Push(document);
+        }
+    }
+
+    return top_documents.Extract();
+}
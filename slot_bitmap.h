@@ -0,0 +1,100 @@
+#pragma once
+
+#include <algorithm>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "memory_usage.h"
+
+namespace search_server_index {
+
+// set of document slots, one bit per slot
+// every block of kBlockSlots slots keeps the number of its slots in the set, so long ranges are counted block by block
+class SlotBitmap {
+public:
+    void Insert(int slot) {
+        const size_t word = static_cast<size_t>(slot) / kWordBits;
+
+        if (word >= words_.size()) {
+            words_.resize(word + 1, 0);
+            block_counts_.resize(static_cast<size_t>(slot) / kBlockSlots + 1, 0);
+        }
+
+        const uint64_t bit = uint64_t{1} << (static_cast<size_t>(slot) % kWordBits);
+
+        if ((words_[word] & bit) == 0) {
+            words_[word] |= bit;
+            ++block_counts_[static_cast<size_t>(slot) / kBlockSlots];
+            ++count_;
+        }
+    }
+
+    bool Contains(int slot) const {
+        const size_t word = static_cast<size_t>(slot) / kWordBits;
+
+        return word < words_.size() && (words_[word] >> (static_cast<size_t>(slot) % kWordBits) & 1) != 0;
+    }
+
+    size_t GetCount() const {
+        return count_;
+    }
+
+    // number of slots of the set in [begin_slot, end_slot)
+    size_t Count(int begin_slot, int end_slot) const {
+        size_t count = 0;
+
+        for (int slot = begin_slot; slot < end_slot;) {
+            if (static_cast<size_t>(slot) % kBlockSlots == 0 && static_cast<size_t>(end_slot - slot) >= kBlockSlots) {
+                const size_t block = static_cast<size_t>(slot) / kBlockSlots;
+
+                if (block >= block_counts_.size()) {
+                    break;
+                }
+
+                count += block_counts_[block];
+                slot += static_cast<int>(kBlockSlots);
+                continue;
+            }
+
+            const size_t word = static_cast<size_t>(slot) / kWordBits;
+
+            if (word >= words_.size()) {
+                break;
+            }
+
+            const size_t first_bit = static_cast<size_t>(slot) % kWordBits;
+            const size_t end_bit = std::min<size_t>(kWordBits, first_bit + static_cast<size_t>(end_slot - slot));
+
+            uint64_t bits = words_[word] >> first_bit;
+            if (end_bit - first_bit < kWordBits) {
+                bits &= (uint64_t{1} << (end_bit - first_bit)) - 1;
+            }
+
+            count += std::bitset<kWordBits>(bits).count();
+            slot += static_cast<int>(end_bit - first_bit);
+        }
+
+        return count;
+    }
+
+    // the bits are the payload, the block counters are the overhead
+    MemoryUsage GetMemoryUsage() const {
+        MemoryUsage usage = GetVectorMemoryUsage(words_);
+        usage.overhead_bytes += GetVectorMemoryUsage(block_counts_).GetTotalBytes();
+
+        return usage;
+    }
+
+private:
+    static constexpr size_t kWordBits = 64;
+    static constexpr size_t kBlockSlots = 4096;
+
+private:
+    std::vector<uint64_t> words_;
+    std::vector<uint32_t> block_counts_;
+    size_t count_ = 0;
+};
+
+} // namespace search_server_index
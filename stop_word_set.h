@@ -0,0 +1,211 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "memory_usage.h"
+
+namespace search_server_index {
+
+// FNV-1a with a final mix of the bits, constexpr so that stop lists known at build time are hashed by the compiler
+constexpr uint64_t HashStopWord(std::string_view word) {
+    uint64_t hash = 14695981039346656037ull;
+
+    for (const char c : word) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ull;
+    }
+
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDull;
+    hash ^= hash >> 33;
+
+    return hash;
+}
+
+// bit of the length mask, all words of 63 characters and longer share the last bit
+constexpr uint64_t GetStopWordLengthBit(size_t size) {
+    return uint64_t{1} << std::min<size_t>(size, 63);
+}
+
+// blocked Bloom filter, both bits of a word are in one block of the filter, so a word is checked with one probe
+constexpr uint64_t GetStopWordFilterBits(uint64_t hash) {
+    return uint64_t{1} << (hash >> 52 & 63) | uint64_t{1} << (hash >> 58);
+}
+
+constexpr size_t GetStopWordFilterSize(size_t word_count) {
+    // 16 bits of the filter for every word
+    size_t size = 1;
+    while (size * 4 < word_count) {
+        size *= 2;
+    }
+
+    return size;
+}
+
+constexpr size_t GetStopWordTableSize(size_t word_count) {
+    // load of the table is at most 1/2
+    size_t size = 1;
+    while (size < word_count * 2) {
+        size *= 2;
+    }
+
+    return size;
+}
+
+// fills the filter and the table of open addressing with linear probing, entries of the table are indexes of the words
+// plus one, free entries are zeros
+// returns the length mask of the words
+template<typename Words, typename Filter, typename Table>
+constexpr uint64_t BuildStopWordIndex(const Words& words, Filter& filter, Table& table) {
+    uint64_t length_mask = 0;
+
+    for (size_t i = 0; i < words.size(); ++i) {
+        const std::string_view word = words[i];
+        const uint64_t hash = HashStopWord(word);
+
+        length_mask |= GetStopWordLengthBit(word.size());
+        filter[hash >> 32 & (filter.size() - 1)] |= GetStopWordFilterBits(hash);
+
+        size_t position = hash & (table.size() - 1);
+        while (table[position] != 0) {
+            position = (position + 1) & (table.size() - 1);
+        }
+
+        table[position] = static_cast<uint32_t>(i + 1);
+    }
+
+    return length_mask;
+}
+
+// most words are rejected by the length mask or by the filter, the table is probed only for the rest
+template<typename Words, typename Filter, typename Table>
+constexpr bool FindStopWord(const Words& words, const Filter& filter, const Table& table, uint64_t length_mask,
+                            std::string_view word) {
+    if ((length_mask & GetStopWordLengthBit(word.size())) == 0) {
+        return false;
+    }
+
+    const uint64_t hash = HashStopWord(word);
+    const uint64_t filter_bits = GetStopWordFilterBits(hash);
+
+    if ((filter[hash >> 32 & (filter.size() - 1)] & filter_bits) != filter_bits) {
+        return false;
+    }
+
+    for (size_t position = hash & (table.size() - 1); table[position] != 0; position = (position + 1) & (table.size() - 1)) {
+        if (std::string_view(words[table[position] - 1]) == word) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// immutable set of stop words, built once when the server is constructed
+class StopWordSet {
+public:
+    // the length mask of an empty set rejects every word before the filter and the table are read
+    StopWordSet() = default;
+
+    // repeating words are stored once
+    explicit StopWordSet(std::vector<std::string> words)
+        : words_(std::move(words)) {
+        std::sort(words_.begin(), words_.end());
+        words_.erase(std::unique(words_.begin(), words_.end()), words_.end());
+
+        filter_.resize(GetStopWordFilterSize(words_.size()));
+        table_.resize(GetStopWordTableSize(words_.size()));
+
+        length_mask_ = BuildStopWordIndex(words_, filter_, table_);
+    }
+
+    bool Contains(std::string_view word) const {
+        return FindStopWord(words_, filter_, table_, length_mask_, word);
+    }
+
+    size_t size() const {
+        return words_.size();
+    }
+
+    bool empty() const {
+        return words_.empty();
+    }
+
+    // words in lexicographical order
+    std::vector<std::string>::const_iterator begin() const {
+        return words_.begin();
+    }
+
+    std::vector<std::string>::const_iterator end() const {
+        return words_.end();
+    }
+
+    // characters of the words are payload, the filter and the table are overhead
+    MemoryUsage GetMemoryUsage() const {
+        MemoryUsage usage = GetVectorMemoryUsage(words_);
+
+        for (const std::string& word : words_) {
+            usage += GetStringMemoryUsage(word);
+        }
+
+        usage.overhead_bytes += GetVectorMemoryUsage(filter_).GetTotalBytes();
+        usage.overhead_bytes += GetVectorMemoryUsage(table_).GetTotalBytes();
+
+        return usage;
+    }
+
+private:
+    std::vector<std::string> words_;
+    std::vector<uint64_t> filter_;
+    std::vector<uint32_t> table_;
+    uint64_t length_mask_ = 0;
+};
+
+// set of stop words known at build time, built by the compiler when it is constexpr
+// the words are views, they must outlive the set, as literals do
+// repeating words are allowed
+template<size_t N>
+class StaticStopWordSet {
+public:
+    constexpr explicit StaticStopWordSet(const std::array<std::string_view, N>& words)
+        : words_(words) {
+        length_mask_ = BuildStopWordIndex(words_, filter_, table_);
+    }
+
+    constexpr bool Contains(std::string_view word) const {
+        return FindStopWord(words_, filter_, table_, length_mask_, word);
+    }
+
+    constexpr size_t size() const {
+        return N;
+    }
+
+    constexpr const std::string_view* begin() const {
+        return words_.data();
+    }
+
+    constexpr const std::string_view* end() const {
+        return words_.data() + N;
+    }
+
+private:
+    std::array<std::string_view, N> words_;
+    std::array<uint64_t, GetStopWordFilterSize(N)> filter_ = {};
+    std::array<uint32_t, GetStopWordTableSize(N)> table_ = {};
+    uint64_t length_mask_ = 0;
+};
+
+// constexpr auto kStopWords = MakeStopWordSet("and", "in", "the");
+template<typename... Words>
+constexpr StaticStopWordSet<sizeof...(Words)> MakeStopWordSet(const Words&... words) {
+    return StaticStopWordSet<sizeof...(Words)>({std::string_view(words)...});
+}
+
+} // namespace search_server_index
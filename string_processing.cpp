@@ -19,18 +19,11 @@ std::vector<std::string> SplitIntoWords(const std::string& text) {
 
 std::vector<std::string_view> SplitIntoWords(std::string_view text) {
     std::vector<std::string_view> result;
+    result.reserve(CountWords(text));
 
-    while (true) {
-        size_t space = text.find(' ');
-
-        result.push_back(text.substr(0, space));
-
-        if (space == text.npos) {
-            break;
-        } else {
-            text.remove_prefix(space + 1);
-        }
-    }
+    ForEachWord(text, [&result](std::string_view word) {
+        result.push_back(word);
+    });
     
     return result;
 }
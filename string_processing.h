@@ -1,13 +1,307 @@
 #pragma once
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
 #include <vector>
 #include <string>
+#include <string_view>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 namespace string_processing {
 
+// words are separated by spaces, runs of spaces do not make empty words
+// calls function(std::string_view word) for every word of the text in order, nothing is allocated
+template<typename Function>
+void ForEachWordScalar(std::string_view text, Function function) {
+    size_t word_begin = 0;
+    bool is_in_word = false;
+
+    for (size_t i = 0; i < text.size(); ++i) {
+        const bool is_word_char = text[i] != ' ';
+
+        if (is_word_char != is_in_word) {
+            if (is_in_word) {
+                function(text.substr(word_begin, i - word_begin));
+            } else {
+                word_begin = i;
+            }
+
+            is_in_word = is_word_char;
+        }
+    }
+
+    if (is_in_word) {
+        function(text.substr(word_begin));
+    }
+}
+
+inline size_t CountWordsScalar(std::string_view text) {
+    size_t count = 0;
+    bool is_in_word = false;
+
+    for (const char c : text) {
+        const bool is_word_char = c != ' ';
+
+        count += is_word_char && !is_in_word;
+        is_in_word = is_word_char;
+    }
+
+    return count;
+}
+
+// control characters are below ' ', texts with them are not valid
+inline bool IsControlChar(char c) {
+    return c >= '\0' && c < ' ';
+}
+
+inline bool ContainsControlCharsScalar(std::string_view text) {
+    return std::any_of(text.begin(), text.end(), IsControlChar);
+}
+
+// texts are scanned by blocks of kWordScanBlockSize characters, both masks of a block come from one load
+// bit i of word_chars is set if character i is not a space, bit i of control_chars is set if it is a control character
+struct BlockMasks {
+    uint32_t word_chars = 0;
+    uint32_t control_chars = 0;
+};
+
+inline BlockMasks LoadBlockMasksScalar(const char* data, size_t size) {
+    BlockMasks masks;
+
+    for (size_t i = 0; i < size; ++i) {
+        masks.word_chars |= static_cast<uint32_t>(data[i] != ' ') << i;
+        masks.control_chars |= static_cast<uint32_t>(IsControlChar(data[i])) << i;
+    }
+
+    return masks;
+}
+
+// a character is a control character if its three high bits are zero
+#if defined(__AVX2__)
+static constexpr size_t kWordScanBlockSize = 32;
+static constexpr uint32_t kWordScanBlockMask = 0xFFFFFFFFu;
+
+inline BlockMasks LoadBlockMasks(const char* data) {
+    const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+    const __m256i high_bits = _mm256_and_si256(block, _mm256_set1_epi8(static_cast<char>(0xE0)));
+
+    return {~static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, _mm256_set1_epi8(' ')))),
+            static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(high_bits, _mm256_setzero_si256())))};
+}
+#elif defined(__SSE2__)
+static constexpr size_t kWordScanBlockSize = 16;
+static constexpr uint32_t kWordScanBlockMask = 0xFFFFu;
+
+inline BlockMasks LoadBlockMasks(const char* data) {
+    const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+    const __m128i high_bits = _mm_and_si128(block, _mm_set1_epi8(static_cast<char>(0xE0)));
+
+    return {~static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, _mm_set1_epi8(' ')))) & kWordScanBlockMask,
+            static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(high_bits, _mm_setzero_si128())))};
+}
+#else
+static constexpr size_t kWordScanBlockSize = 32;
+static constexpr uint32_t kWordScanBlockMask = 0xFFFFFFFFu;
+
+inline BlockMasks LoadBlockMasks(const char* data) {
+    return LoadBlockMasksScalar(data, kWordScanBlockSize);
+}
+#endif
+
+// 64 characters are checked per iteration, the masks of its blocks are merged before the branch
+inline bool ContainsControlChars(std::string_view text) {
+    static constexpr size_t kStride = 64;
+
+    size_t offset = 0;
+
+    for (; offset + kStride <= text.size(); offset += kStride) {
+        uint32_t control_chars = 0;
+
+        for (size_t block_offset = 0; block_offset < kStride; block_offset += kWordScanBlockSize) {
+            control_chars |= LoadBlockMasks(text.data() + offset + block_offset).control_chars;
+        }
+
+        if (control_chars != 0) {
+            return true;
+        }
+    }
+
+    return ContainsControlCharsScalar(text.substr(offset));
+}
+
+// words are counted by their first characters
+inline size_t CountWords(std::string_view text) {
+    size_t count = 0;
+    bool is_in_word = false;
+    size_t offset = 0;
+
+    for (; offset + kWordScanBlockSize <= text.size(); offset += kWordScanBlockSize) {
+        const uint32_t word_chars = LoadBlockMasks(text.data() + offset).word_chars;
+
+        count += static_cast<size_t>(__builtin_popcount(word_chars & ~(word_chars << 1 | static_cast<uint32_t>(is_in_word))));
+        is_in_word = (word_chars >> (kWordScanBlockSize - 1) & 1) != 0;
+    }
+
+    // the tail starts a word only if the block before it ends with a space
+    const std::string_view tail = text.substr(offset);
+    return count + CountWordsScalar(tail) - (is_in_word && !tail.empty() && tail.front() != ' ');
+}
+
+// words of a text found one at a time while the range is iterated, the same words as ForEachWord gives
+// the iterator keeps the word boundaries of the scanned block, so a block is loaded once for all its words
+// nothing is allocated, the words are views of the text
+class WordRange {
+public:
+    class Iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::string_view;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const std::string_view*;
+        using reference = const std::string_view&;
+
+        // end of every range
+        Iterator() = default;
+
+        explicit Iterator(std::string_view text): text_(text) {
+            FindWord();
+        }
+
+        reference operator*() const {
+            return word_;
+        }
+
+        pointer operator->() const {
+            return &word_;
+        }
+
+        Iterator& operator++() {
+            FindWord();
+            return *this;
+        }
+
+        Iterator operator++(int) {
+            Iterator previous = *this;
+            ++*this;
+            return previous;
+        }
+
+        // words are never empty, so the end is the only iterator without data
+        bool operator==(const Iterator& other) const {
+            return word_.data() == other.word_.data();
+        }
+
+        bool operator!=(const Iterator& other) const {
+            return !(*this == other);
+        }
+
+        // control characters are checked while the words are scanned, so a text is read once to be split and validated
+        // control characters are never spaces, so those of the current word and the words before it are already found
+        bool HasControlChars() const {
+            return has_control_chars_;
+        }
+
+    private:
+        void FindWord() {
+            while (true) {
+                for (; boundaries_ != 0; boundaries_ &= boundaries_ - 1) {
+                    const size_t position = block_offset_ + static_cast<size_t>(__builtin_ctzll(boundaries_));
+
+                    if (is_in_word_) {
+                        boundaries_ &= boundaries_ - 1;
+                        is_in_word_ = false;
+                        word_ = text_.substr(word_begin_, position - word_begin_);
+                        return;
+                    }
+
+                    word_begin_ = position;
+                    is_in_word_ = true;
+                }
+
+                if (next_block_offset_ > text_.size()) {
+                    word_ = {};
+                    return;
+                }
+
+                LoadBlock();
+            }
+        }
+
+        // bit i of the boundaries is set if the character i of the block differs from the one before it,
+        // the end of the text is a boundary if the text ends with a word
+        void LoadBlock() {
+            block_offset_ = next_block_offset_;
+
+            const size_t size = text_.size() - block_offset_;
+            const uint64_t carry = is_in_word_;
+
+            if (size >= kWordScanBlockSize) {
+                const BlockMasks masks = LoadBlockMasks(text_.data() + block_offset_);
+                const uint64_t word_chars = masks.word_chars;
+
+                boundaries_ = (word_chars ^ (word_chars << 1 | carry)) & kWordScanBlockMask;
+                has_control_chars_ |= masks.control_chars != 0;
+                next_block_offset_ += kWordScanBlockSize;
+
+                // a text of whole blocks gets an empty last block for its end
+                return;
+            }
+
+            const BlockMasks masks = LoadBlockMasksScalar(text_.data() + block_offset_, size);
+            const uint64_t word_chars = masks.word_chars;
+
+            boundaries_ = (word_chars ^ (word_chars << 1 | carry)) & ((uint64_t{1} << (size + 1)) - 1);
+            has_control_chars_ |= masks.control_chars != 0;
+            next_block_offset_ = text_.size() + 1;
+        }
+
+    private:
+        std::string_view text_;
+        std::string_view word_;
+
+        size_t block_offset_ = 0;
+        size_t next_block_offset_ = 0;
+        uint64_t boundaries_ = 0;
+
+        size_t word_begin_ = 0;
+        bool is_in_word_ = false;
+
+        bool has_control_chars_ = false;
+    };
+
+    explicit WordRange(std::string_view text): text_(text) {
+    }
+
+    Iterator begin() const {
+        return Iterator(text_);
+    }
+
+    Iterator end() const {
+        return Iterator();
+    }
+
+private:
+    std::string_view text_;
+};
+
+// calls function(std::string_view word) for every word of the text in order
+template<typename Function>
+void ForEachWord(std::string_view text, Function function) {
+    for (const std::string_view word : WordRange(text)) {
+        function(word);
+    }
+}
+
+// the vector is sized by CountWords before it is filled
 std::vector<std::string_view> SplitIntoWords(std::string_view text);
 
 std::vector<std::string> SplitIntoWords(const std::string& text);
 
 }
-
@@ -1,12 +1,42 @@
 #include <vector>
 #include <cmath>
 #include <cassert>
+#include <execution>
+#include <random>
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <csignal>
+#include <chrono>
+
+#include <sys/wait.h>
+#include <unistd.h>
 
 #include "test_search_server.h"
 #include "testing_framework.h"
+#include "concurrent_search_server.h"
+#include "durable_search_server.h"
+#include "index_snapshot.h"
+#include "process_queries.h"
+#include "remote_sharded_search_server.h"
 #include "search_server.h"
+#include "sharded_search_server.h"
+#include "shard_socket_server.h"
 #include "string_processing.h"
 #include "remove_duplicates.h"
+#include "posting_list.h"
+#include "segment.h"
+#include "slot_bitmap.h"
+#include "stop_word_set.h"
+#include "word_storage.h"
+
+// word frequencies of servers with different term ids are compared by words
+std::map<std::string_view, double> ToMap(const SearchServer::WordFrequencies& word_frequencies) {
+    return {word_frequencies.begin(), word_frequencies.end()};
+}
 
 void TestIteratingOverSearchServer() {
     SearchServer search_server;
@@ -22,6 +52,18 @@ void TestIteratingOverSearchServer() {
     }
     
     assert((ids_in_search_server == std::vector<int>{0, 1, 2}));
+    
+    // documents come in order of addition, removed ones are skipped
+    search_server_helpers::AddDocument(search_server, 10, "lonely owl"s, DocumentStatus::ACTUAL, {1});
+    search_server_helpers::AddDocument(search_server, 5, "grumpy owl"s, DocumentStatus::ACTUAL, {1});
+    search_server.RemoveDocument(0);
+    search_server.RemoveDocument(10);
+    
+    assert((std::vector<int>(search_server.begin(), search_server.end()) == std::vector<int>{1, 2, 5}));
+    
+    search_server.CompactSegments();
+    
+    assert((std::vector<int>(search_server.begin(), search_server.end()) == std::vector<int>{1, 2, 5}));
 }
 
 void TestGetWordFrequencies() {
@@ -41,9 +83,7 @@ void TestGetWordFrequencies() {
         
         const auto word_frequencies_of_not_existing_document = search_server.GetWordFrequencies(42);
         
-        std::map<std::string_view, double> empty_map;
-        
-        assert(empty_map == word_frequencies_of_not_existing_document);
+        assert(word_frequencies_of_not_existing_document.empty());
     }
 }
 
@@ -72,9 +112,15 @@ void TestRemoveDuplicates() {
     search_server_helpers::AddDocument(search_server, 2, "happy cat"s, DocumentStatus::ACTUAL, {1, 2, 3});
     search_server_helpers::AddDocument(search_server, 3, "cat cat happy"s, DocumentStatus::ACTUAL, {1, 2, 3});
     
+    
+    // the duplicate with the least id is kept though it is added later
+    search_server_helpers::AddDocument(search_server, 9, "lonely owl"s, DocumentStatus::ACTUAL, {1, 2, 3});
+    search_server_helpers::AddDocument(search_server, 4, "owl lonely"s, DocumentStatus::ACTUAL, {1, 2, 3});
+    
     remove_duplicates::RemoveDuplicates(search_server);
     
-    assert(search_server.GetDocumentCount() == 3);
+    assert(search_server.GetDocumentCount() == 4);
+    assert((std::vector<int>(search_server.begin(), search_server.end()) == std::vector<int>{0, 1, 2, 4}));
 }
 
 void TestStopWordsExclusion() {
@@ -102,6 +148,55 @@ void TestStopWordsExclusion() {
     }
 }
 
+void TestStopWordSetMatchesSet() {
+    std::mt19937 generator(24);
+    
+    const auto make_word = [&generator]() {
+        // long words share the last bit of the length mask
+        std::string word(1 + generator() % 70, 'a');
+        for (char& c : word) {
+            c = 'a' + static_cast<char>(generator() % 4);
+        }
+        
+        return word;
+    };
+    
+    for (const int word_count : {0, 1, 3, 100, 1000}) {
+        std::vector<std::string> words;
+        for (int i = 0; i < word_count; ++i) {
+            words.push_back(make_word());
+        }
+        
+        const std::set<std::string, std::less<>> expected_words(words.begin(), words.end());
+        const search_server_index::StopWordSet stop_words(words);
+        
+        ASSERT_EQUAL(stop_words.size(), expected_words.size());
+        ASSERT(std::equal(stop_words.begin(), stop_words.end(), expected_words.begin(), expected_words.end()));
+        
+        for (const std::string& word : words) {
+            ASSERT(stop_words.Contains(word));
+        }
+        
+        for (int i = 0; i < 1000; ++i) {
+            const std::string word = make_word();
+            ASSERT_EQUAL(stop_words.Contains(word), expected_words.count(word) > 0);
+        }
+        
+        ASSERT(!stop_words.Contains(""sv));
+    }
+    
+    // stop lists known at build time are checked by the compiler
+    static constexpr auto kStopWords = search_server_index::MakeStopWordSet("and", "in", "the", "in");
+    static_assert(kStopWords.Contains("in"sv) && kStopWords.Contains("the"sv));
+    static_assert(!kStopWords.Contains("cat"sv) && !kStopWords.Contains("i"sv) && !kStopWords.Contains(""sv));
+    static_assert(!search_server_index::MakeStopWordSet().Contains("in"sv));
+    
+    SearchServer server(kStopWords);
+    server.AddDocument(42, "cat in the city"s, DocumentStatus::ACTUAL, {1});
+    ASSERT(server.FindTopDocuments("the"s).empty());
+    ASSERT_EQUAL(server.FindTopDocuments("city"s).size(), 1u);
+}
+
 void TestAddedDocumentsCanBeFound() {
     const std::vector<int> ratings = {1, 2, 3};
     
@@ -164,7 +259,7 @@ void TestMatchDocumentResults() {
         
         const auto [words, status] = server.MatchDocument("fat cat out of city"sv, 42);
         
-        std::vector<std::string_view> desired_matched_words{"cat"s, "city"s};
+        std::vector<std::string_view> desired_matched_words{"cat"sv, "city"sv};
         
         ASSERT_EQUAL(words, desired_matched_words);
         ASSERT_EQUAL(status, DocumentStatus::ACTUAL);
@@ -179,7 +274,7 @@ void TestMatchDocumentResults() {
         
         const auto [words, status] = server.MatchDocument("fat cat out of city and a cute dog"s, 43);
         
-        std::vector<std::string_view> desired_matched_words{"dog"s};
+        std::vector<std::string_view> desired_matched_words{"dog"sv};
         
         ASSERT_EQUAL(words, desired_matched_words);
         ASSERT_EQUAL(status, DocumentStatus::BANNED);
@@ -373,6 +468,144 @@ void TestSplitIntoWordsEscapesSpaces() {
     ASSERT_EQUAL(std::vector<std::string>{}, string_processing::SplitIntoWords("                 "s));
 }
 
+void TestWordScanMatchesScalarScan() {
+    ASSERT_EQUAL((std::vector<std::string_view> {"hello"sv, "bro"sv}), string_processing::SplitIntoWords("   hello    bro    "sv));
+    ASSERT(string_processing::SplitIntoWords("                                                 "sv).empty());
+    ASSERT(string_processing::SplitIntoWords(""sv).empty());
+    
+    std::mt19937 generator(21);
+    
+    // words and runs of spaces of every length cross the borders of the scanned blocks
+    for (int i = 0; i < 2000; ++i) {
+        std::string text;
+        
+        const int length = static_cast<int>(generator() % 200);
+        while (static_cast<int>(text.size()) < length) {
+            text.append(generator() % 40, generator() % 2 == 0 ? ' ' : 'a' + static_cast<char>(generator() % 26));
+        }
+        
+        std::vector<std::string_view> expected_words;
+        string_processing::ForEachWordScalar(text, [&expected_words](std::string_view word) {
+            expected_words.push_back(word);
+        });
+        
+        const std::vector<std::string_view> words = string_processing::SplitIntoWords(std::string_view(text));
+        
+        ASSERT(words == expected_words);
+        ASSERT_EQUAL(string_processing::CountWords(text), expected_words.size());
+        ASSERT_EQUAL(string_processing::CountWordsScalar(text), expected_words.size());
+        
+        for (const std::string_view word : words) {
+            ASSERT(!word.empty() && word.find(' ') == std::string_view::npos);
+        }
+    }
+    
+    // double spaces in a query are not empty words any more
+    SearchServer search_server;
+    search_server.AddDocument(1, "  funny   cat  "s, DocumentStatus::ACTUAL, {1});
+    ASSERT_EQUAL(search_server.GetWordFrequencies(1).size(), 2u);
+    ASSERT_EQUAL(search_server.FindTopDocuments("cat   funny"s).size(), 1u);
+}
+
+void TestWordRangeMatchesScalarScan() {
+    std::mt19937 generator(22);
+    
+    for (int i = 0; i < 2000; ++i) {
+        std::string text;
+        
+        const int length = static_cast<int>(generator() % 200);
+        while (static_cast<int>(text.size()) < length) {
+            text.append(generator() % 40, generator() % 2 == 0 ? ' ' : 'a' + static_cast<char>(generator() % 26));
+        }
+        
+        std::vector<std::string_view> expected_words;
+        string_processing::ForEachWordScalar(text, [&expected_words](std::string_view word) {
+            expected_words.push_back(word);
+        });
+        
+        const string_processing::WordRange range(text);
+        ASSERT((std::vector<std::string_view>(range.begin(), range.end()) == expected_words));
+    }
+    
+    ASSERT(string_processing::WordRange(""sv).begin() == string_processing::WordRange(""sv).end());
+    
+    // the words are views of the text
+    const std::string text = "  big   dog "s;
+    auto iterator = string_processing::WordRange(text).begin();
+    ASSERT_EQUAL(*iterator, "big"sv);
+    ASSERT(iterator->data() == text.data() + 2);
+    ASSERT_EQUAL(*++iterator, "dog"sv);
+    ASSERT(++iterator == string_processing::WordRange::Iterator());
+    
+    // stop words and queries are parsed from the range too
+    SearchServer search_server("in   the"s);
+    search_server.AddDocument(1, "cat in the city"s, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(2, "dog in the city"s, DocumentStatus::ACTUAL, {1});
+    ASSERT_EQUAL(search_server.GetWordFrequencies(1).size(), 2u);
+    ASSERT_EQUAL(search_server.FindTopDocuments("  city -dog  the "s).size(), 1u);
+    ASSERT_EQUAL(search_server.FindTopDocuments(std::execution::par, "  city -dog  the "s, DocumentStatus::ACTUAL).size(), 1u);
+}
+
+void TestControlCharsAreFoundWhileSplitting() {
+    std::mt19937 generator(23);
+    
+    for (int i = 0; i < 2000; ++i) {
+        std::string text;
+        
+        const int length = static_cast<int>(generator() % 200);
+        while (static_cast<int>(text.size()) < length) {
+            text.append(generator() % 40, generator() % 2 == 0 ? ' ' : 'a' + static_cast<char>(generator() % 26));
+        }
+        
+        // some texts get a control character at any position, bytes of utf-8 are not control characters
+        if (!text.empty()) {
+            text[generator() % text.size()] = generator() % 2 == 0 ? static_cast<char>(generator() % 32) : '\xD0';
+        }
+        
+        ASSERT_EQUAL(string_processing::ContainsControlChars(text), string_processing::ContainsControlCharsScalar(text));
+        
+        // control characters of a word are found by the time the word is reached
+        const string_processing::WordRange words(text);
+        bool has_control_chars = false;
+        
+        for (auto iterator = words.begin(); iterator != words.end(); ++iterator) {
+            has_control_chars = has_control_chars || string_processing::ContainsControlCharsScalar(*iterator);
+            ASSERT(!has_control_chars || iterator.HasControlChars());
+        }
+    }
+    
+    // a rejected document leaves no words in the dictionary
+    SearchServer search_server;
+    search_server.AddDocument(1, "cat dog"s, DocumentStatus::ACTUAL, {1});
+    const SearchServer::MemoryStats stats = search_server.GetMemoryStats();
+    
+    try {
+        search_server.AddDocument(2, "bird mouse cat fi\x12sh"s, DocumentStatus::ACTUAL, {1});
+        ASSERT_HINT(false, "adding document containing unaccaptable symbol is not handled"s);
+    } catch (const std::invalid_argument&) {
+    }
+    
+    ASSERT_EQUAL(search_server.GetMemoryStats().word_storage_views.payload_bytes, stats.word_storage_views.payload_bytes);
+    ASSERT(search_server.FindTopDocuments("bird"s).empty());
+    
+    const std::vector<SearchServer::NewDocument> documents = {
+        {2, "bird"sv, DocumentStatus::ACTUAL, {1}},
+        {3, "mouse\x01"sv, DocumentStatus::ACTUAL, {1}},
+    };
+    
+    try {
+        search_server.AddDocuments(std::execution::par, documents);
+        ASSERT_HINT(false, "adding documents containing unaccaptable symbol is not handled"s);
+    } catch (const std::invalid_argument&) {
+    }
+    
+    ASSERT_EQUAL(search_server.GetDocumentCount(), 1);
+    ASSERT_EQUAL(search_server.GetMemoryStats().word_storage_views.payload_bytes, stats.word_storage_views.payload_bytes);
+    
+    search_server.AddDocument(2, "bird mouse"s, DocumentStatus::ACTUAL, {1});
+    ASSERT_EQUAL(search_server.FindTopDocuments("bird"s).size(), 1u);
+}
+
 void TestAddDocumentWithRepeatingId() {
     SearchServer search_server;
     
@@ -448,14 +681,1691 @@ void TestEmptyMinusWord() {
     ASSERT_HINT(false, "query with empty minus word is not handled"s);
 }
 
+void TestDoubleSpacesInQueryAreAccepted() {
+    SearchServer search_server;
+    search_server.AddDocument(1, "fluffy cat"s, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(2, "fluffy dog"s, DocumentStatus::ACTUAL, {1});
+    
+    // spaces only separate words, a run of them gives no empty word
+    ASSERT_EQUAL(search_server.FindTopDocuments("fluffy  -dog"s).size(), 1u);
+    ASSERT_EQUAL(search_server.FindTopDocuments(std::execution::par, "  fluffy   cat  "s, DocumentStatus::ACTUAL).size(), 2u);
+    ASSERT_EQUAL(std::get<0>(search_server.MatchDocument("cat  fluffy"s, 1)).size(), 2u);
+    ASSERT_EQUAL(std::get<0>(search_server.MatchDocument(std::execution::par, "cat  fluffy"s, 1)).size(), 2u);
+}
+
+void TestQueryErrorsAreNotShared() {
+    SearchServer search_server;
+    search_server.AddDocument(1, "fluffy cat"s, DocumentStatus::ACTUAL, {1});
+    
+    // a malformed query fails by itself, the next query does not see its error
+    const auto is_rejected = [&search_server](const std::string& query) {
+        try {
+            search_server.FindTopDocuments(query);
+        } catch (const std::invalid_argument&) {
+            return true;
+        }
+        
+        return false;
+    };
+    
+    ASSERT(is_rejected("cat --dog"s));
+    ASSERT_EQUAL(search_server.FindTopDocuments("cat"s).size(), 1u);
+    ASSERT_EQUAL(std::get<0>(search_server.MatchDocument(std::execution::par, "fluffy -dog"s, 1)).size(), 1u);
+    
+    try {
+        search_server.FindTopDocuments(std::execution::par, "cat -"s, DocumentStatus::ACTUAL);
+        ASSERT_HINT(false, "query with empty minus word is not handled"s);
+    } catch (const std::invalid_argument&) {
+    }
+    
+    // malformed and valid queries run at the same time
+    std::atomic<int> wrong_result_count = 0;
+    std::vector<std::thread> threads;
+    
+    for (int thread = 0; thread < 4; ++thread) {
+        threads.emplace_back([&, thread]() {
+            for (int i = 0; i < 500; ++i) {
+                const bool is_malformed = (i + thread) % 2 == 0;
+                
+                if (is_rejected(is_malformed ? "fluffy --cat"s : "fluffy cat"s) != is_malformed) {
+                    ++wrong_result_count;
+                }
+            }
+        });
+    }
+    
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    
+    ASSERT_EQUAL(wrong_result_count.load(), 0);
+}
+
 void TestSearchNonExistentWord() {
     SearchServer search_server;
     
     search_server.FindTopDocuments("potato");
 }
 
+void TestPostingListRejectsCorruptedPostings() {
+    using search_server_index::PostingList;
+    
+    PostingList posting_list;
+    for (int slot = 1000; slot < 1600; slot += 2) {
+        posting_list.Add(slot, 1 + slot % 5, 0.5);
+    }
+    
+    // two compressed blocks and a tail
+    const PostingList::Data data = posting_list.GetData();
+    ASSERT_EQUAL(data.block_count, 2u);
+    ASSERT_EQUAL(data.tail_size, 44u);
+    ASSERT(posting_list.HasValidPostings(1000, 1600));
+    ASSERT(!posting_list.HasValidPostings(1001, 1600));
+    ASSERT(!posting_list.HasValidPostings(1000, 1598));
+    
+    // copies of the arrays are corrupted one at a time, as bits of a snapshot file could be
+    const auto is_valid = [&data](const auto& corrupt) {
+        std::vector<uint32_t> words(data.words, data.words + data.word_count);
+        std::vector<PostingList::Block> blocks(data.blocks, data.blocks + data.block_count);
+        std::vector<int> tail_slots(data.tail_slots, data.tail_slots + data.tail_size);
+        std::vector<uint32_t> tail_counts(data.tail_counts, data.tail_counts + data.tail_size);
+        
+        corrupt(words, blocks, tail_slots, tail_counts);
+        
+        PostingList::Data corrupted_data = data;
+        corrupted_data.words = words.data();
+        corrupted_data.blocks = blocks.data();
+        corrupted_data.tail_slots = tail_slots.data();
+        corrupted_data.tail_counts = tail_counts.data();
+        
+        return PostingList::Borrow(corrupted_data).HasValidPostings(1000, 1600);
+    };
+    
+    ASSERT(is_valid([](auto&, auto&, auto&, auto&) {}));
+    
+    // a larger gap moves the slots past the last slot of the header
+    ASSERT(!is_valid([](auto& words, auto&, auto&, auto&) {
+        words[0] ^= 1u << 30;
+    }));
+    ASSERT(!is_valid([](auto&, auto& blocks, auto&, auto&) {
+        blocks[1].last_slot = blocks[0].last_slot;
+    }));
+    ASSERT(!is_valid([](auto&, auto&, auto& tail_slots, auto&) {
+        std::swap(tail_slots[3], tail_slots[4]);
+    }));
+    ASSERT(!is_valid([](auto&, auto& blocks, auto& tail_slots, auto&) {
+        tail_slots[0] = blocks[1].last_slot;
+    }));
+    ASSERT(!is_valid([](auto&, auto&, auto&, auto& tail_counts) {
+        tail_counts[10] = 0;
+    }));
+}
+
+void TestPostingListKeepsDocumentsSorted() {
+    const auto get_postings = [](const search_server_index::PostingList& posting_list) {
+        std::vector<std::pair<int, uint32_t>> postings;
+        
+        posting_list.ForEachPosting([&postings](int slot, uint32_t count) {
+            postings.push_back({slot, count});
+        });
+        
+        return postings;
+    };
+    
+    search_server_index::PostingList posting_list;
+    
+    // several compressed blocks with small and large gaps and a tail
+    std::vector<std::pair<int, uint32_t>> expected_postings;
+    
+    int slot = 0;
+    for (int i = 0; i < 1000; ++i) {
+        slot += i % 50 == 0 ? 100000 : 1 + i % 3;
+        expected_postings.push_back({slot, static_cast<uint32_t>(1 + i % 7)});
+        posting_list.Add(slot, expected_postings.back().second, 0.5);
+    }
+    
+    ASSERT_EQUAL(posting_list.size(), 1000u);
+    ASSERT_EQUAL(get_postings(posting_list), expected_postings);
+    
+    ASSERT(posting_list.Contains(expected_postings[700].first));
+    ASSERT(!posting_list.Contains(expected_postings[650].first - 1));
+    
+    // cursor skips blocks without decoding postings before the target
+    search_server_index::PostingCursor cursor(posting_list, expected_postings[300].first, expected_postings[900].first, 1.0, nullptr);
+    
+    ASSERT_EQUAL(cursor.GetSlot(), expected_postings[300].first);
+    
+    cursor.NextGreaterOrEqual(expected_postings[640].first - 1);
+    ASSERT_EQUAL(cursor.GetSlot(), expected_postings[640].first);
+    
+    cursor.NextGreaterOrEqual(expected_postings[899].first + 1);
+    ASSERT(cursor.IsEnd());
+    
+    // documents added with decreasing ids are still found and matched
+    SearchServer search_server;
+    
+    search_server.AddDocument(10, "white cat"s, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(2, "black cat"s, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(7, "black dog"s, DocumentStatus::ACTUAL, {1});
+    
+    ASSERT_EQUAL(search_server.FindTopDocuments("cat"s).size(), 2u);
+    ASSERT_EQUAL(std::get<0>(search_server.MatchDocument("black cat"s, 2)), (std::vector<std::string_view>{"black"sv, "cat"sv}));
+    
+    search_server.RemoveDocument(2);
+    
+    ASSERT_EQUAL(search_server.FindTopDocuments("black"s).size(), 1u);
+    ASSERT_EQUAL(search_server.FindTopDocuments("black"s)[0].id, 7);
+}
+
+void TestReaddingRemovedDocumentId() {
+    SearchServer search_server;
+    
+    search_server.AddDocument(3, "funny cat"s, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(1, "silly dog"s, DocumentStatus::BANNED, {5});
+    
+    search_server.RemoveDocument(3);
+    search_server.AddDocument(3, "grumpy cat"s, DocumentStatus::ACTUAL, {4});
+    
+    ASSERT_EQUAL(search_server.GetDocumentCount(), 2);
+    ASSERT(search_server.GetWordFrequencies(3).count("funny"sv) == 0);
+    ASSERT(search_server.FindTopDocuments("funny"s).empty());
+    
+    const auto found_docs = search_server.FindTopDocuments("cat"s);
+    
+    ASSERT_EQUAL(found_docs.size(), 1u);
+    ASSERT_EQUAL(found_docs[0].id, 3);
+    ASSERT_EQUAL(found_docs[0].rating, 4);
+    
+    ASSERT_EQUAL(std::get<1>(search_server.MatchDocument("dog"s, 1)), DocumentStatus::BANNED);
+}
+
+void TestQueryErrorDoesNotDependOnPolicy() {
+    SearchServer search_server;
+    search_server.AddDocument(1, "fluffy cat"s, DocumentStatus::ACTUAL, {1});
+    
+    const auto get_error = [](const auto& find) {
+        try {
+            find();
+        } catch (const std::invalid_argument& error) {
+            return std::string(error.what());
+        }
+        
+        return "no error"s;
+    };
+    
+    // the first malformed word is reported, though an empty minus word is listed before a double minus in QueryStatus
+    std::string query = "cat --dog fluffy bad\x01word"s;
+    for (int i = 0; i < 100; ++i) {
+        query += " cat"s;
+    }
+    query += " -"s;
+    
+    const std::string error = get_error([&] {
+        search_server.FindTopDocuments(std::execution::seq, query, DocumentStatus::ACTUAL);
+    });
+    ASSERT_EQUAL(error, "double minus words are not allowed"s);
+    
+    ASSERT_EQUAL(get_error([&] {
+        search_server.FindTopDocuments(std::execution::par, query, DocumentStatus::ACTUAL);
+    }), error);
+    ASSERT_EQUAL(get_error([&] {
+        search_server.MatchDocument(std::execution::seq, query, 1);
+    }), error);
+    ASSERT_EQUAL(get_error([&] {
+        search_server.MatchDocument(std::execution::par, query, 1);
+    }), error);
+}
+
+void TestParallelFindTopDocumentsMatchesSequential() {
+    const std::vector<std::string> words = {"cat"s, "dog"s, "city"s, "funny"s, "grumpy"s, "tail"s, "hat"s};
+    
+    SearchServer search_server("and with"s);
+    
+    for (int document_id = 0; document_id < 200; ++document_id) {
+        std::string document;
+        
+        for (int i = 0; i < 1 + document_id % 5; ++i) {
+            document += words[(document_id * 7 + i * 3) % words.size()] + " "s;
+        }
+        
+        document += "and"s;
+        
+        search_server.AddDocument(document_id, document, DocumentStatus::ACTUAL, {document_id % 11});
+    }
+    
+    for (const auto& query : {"cat dog"s, "funny -hat"s, "grumpy tail -city"s, "potato"s}) {
+        const auto sequential_docs = search_server.FindTopDocuments(std::execution::seq, query, DocumentStatus::ACTUAL);
+        const auto parallel_docs = search_server.FindTopDocuments(std::execution::par, query, DocumentStatus::ACTUAL);
+        
+        ASSERT_EQUAL(sequential_docs.size(), parallel_docs.size());
+        
+        for (size_t i = 0; i < sequential_docs.size(); ++i) {
+            ASSERT(std::abs(sequential_docs[i].relevance - parallel_docs[i].relevance) < 1e-6);
+            ASSERT_EQUAL(sequential_docs[i].rating, parallel_docs[i].rating);
+        }
+    }
+}
+
+void TestMaxResultDocumentCount() {
+    SearchServer search_server;
+    
+    for (int document_id = 0; document_id < 20; ++document_id) {
+        search_server.AddDocument(document_id, "cat"s + std::string(document_id % 4, 'z') + " city"s, DocumentStatus::ACTUAL, {document_id});
+    }
+    
+    ASSERT_EQUAL(search_server.FindTopDocuments("city"s).size(), 5u);
+    ASSERT(search_server.FindTopDocuments("city"s, DocumentStatus::ACTUAL, 0).empty());
+    ASSERT_EQUAL(search_server.FindTopDocuments("city"s, DocumentStatus::ACTUAL, 100).size(), 20u);
+    
+    // equal relevance, so documents are ordered by rating
+    const auto found_docs = search_server.FindTopDocuments(std::execution::par, "city"s, DocumentStatus::ACTUAL, 3);
+    
+    ASSERT_EQUAL(found_docs.size(), 3u);
+    ASSERT_EQUAL(found_docs[0].id, 19);
+    ASSERT_EQUAL(found_docs[1].id, 18);
+    ASSERT_EQUAL(found_docs[2].id, 17);
+    
+    const auto found_by_predicate = search_server.FindTopDocuments("cat city"s, [](int document_id, DocumentStatus, int) {
+        return document_id % 2 == 0;
+    }, 7);
+    
+    ASSERT_EQUAL(found_by_predicate.size(), 7u);
+    ASSERT_EQUAL(found_by_predicate[0].id, 16);
+}
+
+void TestMaxScoreQueryModeMatchesExhaustive() {
+    const std::vector<std::string> words = {"cat"s, "dog"s, "city"s, "funny"s, "grumpy"s, "tail"s, "hat"s, "potato"s, "curly"s};
+    
+    std::mt19937 generator(42);
+    
+    SearchServer search_server;
+    
+    // frequent words get several blocks of postings
+    for (int document_id = 0; document_id < 1000; ++document_id) {
+        std::string document;
+        
+        const int word_count = 1 + static_cast<int>(generator() % 8);
+        for (int i = 0; i < word_count; ++i) {
+            // lower indexes are more frequent
+            document += words[std::min(generator() % words.size(), generator() % words.size())] + " "s;
+        }
+        
+        search_server.AddDocument(document_id, document, DocumentStatus::ACTUAL, {document_id});
+    }
+    
+    for (int document_id = 0; document_id < 1000; document_id += 7) {
+        search_server.RemoveDocument(document_id);
+    }
+    
+    const auto odd_ids = [](int document_id, DocumentStatus, int) {
+        return document_id % 2 == 1;
+    };
+    
+    for (const auto& query : {"cat dog"s, "funny -cat"s, "grumpy tail curly hat"s, "potato city -dog -tail"s, "cat dog city funny grumpy tail hat potato curly"s}) {
+        for (const int max_result_document_count : {1, 5, 50}) {
+            search_server.SetQueryMode(SearchServer::QueryMode::EXHAUSTIVE);
+            
+            const auto exhaustive_docs = search_server.FindTopDocuments(query, DocumentStatus::ACTUAL, max_result_document_count);
+            const auto exhaustive_odd_docs = search_server.FindTopDocuments(query, odd_ids, max_result_document_count);
+            
+            search_server.SetQueryMode(SearchServer::QueryMode::MAX_SCORE);
+            
+            const auto pruned_docs = search_server.FindTopDocuments(query, DocumentStatus::ACTUAL, max_result_document_count);
+            const auto pruned_odd_docs = search_server.FindTopDocuments(query, odd_ids, max_result_document_count);
+            const auto parallel_pruned_docs = search_server.FindTopDocuments(std::execution::par, query, DocumentStatus::ACTUAL, max_result_document_count);
+            
+            for (const auto& docs : {pruned_docs, parallel_pruned_docs}) {
+                ASSERT_EQUAL(docs.size(), exhaustive_docs.size());
+                
+                for (size_t i = 0; i < docs.size(); ++i) {
+                    ASSERT_EQUAL(docs[i].id, exhaustive_docs[i].id);
+                }
+            }
+            
+            ASSERT_EQUAL(pruned_odd_docs.size(), exhaustive_odd_docs.size());
+            
+            for (size_t i = 0; i < pruned_odd_docs.size(); ++i) {
+                ASSERT_EQUAL(pruned_odd_docs[i].id, exhaustive_odd_docs[i].id);
+            }
+        }
+    }
+}
+
+void TestInverseDocumentFrequencyFollowsDocumentChanges() {
+    constexpr double kAccuracy = 1e-6;
+    
+    SearchServer search_server;
+    
+    search_server.AddDocument(0, "cat city"sv, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(1, "dog city"sv, DocumentStatus::ACTUAL, {1});
+    
+    // cached value of the first query must not survive changes of the documents
+    ASSERT(std::abs(search_server.FindTopDocuments("cat"s)[0].relevance - std::log(2.0) / 2.0) < kAccuracy);
+    
+    search_server.AddDocument(2, "potato"sv, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(3, "cat"sv, DocumentStatus::ACTUAL, {1});
+    
+    {
+        const auto found_docs = search_server.FindTopDocuments("cat"s);
+        
+        ASSERT_EQUAL(found_docs.size(), 2u);
+        ASSERT_EQUAL(found_docs[0].id, 3);
+        ASSERT(std::abs(found_docs[0].relevance - std::log(2.0)) < kAccuracy);
+        ASSERT(std::abs(found_docs[1].relevance - std::log(2.0) / 2.0) < kAccuracy);
+    }
+    
+    search_server.RemoveDocument(2);
+    
+    {
+        const auto found_docs = search_server.FindTopDocuments(std::execution::par, "cat -dog"s, DocumentStatus::ACTUAL);
+        
+        ASSERT_EQUAL(found_docs.size(), 2u);
+        ASSERT_EQUAL(found_docs[0].id, 3);
+        ASSERT(std::abs(found_docs[0].relevance - std::log(3.0 / 2.0)) < kAccuracy);
+        ASSERT(std::abs(found_docs[1].relevance - std::log(3.0 / 2.0) / 2.0) < kAccuracy);
+    }
+}
+
+void TestRemovedWordsAreReclaimed() {
+    SearchServer server("and"s);
+    server.SetMaxMutableSegmentDocumentCount(10);
+    
+    server.AddDocument(0, "cat and dog"s, DocumentStatus::ACTUAL, {1});
+    const std::map<std::string_view, double> live_word_frequencies = ToMap(server.GetWordFrequencies(0));
+    
+    const auto add_day = [&server](int day) {
+        for (int i = 1; i <= 100; ++i) {
+            server.AddDocument(day * 1000 + i, "cat day"s + std::to_string(day) + "word"s + std::to_string(i), DocumentStatus::ACTUAL, {1});
+        }
+    };
+    
+    const auto remove_day = [&server](int day) {
+        for (int i = 1; i <= 100; ++i) {
+            server.RemoveDocument(day * 1000 + i);
+        }
+    };
+    
+    add_day(1);
+    remove_day(1);
+    
+    // only the words of the live document are left
+    const SearchServer::MemoryStats stats = server.GetMemoryStats();
+    ASSERT_EQUAL(stats.word_storage_views.payload_bytes, 2 * sizeof(std::string_view));
+    ASSERT_EQUAL(stats.word_storage_words.payload_bytes, 6u);
+    
+    // words of the same size take the places of the released ones
+    for (int day = 2; day < 10; ++day) {
+        add_day(day);
+        
+        ASSERT_EQUAL(server.FindTopDocuments("day"s + std::to_string(day) + "word7"s).size(), 1u);
+        ASSERT(server.FindTopDocuments("day"s + std::to_string(day - 1) + "word7"s).empty());
+        
+        remove_day(day);
+    }
+    
+    ASSERT_EQUAL(server.GetMemoryStats().word_storage_words.GetTotalBytes(), stats.word_storage_words.GetTotalBytes());
+    
+    // views of the live document are not touched
+    ASSERT(ToMap(server.GetWordFrequencies(0)) == live_word_frequencies);
+    ASSERT_EQUAL(ToMap(server.GetWordFrequencies(0)).begin()->first.data(), live_word_frequencies.begin()->first.data());
+    
+    // reused term ids do not match postings of the removed documents
+    add_day(10);
+    ASSERT_EQUAL(server.FindTopDocuments("day10word1"s).size(), 1u);
+    ASSERT_EQUAL(server.FindTopDocuments("cat"s, [](int, DocumentStatus, int) { return true; }).size(), 5u);
+    ASSERT_EQUAL(std::get<0>(server.MatchDocument("day10word1 day9word1"s, 10001)).size(), 1u);
+    
+    // released term ids survive a snapshot
+    const std::string path = "/tmp/search_server_test_"s + std::to_string(getpid()) + ".snapshot"s;
+    server.SaveSnapshot(path);
+    
+    SearchServer loaded_server = SearchServer::LoadSnapshot(path);
+    std::remove(path.c_str());
+    
+    loaded_server.RemoveDocument(10001);
+    loaded_server.AddDocument(20000, "cat new"s, DocumentStatus::ACTUAL, {1});
+    
+    ASSERT(loaded_server.FindTopDocuments("day10word1"s).empty());
+    ASSERT_EQUAL(loaded_server.FindTopDocuments("new"s).size(), 1u);
+    ASSERT_EQUAL(loaded_server.FindTopDocuments("day10word2"s).size(), 1u);
+}
+
+void TestWordStorageKeepsViewsStable() {
+    search_server_storage_container::WordStorage storage;
+    
+    const std::string_view cat = storage.Insert("cat"s);
+    const std::string long_word(20000, 'w');
+    const std::string_view stored_long_word = storage.Insert(long_word);
+    
+    std::vector<std::string_view> views;
+    for (int i = 0; i < 100000; ++i) {
+        views.push_back(storage.Insert("word"s + std::to_string(i)));
+    }
+    
+    // growing chunks and index do not move the stored words
+    ASSERT_EQUAL(cat, "cat"sv);
+    ASSERT_EQUAL(stored_long_word, long_word);
+    ASSERT(stored_long_word.data() != long_word.data());
+    
+    for (int i = 0; i < 100000; ++i) {
+        ASSERT_EQUAL(views[i], "word"s + std::to_string(i));
+    }
+    
+    // words are stored once
+    ASSERT_EQUAL(storage.Insert("cat"sv).data(), cat.data());
+    ASSERT_EQUAL(storage.Insert("word7"s).data(), views[7].data());
+    ASSERT_EQUAL(storage.GetWordCount(), 100002u);
+    
+    ASSERT(storage.Find("word99999"sv) != nullptr);
+    ASSERT_EQUAL(storage.Find("word99999"sv)->data(), views[99999].data());
+    ASSERT(storage.Find("dog"sv) == nullptr);
+    
+    ASSERT_EQUAL(storage.GetViewsMemoryUsage().payload_bytes, 100002 * sizeof(std::string_view));
+    
+    // the words move with the chunks, both storages can be used after the move
+    search_server_storage_container::WordStorage moved_storage(std::move(storage));
+    
+    ASSERT_EQUAL(moved_storage.GetWordCount(), 100002u);
+    ASSERT_EQUAL(moved_storage.Find("cat"sv)->data(), cat.data());
+    ASSERT_EQUAL(storage.GetWordCount(), 0u);
+    ASSERT(storage.Find("cat"sv) == nullptr);
+    
+    const std::string_view dog = storage.Insert("dog"sv);
+    ASSERT_EQUAL(dog, "dog"sv);
+    ASSERT_EQUAL(storage.Find("dog"sv)->data(), dog.data());
+    ASSERT_EQUAL(storage.GetWordCount(), 1u);
+    ASSERT(moved_storage.Find("dog"sv) == nullptr);
+    
+    moved_storage.Insert("fox"sv);
+    storage = std::move(moved_storage);
+    
+    ASSERT_EQUAL(storage.GetWordCount(), 100003u);
+    ASSERT_EQUAL(storage.Find("word7"sv)->data(), views[7].data());
+    ASSERT(storage.Find("fox"sv) != nullptr);
+    ASSERT_EQUAL(moved_storage.GetWordCount(), 0u);
+    ASSERT_EQUAL(moved_storage.Insert("cat"sv), "cat"sv);
+}
+
+void TestSlotsOfRemovedDocumentsAreGivenBack() {
+    constexpr double kAccuracy = 1e-6;
+    
+    SearchServer server;
+    server.SetMaxMutableSegmentDocumentCount(16);
+    
+    const auto make_text = [](int round, int i) {
+        return "common word"s + std::to_string(i % 7) + " round"s + std::to_string(round) + " tail"s + std::to_string(i % 3);
+    };
+    
+    // every round adds 40 documents and removes the documents of the round before
+    SearchServer::MemoryStats stats_after_warm_up;
+    
+    for (int round = 0; round < 60; ++round) {
+        for (int i = 0; i < 40; ++i) {
+            if (i % 4 == 0) {
+                server.AddDocumentKeepingText(round * 100 + i, make_text(round, i), DocumentStatus::ACTUAL, {i});
+            } else {
+                server.AddDocument(round * 100 + i, make_text(round, i), DocumentStatus::ACTUAL, {i});
+            }
+        }
+        
+        if (round > 0) {
+            for (int i = 0; i < 40; ++i) {
+                server.RemoveDocument((round - 1) * 100 + i);
+            }
+        }
+        
+        if (round == 10) {
+            server.WaitForMerges();
+            stats_after_warm_up = server.GetMemoryStats();
+        }
+    }
+    
+    // data kept by slot does not grow with the number of removed documents
+    server.WaitForMerges();
+    const SearchServer::MemoryStats stats = server.GetMemoryStats();
+    ASSERT(stats.document_data.GetTotalBytes() <= 2 * stats_after_warm_up.document_data.GetTotalBytes());
+    ASSERT(stats.removed_documents.GetTotalBytes() <= 2 * stats_after_warm_up.removed_documents.GetTotalBytes());
+    ASSERT(stats.inverted_index.GetTotalBytes() <= 2 * stats_after_warm_up.inverted_index.GetTotalBytes());
+    
+    // renumbered documents are found as in a server that has never removed any
+    SearchServer fresh_server;
+    for (int i = 0; i < 40; ++i) {
+        fresh_server.AddDocument(5900 + i, make_text(59, i), DocumentStatus::ACTUAL, {i});
+    }
+    
+    for (const auto& query : {"common"s, "word3 -tail1"s, "round59 word2"s, "round58"s}) {
+        const auto expected_docs = fresh_server.FindTopDocuments(query, DocumentStatus::ACTUAL, 40);
+        const auto docs = server.FindTopDocuments(query, DocumentStatus::ACTUAL, 40);
+        
+        ASSERT_EQUAL(docs.size(), expected_docs.size());
+        for (size_t i = 0; i < docs.size(); ++i) {
+            ASSERT_EQUAL(docs[i].id, expected_docs[i].id);
+            ASSERT(std::abs(docs[i].relevance - expected_docs[i].relevance) < kAccuracy);
+        }
+    }
+    
+    for (int i = 0; i < 40; ++i) {
+        ASSERT(ToMap(server.GetWordFrequencies(5900 + i)) == ToMap(fresh_server.GetWordFrequencies(5900 + i)));
+        ASSERT_EQUAL(std::get<0>(server.MatchDocument("common tail0"s, 5900 + i)).size(), i % 3 == 0 ? 2u : 1u);
+        ASSERT_EQUAL(server.GetDocumentText(5900 + i), i % 4 == 0 ? make_text(59, i) : ""s);
+    }
+    
+    ASSERT(server.GetWordFrequencies(5800).empty());
+    ASSERT_EQUAL(server.GetDocumentCount(), 40);
+}
+
+void TestSegmentedIndexMatchesSingleSegment() {
+    constexpr double kAccuracy = 1e-6;
+    
+    const std::vector<std::string> words = {"cat"s, "dog"s, "city"s, "funny"s, "grumpy"s, "tail"s, "hat"s, "potato"s};
+    
+    std::mt19937 generator(7);
+    
+    SearchServer single_segment_server;
+    SearchServer segmented_server;
+    
+    // small segments get sealed and merged while the documents are added
+    segmented_server.SetMaxMutableSegmentDocumentCount(8);
+    
+    for (int document_id = 0; document_id < 600; ++document_id) {
+        std::string document;
+        
+        const int word_count = 1 + static_cast<int>(generator() % 6);
+        for (int i = 0; i < word_count; ++i) {
+            document += words[std::min(generator() % words.size(), generator() % words.size())] + " "s;
+        }
+        
+        single_segment_server.AddDocument(document_id, document, DocumentStatus::ACTUAL, {document_id});
+        segmented_server.AddDocument(document_id, document, DocumentStatus::ACTUAL, {document_id});
+        
+        if (document_id % 5 == 0) {
+            single_segment_server.RemoveDocument(document_id / 2);
+            segmented_server.RemoveDocument(document_id / 2);
+        }
+    }
+    
+    ASSERT(segmented_server.GetSegmentCount() > 1);
+    
+    const int segment_count = segmented_server.GetSegmentCount();
+    segmented_server.WaitForMerges();
+    ASSERT(segmented_server.GetSegmentCount() <= segment_count);
+    
+    for (const auto query_mode : {SearchServer::QueryMode::EXHAUSTIVE, SearchServer::QueryMode::MAX_SCORE}) {
+        single_segment_server.SetQueryMode(query_mode);
+        segmented_server.SetQueryMode(query_mode);
+        
+        for (const auto& query : {"cat dog"s, "funny -cat"s, "grumpy tail hat"s, "potato city -dog -tail"s}) {
+            const auto expected_docs = single_segment_server.FindTopDocuments(query, DocumentStatus::ACTUAL, 20);
+            const auto docs = segmented_server.FindTopDocuments(query, DocumentStatus::ACTUAL, 20);
+            const auto parallel_docs = segmented_server.FindTopDocuments(std::execution::par, query, DocumentStatus::ACTUAL, 20);
+            
+            for (const auto& found_docs : {docs, parallel_docs}) {
+                ASSERT_EQUAL(found_docs.size(), expected_docs.size());
+                
+                for (size_t i = 0; i < found_docs.size(); ++i) {
+                    ASSERT_EQUAL(found_docs[i].id, expected_docs[i].id);
+                    ASSERT(std::abs(found_docs[i].relevance - expected_docs[i].relevance) < kAccuracy);
+                }
+            }
+        }
+    }
+    
+    for (const int document_id : single_segment_server) {
+        ASSERT(std::get<0>(segmented_server.MatchDocument("cat dog hat"s, document_id)) == std::get<0>(single_segment_server.MatchDocument("cat dog hat"s, document_id)));
+    }
+}
+
+void TestCompactionPurgesRemovedDocuments() {
+    using search_server_index::Segment;
+    
+    search_server_index::SlotBitmap removed_slots;
+    
+    Segment segment(0);
+    for (int slot = 0; slot < 300; ++slot) {
+        segment.AddDocument(slot, {{0, 1}, {slot % 3 + 1, 2}}, 1.0 / 3.0);
+        
+        if (slot % 3 == 0) {
+            removed_slots.Insert(slot);
+        }
+    }
+    
+    segment.Seal(removed_slots);
+    
+    ASSERT_EQUAL(segment.GetPurgedSlotCount(), 100);
+    ASSERT_EQUAL(segment.FindPostingList(0)->size(), 200u);
+    ASSERT(segment.FindPostingList(1) == nullptr);
+    
+    // slots removed after sealing are purged by compaction
+    for (int slot = 1; slot < 300; slot += 3) {
+        removed_slots.Insert(slot);
+    }
+    
+    ASSERT_EQUAL(removed_slots.Count(0, 300), 200u);
+    ASSERT_EQUAL(removed_slots.Count(64, 130), 44u);
+    
+    {
+        // long ranges are counted by blocks
+        search_server_index::SlotBitmap slots;
+        for (int slot = 0; slot < 20000; slot += 7) {
+            slots.Insert(slot);
+        }
+        
+        ASSERT_EQUAL(slots.Count(0, 20000), 2858u);
+        ASSERT_EQUAL(slots.Count(100, 13000), 1843u);
+        ASSERT_EQUAL(slots.Count(8192, 30000), 1687u);
+    }
+    
+    const Segment compacted = Segment::Merge({&segment}, removed_slots);
+    
+    ASSERT_EQUAL(compacted.GetPurgedSlotCount(), 200);
+    ASSERT_EQUAL(compacted.GetSlotCount(), 300);
+    ASSERT_EQUAL(compacted.FindPostingList(0)->size(), 100u);
+    ASSERT(compacted.FindPostingList(2) == nullptr);
+    ASSERT_EQUAL(compacted.FindPostingList(3)->size(), 100u);
+    
+    // removed documents are skipped by the queries before and after compaction
+    SearchServer search_server;
+    search_server.SetMaxMutableSegmentDocumentCount(16);
+    
+    for (int document_id = 0; document_id < 200; ++document_id) {
+        search_server.AddDocument(document_id, document_id % 2 == 0 ? "cat city"s : "dog city"s, DocumentStatus::ACTUAL, {document_id});
+    }
+    
+    for (int document_id = 0; document_id < 200; document_id += 2) {
+        search_server.RemoveDocument(document_id);
+    }
+    
+    ASSERT(search_server.FindTopDocuments("cat"s).empty());
+    
+    const auto found_docs = search_server.FindTopDocuments("dog"s, DocumentStatus::ACTUAL, 200);
+    ASSERT_EQUAL(found_docs.size(), 100u);
+    // all documents left contain dog
+    ASSERT(std::abs(found_docs[0].relevance) < 1e-6);
+    
+    search_server.CompactSegments();
+    
+    ASSERT(search_server.FindTopDocuments("cat"s).empty());
+    ASSERT_EQUAL(search_server.FindTopDocuments("dog -cat"s, DocumentStatus::ACTUAL, 200).size(), 100u);
+    
+    search_server.AddDocument(1000, "cat"s, DocumentStatus::ACTUAL, {1});
+    
+    ASSERT_EQUAL(search_server.FindTopDocuments("cat"s)[0].id, 1000);
+    ASSERT(std::abs(search_server.FindTopDocuments("cat"s)[0].relevance - std::log(101.0)) < 1e-6);
+}
+
+void TestAddDocumentsMatchesSequentialInsertion() {
+    constexpr double kAccuracy = 1e-6;
+    
+    const std::vector<std::string> words = {"cat"s, "dog"s, "city"s, "funny"s, "and"s, "grumpy"s, "tail"s, "hat"s, "potato"s, "curly"s};
+    
+    std::mt19937 generator(11);
+    
+    std::vector<std::string> texts;
+    for (int i = 0; i < 700; ++i) {
+        std::string text;
+        
+        const int word_count = static_cast<int>(generator() % 7);
+        for (int j = 0; j < word_count; ++j) {
+            text += words[std::min(generator() % words.size(), generator() % words.size())] + " "s;
+        }
+        
+        texts.push_back(text);
+    }
+    
+    SearchServer sequential_server("and"s);
+    SearchServer batch_server("and"s);
+    SearchServer parallel_batch_server("and"s);
+    
+    std::vector<SearchServer::NewDocument> first_batch;
+    std::vector<SearchServer::NewDocument> second_batch;
+    
+    for (int document_id = 0; document_id < static_cast<int>(texts.size()); ++document_id) {
+        const DocumentStatus status = document_id % 3 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+        
+        sequential_server.AddDocument(document_id, texts[document_id], status, {document_id});
+        
+        auto& batch = document_id < 300 ? first_batch : second_batch;
+        batch.push_back({document_id, texts[document_id], status, {document_id}});
+        
+        // the batch servers remove it between the batches
+        if (document_id == 300) {
+            sequential_server.RemoveDocument(5);
+        }
+    }
+    
+    for (auto* server : {&batch_server, &parallel_batch_server}) {
+        if (server == &batch_server) {
+            server->AddDocuments(first_batch);
+        } else {
+            server->AddDocuments(std::execution::par, first_batch);
+        }
+        
+        server->RemoveDocument(5);
+        server->AddDocument(second_batch.front().document_id, second_batch.front().text, second_batch.front().status, second_batch.front().ratings);
+        
+        const std::vector<SearchServer::NewDocument> rest(second_batch.begin() + 1, second_batch.end());
+        
+        if (server == &batch_server) {
+            server->AddDocuments(rest);
+        } else {
+            server->AddDocuments(std::execution::par, rest);
+        }
+    }
+    
+    for (const auto* server : {&batch_server, &parallel_batch_server}) {
+        ASSERT_EQUAL(server->GetDocumentCount(), sequential_server.GetDocumentCount());
+        ASSERT(std::equal(server->begin(), server->end(), sequential_server.begin(), sequential_server.end()));
+        
+        for (const int document_id : sequential_server) {
+            ASSERT(ToMap(server->GetWordFrequencies(document_id)) == ToMap(sequential_server.GetWordFrequencies(document_id)));
+            ASSERT(server->MatchDocument("cat hat -potato"s, document_id) == sequential_server.MatchDocument("cat hat -potato"s, document_id));
+        }
+        
+        for (const auto& query : {"cat dog"s, "funny -cat"s, "grumpy tail curly hat and"s}) {
+            for (const auto status : {DocumentStatus::ACTUAL, DocumentStatus::BANNED}) {
+                const auto expected_docs = sequential_server.FindTopDocuments(query, status, 30);
+                const auto docs = server->FindTopDocuments(query, status, 30);
+                
+                ASSERT_EQUAL(docs.size(), expected_docs.size());
+                
+                for (size_t i = 0; i < docs.size(); ++i) {
+                    ASSERT_EQUAL(docs[i].id, expected_docs[i].id);
+                    ASSERT_EQUAL(docs[i].rating, expected_docs[i].rating);
+                    ASSERT(std::abs(docs[i].relevance - expected_docs[i].relevance) < kAccuracy);
+                }
+            }
+        }
+    }
+    
+    // a batch with a bad document is not added at all
+    for (const auto& bad_document : {SearchServer::NewDocument{-1, "cat"sv, DocumentStatus::ACTUAL, {1}},
+                                     SearchServer::NewDocument{10, "cat"sv, DocumentStatus::ACTUAL, {1}},
+                                     SearchServer::NewDocument{1001, "ca\x12t"sv, DocumentStatus::ACTUAL, {1}}}) {
+        const std::vector<SearchServer::NewDocument> batch = {{1000, "cat"sv, DocumentStatus::ACTUAL, {1}}, bad_document};
+        
+        try {
+            batch_server.AddDocuments(std::execution::par, batch);
+            ASSERT_HINT(false, "bad document must be rejected"s);
+        } catch (const std::invalid_argument&) {
+        }
+        
+        ASSERT_EQUAL(batch_server.GetDocumentCount(), sequential_server.GetDocumentCount());
+    }
+}
+
+void TestConcurrentReadersDuringWrites() {
+    ConcurrentSearchServer search_server("and"s);
+    
+    std::atomic<bool> is_writing = true;
+    
+    // every version has one document with "cat" for every document with "dog" and the readers must not see a version in between
+    const auto read = [&]() {
+        while (is_writing) {
+            search_server.Read([](const SearchServer& server) {
+                const auto cats = server.FindTopDocuments("cat"s, DocumentStatus::ACTUAL, 10000);
+                const auto dogs = server.FindTopDocuments("dog"s, DocumentStatus::ACTUAL, 10000);
+                
+                ASSERT_EQUAL(cats.size(), dogs.size());
+                ASSERT_EQUAL(static_cast<int>(cats.size() + dogs.size()), server.GetDocumentCount());
+                return true;
+            });
+            
+            const auto results = ProcessQueries(search_server, {"cat"s, "dog"s, "cat and dog"s});
+            ASSERT_EQUAL(results.size(), 3u);
+        }
+    };
+    
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 3; ++i) {
+        readers.emplace_back(read);
+    }
+    
+    for (int document_id = 0; document_id < 400; document_id += 2) {
+        search_server.AddDocuments({{document_id, "funny cat"sv, DocumentStatus::ACTUAL, {1}},
+                                    {document_id + 1, "grumpy dog"sv, DocumentStatus::ACTUAL, {1}}});
+        
+        if (document_id % 10 == 0) {
+            search_server.AddDocuments({{1000 + document_id, "old cat"sv, DocumentStatus::ACTUAL, {1}},
+                                        {1001 + document_id, "old dog"sv, DocumentStatus::ACTUAL, {1}}});
+        }
+    }
+    
+    search_server.CompactSegments();
+    
+    is_writing = false;
+    
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    
+    ASSERT_EQUAL(search_server.GetDocumentCount(), 480);
+    ASSERT_EQUAL(search_server.FindTopDocuments("cat"s).size(), 5u);
+    ASSERT_EQUAL(std::get<0>(search_server.MatchDocument("funny cat"s, 0)).size(), 2u);
+    
+    search_server.RemoveDocument(0);
+    
+    ASSERT_EQUAL(search_server.GetDocumentCount(), 479);
+    
+    try {
+        search_server.AddDocument(1, "cat"s, DocumentStatus::ACTUAL, {1});
+        ASSERT_HINT(false, "repeating id must be rejected"s);
+    } catch (const std::invalid_argument&) {
+    }
+    
+    ASSERT_EQUAL(search_server.GetDocumentCount(), 479);
+}
+
+void TestShardedSearchServerMatchesSingleServer() {
+    constexpr double kAccuracy = 1e-9;
+    
+    const std::vector<std::string> words = {"cat"s, "dog"s, "city"s, "funny"s, "and"s, "grumpy"s, "tail"s, "hat"s, "potato"s, "curly"s};
+    
+    std::mt19937 generator(5);
+    
+    SearchServer single_server("and"s);
+    ShardedSearchServer sharded_server(4, "and"sv);
+    
+    std::vector<SearchServer::NewDocument> batch;
+    std::vector<std::string> texts;
+    texts.reserve(800);
+    
+    for (int document_id = 0; document_id < 800; ++document_id) {
+        std::string text;
+        
+        const int word_count = 1 + static_cast<int>(generator() % 6);
+        for (int i = 0; i < word_count; ++i) {
+            text += words[std::min(generator() % words.size(), generator() % words.size())] + " "s;
+        }
+        
+        texts.push_back(text);
+        
+        const DocumentStatus status = document_id % 4 == 0 ? DocumentStatus::IRRELEVANT : DocumentStatus::ACTUAL;
+        
+        single_server.AddDocument(document_id, texts.back(), status, {document_id});
+        
+        if (document_id < 500) {
+            sharded_server.AddDocument(document_id, texts.back(), status, {document_id});
+        } else {
+            batch.push_back({document_id, texts.back(), status, {document_id}});
+        }
+    }
+    
+    sharded_server.AddDocuments(batch);
+    
+    // a rejected batch is added by none of the shards
+    const auto make_batch = [](int last_document_id, std::string_view last_text) {
+        return std::vector<SearchServer::NewDocument>{
+            {1000, "cat"sv, DocumentStatus::ACTUAL, {1}},
+            {1001, "dog"sv, DocumentStatus::ACTUAL, {1}},
+            {1002, "tail"sv, DocumentStatus::ACTUAL, {1}},
+            {last_document_id, last_text, DocumentStatus::ACTUAL, {1}},
+        };
+    };
+    
+    // bad text, repeating id in the batch, id of an added document, negative id
+    const std::vector<std::vector<SearchServer::NewDocument>> rejected_batches = {
+        make_batch(1003, "bad\x01word"sv), make_batch(1000, "hat"sv), make_batch(799, "hat"sv), make_batch(-1, "hat"sv),
+    };
+    
+    for (const auto& rejected_batch : rejected_batches) {
+        try {
+            sharded_server.AddDocuments(rejected_batch);
+            ASSERT_HINT(false, "bad batch must be rejected"s);
+        } catch (const std::invalid_argument&) {
+        }
+        
+        ASSERT_EQUAL(sharded_server.GetDocumentCount(), 800);
+    }
+    
+    for (int document_id = 0; document_id < 800; document_id += 9) {
+        single_server.RemoveDocument(document_id);
+        sharded_server.RemoveDocument(document_id);
+    }
+    
+    ASSERT_EQUAL(sharded_server.GetDocumentCount(), single_server.GetDocumentCount());
+    
+    const auto odd_ids = [](int document_id, DocumentStatus, int) {
+        return document_id % 2 == 1;
+    };
+    
+    for (const auto query_mode : {SearchServer::QueryMode::EXHAUSTIVE, SearchServer::QueryMode::MAX_SCORE}) {
+        single_server.SetQueryMode(query_mode);
+        sharded_server.SetQueryMode(query_mode);
+        
+        for (const auto& query : {"cat dog"s, "funny -cat"s, "grumpy tail curly hat and"s, "potato city -dog -tail"s}) {
+            for (const int max_result_document_count : {1, 5, 40}) {
+                const auto check = [&](const std::vector<Document>& docs, const std::vector<Document>& expected_docs) {
+                    ASSERT_EQUAL(docs.size(), expected_docs.size());
+                    
+                    for (size_t i = 0; i < docs.size(); ++i) {
+                        ASSERT_EQUAL(docs[i].id, expected_docs[i].id);
+                        ASSERT(std::abs(docs[i].relevance - expected_docs[i].relevance) < kAccuracy);
+                    }
+                };
+                
+                check(sharded_server.FindTopDocuments(query, DocumentStatus::ACTUAL, max_result_document_count),
+                      single_server.FindTopDocuments(query, DocumentStatus::ACTUAL, max_result_document_count));
+                check(sharded_server.FindTopDocuments(query, odd_ids, max_result_document_count),
+                      single_server.FindTopDocuments(query, odd_ids, max_result_document_count));
+            }
+        }
+    }
+    
+    ASSERT(sharded_server.MatchDocument("cat dog -hat"s, 1) == single_server.MatchDocument("cat dog -hat"s, 1));
+    
+    try {
+        sharded_server.FindTopDocuments("cat --dog"s);
+        ASSERT_HINT(false, "bad query must be rejected"s);
+    } catch (const std::invalid_argument&) {
+    }
+}
+
+void TestRemoteShardedSearchServerMatchesSingleServer() {
+    constexpr double kAccuracy = 1e-9;
+    constexpr int kShardCount = 3;
+    
+    const std::vector<std::string> words = {"cat"s, "dog"s, "city"s, "funny"s, "and"s, "grumpy"s, "tail"s, "hat"s, "potato"s, "curly"s};
+    
+    // shards run on threads of the test, a shard process serves its socket the same way
+    std::vector<std::unique_ptr<ShardSocketServer>> shard_servers;
+    std::vector<std::thread> shard_threads;
+    std::vector<std::string> socket_paths;
+    
+    for (int i = 0; i < kShardCount; ++i) {
+        socket_paths.push_back("/tmp/search_server_test_"s + std::to_string(getpid()) + "_"s + std::to_string(i) + ".sock"s);
+        shard_servers.push_back(std::make_unique<ShardSocketServer>(socket_paths.back(), "and"sv));
+        shard_threads.emplace_back(&ShardSocketServer::Serve, shard_servers.back().get());
+    }
+    
+    {
+        std::mt19937 generator(7);
+        
+        SearchServer single_server("and"s);
+        RemoteShardedSearchServer remote_server(socket_paths);
+        
+        ASSERT_EQUAL(remote_server.GetShardCount(), kShardCount);
+        
+        std::vector<SearchServer::NewDocument> batch;
+        std::vector<std::string> texts;
+        texts.reserve(600);
+        
+        for (int document_id = 0; document_id < 600; ++document_id) {
+            std::string text;
+            
+            const int word_count = 1 + static_cast<int>(generator() % 6);
+            for (int i = 0; i < word_count; ++i) {
+                text += words[std::min(generator() % words.size(), generator() % words.size())] + " "s;
+            }
+            
+            texts.push_back(text);
+            
+            const DocumentStatus status = document_id % 4 == 0 ? DocumentStatus::IRRELEVANT : DocumentStatus::ACTUAL;
+            
+            single_server.AddDocument(document_id, texts.back(), status, {document_id, -1});
+            
+            if (document_id < 300) {
+                ASSERT(remote_server.AddDocument(document_id, texts.back(), status, {document_id, -1}));
+            } else {
+                batch.push_back({document_id, texts.back(), status, {document_id, -1}});
+            }
+        }
+        
+        remote_server.AddDocuments(batch);
+        
+        for (int document_id = 0; document_id < 600; document_id += 7) {
+            single_server.RemoveDocument(document_id);
+            remote_server.RemoveDocument(document_id);
+        }
+        
+        ASSERT_EQUAL(remote_server.GetDocumentCount(), single_server.GetDocumentCount());
+        
+        for (const auto& query : {"cat dog"s, "funny -cat"s, "grumpy tail curly hat and"s, "potato city -dog -tail"s, "nothing"s}) {
+            for (const auto status : {DocumentStatus::ACTUAL, DocumentStatus::IRRELEVANT}) {
+                for (const int max_result_document_count : {1, 5, 40}) {
+                    const std::vector<Document> docs = remote_server.FindTopDocuments(query, status, max_result_document_count);
+                    const std::vector<Document> expected_docs = single_server.FindTopDocuments(query, status, max_result_document_count);
+                    
+                    ASSERT_EQUAL(docs.size(), expected_docs.size());
+                    
+                    for (size_t i = 0; i < docs.size(); ++i) {
+                        ASSERT_EQUAL(docs[i].id, expected_docs[i].id);
+                        ASSERT_EQUAL(docs[i].rating, expected_docs[i].rating);
+                        ASSERT(std::abs(docs[i].relevance - expected_docs[i].relevance) < kAccuracy);
+                    }
+                }
+            }
+        }
+        
+        const auto [matched_words, matched_status] = remote_server.MatchDocument("cat dog -hat"s, 1);
+        const auto [expected_words, expected_status] = single_server.MatchDocument("cat dog -hat"s, 1);
+        
+        ASSERT_EQUAL(matched_words.size(), expected_words.size());
+        ASSERT(std::equal(matched_words.begin(), matched_words.end(), expected_words.begin()));
+        ASSERT(matched_status == expected_status);
+        
+        // errors of the shards come back as the exceptions of SearchServer
+        try {
+            remote_server.FindTopDocuments("cat --dog"s);
+            ASSERT_HINT(false, "bad query must be rejected"s);
+        } catch (const std::invalid_argument&) {
+        }
+        
+        try {
+            remote_server.MatchDocument("cat"s, 0);
+            ASSERT_HINT(false, "removed document must not be found"s);
+        } catch (const std::out_of_range&) {
+        }
+        
+        try {
+            remote_server.AddDocument(1, "cat"s, DocumentStatus::ACTUAL, {1});
+            ASSERT_HINT(false, "repeating id must be rejected"s);
+        } catch (const std::invalid_argument&) {
+        }
+        
+        // a rejected batch is not added by any shard: bad text, repeating id in the batch, id of an added document
+        const int document_count = remote_server.GetDocumentCount();
+        
+        for (const int last_document_id : {601, 600, 1}) {
+            try {
+                remote_server.AddDocuments({{600, "cat"sv, DocumentStatus::ACTUAL, {1}}, {602, "dog"sv, DocumentStatus::ACTUAL, {1}},
+                                            {last_document_id, last_document_id == 601 ? "ca\x12t"sv : "hat"sv, DocumentStatus::ACTUAL, {1}}});
+                ASSERT_HINT(false, "bad batch must be rejected"s);
+            } catch (const std::invalid_argument&) {
+            }
+            
+            ASSERT_EQUAL(remote_server.GetDocumentCount(), document_count);
+        }
+    }
+    
+    for (int i = 0; i < kShardCount; ++i) {
+        shard_servers[i]->Stop();
+        shard_threads[i].join();
+    }
+}
+
+void TestShardProcessServesRemoteServer() {
+    const std::string socket_path = "/tmp/search_server_test_"s + std::to_string(getpid()) + "_process.sock"s;
+    
+    // the shard is this binary started in its shard mode
+    const pid_t shard_pid = fork();
+    ASSERT(shard_pid >= 0);
+    
+    if (shard_pid == 0) {
+        execl("/proc/self/exe", "search_server", "--shard", socket_path.c_str(), "and", static_cast<char*>(nullptr));
+        _exit(127);
+    }
+    
+    std::unique_ptr<RemoteShardedSearchServer> remote_server;
+    
+    // the shard is ready once it accepts connections
+    for (int attempt = 0; attempt < 200 && !remote_server; ++attempt) {
+        try {
+            remote_server = std::make_unique<RemoteShardedSearchServer>(std::vector<std::string>{socket_path});
+        } catch (const std::runtime_error&) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(25));
+        }
+    }
+    
+    ASSERT_HINT(remote_server != nullptr, "shard process does not listen"s);
+    
+    SearchServer single_server("and"s);
+    
+    const std::vector<std::string> texts = {"funny cat and dog"s, "grumpy cat"s, "curly dog in the hat"s, "cat and cat"s};
+    for (int document_id = 0; document_id < static_cast<int>(texts.size()); ++document_id) {
+        single_server.AddDocument(document_id, texts[document_id], DocumentStatus::ACTUAL, {document_id});
+        remote_server->AddDocument(document_id, texts[document_id], DocumentStatus::ACTUAL, {document_id});
+    }
+    
+    ASSERT_EQUAL(remote_server->GetDocumentCount(), 4);
+    
+    const std::vector<Document> docs = remote_server->FindTopDocuments("cat -hat"s);
+    const std::vector<Document> expected_docs = single_server.FindTopDocuments("cat -hat"s);
+    
+    ASSERT_EQUAL(docs.size(), expected_docs.size());
+    for (size_t i = 0; i < docs.size(); ++i) {
+        ASSERT_EQUAL(docs[i].id, expected_docs[i].id);
+        ASSERT(std::abs(docs[i].relevance - expected_docs[i].relevance) < 1e-9);
+    }
+    
+    // the shard stops on SIGTERM and removes its socket file
+    ASSERT_EQUAL(kill(shard_pid, SIGTERM), 0);
+    
+    int status = 0;
+    ASSERT_EQUAL(waitpid(shard_pid, &status, 0), shard_pid);
+    ASSERT(WIFEXITED(status));
+    ASSERT_EQUAL(WEXITSTATUS(status), 0);
+    ASSERT(access(socket_path.c_str(), F_OK) != 0);
+    
+    // the client does not reconnect, the broken connection fails every call
+    for (int i = 0; i < 2; ++i) {
+        try {
+            remote_server->GetDocumentCount();
+            ASSERT_HINT(false, "stopped shard must be reported"s);
+        } catch (const std::runtime_error&) {
+        }
+    }
+}
+
+void TestSnapshotRoundTrip() {
+    const std::vector<std::string> words = {"cat"s, "dog"s, "city"s, "funny"s, "and"s, "grumpy"s, "tail"s, "hat"s, "potato"s, "curly"s};
+    
+    std::mt19937 generator(11);
+    
+    const auto make_text = [&]() {
+        std::string text;
+        
+        const int word_count = 1 + static_cast<int>(generator() % 8);
+        for (int i = 0; i < word_count; ++i) {
+            text += words[std::min(generator() % words.size(), generator() % words.size())] + " "s;
+        }
+        
+        return text;
+    };
+    
+    SearchServer server("and"s);
+    server.SetMaxMutableSegmentDocumentCount(100);
+    server.SetQueryMode(SearchServer::QueryMode::MAX_SCORE);
+    
+    // segments of different sizes, removed documents purged and not purged, the mutable segment is not empty
+    for (int document_id = 0; document_id < 1550; ++document_id) {
+        server.AddDocument(document_id, make_text(), document_id % 5 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL, {document_id, 3});
+        
+        if (document_id % 7 == 0) {
+            server.RemoveDocument(document_id / 2);
+        }
+    }
+    
+    server.WaitForMerges();
+    
+    const std::string path = "/tmp/search_server_test_"s + std::to_string(getpid()) + ".snapshot"s;
+    server.SaveSnapshot(path);
+    
+    SearchServer loaded_server = SearchServer::LoadSnapshot(path);
+    
+    const auto check = [](const SearchServer& server, const SearchServer& loaded_server) {
+        ASSERT_EQUAL(loaded_server.GetDocumentCount(), server.GetDocumentCount());
+        ASSERT(loaded_server.GetQueryMode() == server.GetQueryMode());
+        ASSERT(std::equal(loaded_server.begin(), loaded_server.end(), server.begin(), server.end()));
+        
+        for (const auto& query : {"cat dog"s, "funny -cat"s, "grumpy tail curly hat and"s, "potato city -dog -tail"s, "new"s}) {
+            for (const auto status : {DocumentStatus::ACTUAL, DocumentStatus::BANNED}) {
+                const std::vector<Document> docs = loaded_server.FindTopDocuments(query, status, 30);
+                const std::vector<Document> expected_docs = server.FindTopDocuments(query, status, 30);
+                
+                ASSERT_EQUAL(docs.size(), expected_docs.size());
+                
+                for (size_t i = 0; i < docs.size(); ++i) {
+                    ASSERT_EQUAL(docs[i].id, expected_docs[i].id);
+                    ASSERT_EQUAL(docs[i].rating, expected_docs[i].rating);
+                    ASSERT_EQUAL(docs[i].relevance, expected_docs[i].relevance);
+                }
+            }
+        }
+        
+        for (const int document_id : server) {
+            ASSERT(loaded_server.MatchDocument("cat dog hat new"s, document_id) == server.MatchDocument("cat dog hat new"s, document_id));
+            ASSERT(ToMap(loaded_server.GetWordFrequencies(document_id)) == ToMap(server.GetWordFrequencies(document_id)));
+        }
+    };
+    
+    check(server, loaded_server);
+    
+    // the loaded server goes on as the saved one
+    for (int document_id = 1550; document_id < 1700; ++document_id) {
+        const std::string text = make_text() + (document_id % 3 == 0 ? "new"s : ""s);
+        
+        server.AddDocument(document_id, text, DocumentStatus::ACTUAL, {document_id});
+        loaded_server.AddDocument(document_id, text, DocumentStatus::ACTUAL, {document_id});
+        
+        server.RemoveDocument(document_id - 1000);
+        loaded_server.RemoveDocument(document_id - 1000);
+    }
+    
+    server.CompactSegments();
+    loaded_server.CompactSegments();
+    
+    check(server, loaded_server);
+    
+    // the mapping outlives the file name
+    std::remove(path.c_str());
+    check(server, loaded_server);
+    
+    try {
+        SearchServer::LoadSnapshot(path);
+        ASSERT_HINT(false, "missing snapshot must be rejected"s);
+    } catch (const std::runtime_error&) {
+    }
+    
+    {
+        std::ofstream output(path, std::ios::binary);
+        output << "not a snapshot"s;
+    }
+    
+    try {
+        SearchServer::LoadSnapshot(path);
+        ASSERT_HINT(false, "corrupted snapshot must be rejected"s);
+    } catch (const std::runtime_error&) {
+    }
+    
+    // the count of terms follows the header and the empty list of stop words, a count of 2^64 - 1 must not wrap
+    SearchServer(""s).SaveSnapshot(path);
+    {
+        std::fstream output(path, std::ios::binary | std::ios::in | std::ios::out);
+        output.seekp(sizeof(search_server_index::SnapshotHeader) + sizeof(uint64_t));
+        
+        const uint64_t term_count = std::numeric_limits<uint64_t>::max();
+        output.write(reinterpret_cast<const char*>(&term_count), sizeof(term_count));
+    }
+    
+    try {
+        SearchServer::LoadSnapshot(path);
+        ASSERT_HINT(false, "snapshot with a wrapping count must be rejected"s);
+    } catch (const std::runtime_error&) {
+    }
+    
+    std::remove(path.c_str());
+}
+
+void TestCorruptedSnapshotIsRejectedOrSafe() {
+    SearchServer server("and"s);
+    server.SetMaxMutableSegmentDocumentCount(300);
+    
+    for (int document_id = 0; document_id < 1000; ++document_id) {
+        server.AddDocument(document_id, "cat number"s + std::to_string(document_id % 10) + (document_id % 3 == 0 ? " dog"s : " hat"s),
+                           DocumentStatus::ACTUAL, {document_id});
+    }
+    for (int document_id = 0; document_id < 1000; document_id += 9) {
+        server.RemoveDocument(document_id);
+    }
+    
+    server.WaitForMerges();
+    
+    const std::string path = "/tmp/search_server_test_"s + std::to_string(getpid()) + "_corrupted.snapshot"s;
+    server.SaveSnapshot(path);
+    
+    std::string snapshot;
+    {
+        std::ifstream input(path, std::ios::binary);
+        snapshot.assign(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+    }
+    
+    // a flipped bit is either reported as corruption or leaves a server that answers queries without reading
+    // out of its arrays, the sanitizers of the test build catch the rest
+    for (size_t position = sizeof(search_server_index::SnapshotHeader); position < snapshot.size(); position += 7) {
+        std::string corrupted_snapshot = snapshot;
+        corrupted_snapshot[position] = static_cast<char>(corrupted_snapshot[position] ^ (1 << position % 8));
+        
+        {
+            std::ofstream output(path, std::ios::binary | std::ios::trunc);
+            output << corrupted_snapshot;
+        }
+        
+        try {
+            const SearchServer loaded_server = SearchServer::LoadSnapshot(path);
+            
+            for (const auto& query : {"cat"s, "dog -hat"s, "number3 number7 cat"s}) {
+                loaded_server.FindTopDocuments(query);
+                loaded_server.FindTopDocuments(std::execution::par, query, DocumentStatus::ACTUAL);
+            }
+        } catch (const std::exception&) {
+        }
+    }
+    
+    std::remove(path.c_str());
+}
+
+void TestDurableSearchServerRecoversChanges() {
+    const std::vector<std::string> words = {"cat"s, "dog"s, "city"s, "funny"s, "and"s, "grumpy"s, "tail"s, "hat"s, "potato"s, "curly"s};
+    
+    std::mt19937 generator(13);
+    
+    std::vector<std::string> texts;
+    for (int document_id = 0; document_id < 400; ++document_id) {
+        std::string text;
+        
+        const int word_count = 1 + static_cast<int>(generator() % 6);
+        for (int i = 0; i < word_count; ++i) {
+            text += words[std::min(generator() % words.size(), generator() % words.size())] + " "s;
+        }
+        
+        texts.push_back(text);
+    }
+    
+    const std::string path = "/tmp/search_server_test_"s + std::to_string(getpid()) + ".wal"s;
+    std::remove(path.c_str());
+    
+    SearchServer expected_server("and"s);
+    
+    const auto check = [&expected_server](const DurableSearchServer& server) {
+        ASSERT_EQUAL(server.GetDocumentCount(), expected_server.GetDocumentCount());
+        
+        for (const auto& query : {"cat dog"s, "funny -cat"s, "grumpy tail curly hat and"s, "potato city -dog -tail"s}) {
+            const std::vector<Document> docs = server.Read([&query](const SearchServer& server) {
+                return server.FindTopDocuments(query, DocumentStatus::ACTUAL, 50);
+            });
+            const std::vector<Document> expected_docs = expected_server.FindTopDocuments(query, DocumentStatus::ACTUAL, 50);
+            
+            ASSERT_EQUAL(docs.size(), expected_docs.size());
+            
+            for (size_t i = 0; i < docs.size(); ++i) {
+                ASSERT_EQUAL(docs[i].id, expected_docs[i].id);
+                ASSERT_EQUAL(docs[i].relevance, expected_docs[i].relevance);
+            }
+        }
+    };
+    
+    {
+        DurableSearchServer server(path, "and"sv);
+        
+        // concurrent writers share the syncs of the log
+        std::vector<std::thread> writers;
+        for (int writer = 0; writer < 4; ++writer) {
+            writers.emplace_back([&server, &texts, writer]() {
+                for (int document_id = writer; document_id < 300; document_id += 4) {
+                    server.AddDocument(document_id, texts[document_id], DocumentStatus::ACTUAL, {document_id});
+                    
+                    if (document_id % 10 == 0) {
+                        server.RemoveDocument(document_id);
+                    }
+                }
+            });
+        }
+        
+        for (std::thread& writer : writers) {
+            writer.join();
+        }
+        
+        std::vector<SearchServer::NewDocument> batch;
+        for (int document_id = 300; document_id < 400; ++document_id) {
+            batch.push_back({document_id, texts[document_id], DocumentStatus::ACTUAL, {document_id}});
+        }
+        
+        server.AddDocuments(batch);
+        
+        // removed document comes back
+        server.AddDocument(20, texts[20], DocumentStatus::ACTUAL, {20});
+        
+        // rejected changes are checked before they are logged, so the log does not grow
+        const auto get_log_size = [&path]() {
+            return std::ifstream(path, std::ios::binary | std::ios::ate).tellg();
+        };
+        const auto log_size = get_log_size();
+        
+        try {
+            server.AddDocument(21, "cat"s, DocumentStatus::ACTUAL, {1});
+            ASSERT_HINT(false, "repeating id must be rejected"s);
+        } catch (const std::invalid_argument&) {
+        }
+        
+        try {
+            server.AddDocument(500, "ca\x12t"s, DocumentStatus::ACTUAL, {1});
+            ASSERT_HINT(false, "document with special symbols must be rejected"s);
+        } catch (const std::invalid_argument&) {
+        }
+        
+        try {
+            server.AddDocuments({{500, "cat"sv, DocumentStatus::ACTUAL, {1}}, {500, "dog"sv, DocumentStatus::ACTUAL, {1}}});
+            ASSERT_HINT(false, "repeating ids in a batch must be rejected"s);
+        } catch (const std::invalid_argument&) {
+        }
+        
+        ASSERT_EQUAL(get_log_size(), log_size);
+        ASSERT(!server.IsFailed());
+        
+        for (int document_id = 0; document_id < 400; ++document_id) {
+            if (document_id >= 300 || document_id % 10 != 0 || document_id == 20) {
+                expected_server.AddDocument(document_id, texts[document_id], DocumentStatus::ACTUAL, {document_id});
+            }
+        }
+        
+        check(server);
+    }
+    
+    {
+        DurableSearchServer server(path, "and"sv);
+        check(server);
+    }
+    
+    // a crash in the middle of a write leaves a torn record
+    {
+        std::ofstream output(path, std::ios::binary | std::ios::app);
+        output << "\x30\x00\x00\x00torn"s;
+    }
+    
+    {
+        DurableSearchServer server(path, "and"sv);
+        check(server);
+        
+        server.RemoveDocument(1);
+        expected_server.RemoveDocument(1);
+    }
+    
+    {
+        DurableSearchServer server(path, "and"sv);
+        check(server);
+    }
+    
+    // a checkpoint replaces the log by a snapshot, changes after it go to the new log
+    const auto get_file_size = [](const std::string& file_path) {
+        return std::ifstream(file_path, std::ios::binary | std::ios::ate).tellg();
+    };
+    const auto log_size = get_file_size(path);
+    
+    {
+        DurableSearchServer server(path, "and"sv);
+        server.Checkpoint();
+        ASSERT(get_file_size(path) < log_size / 10);
+        ASSERT(get_file_size(path + ".snapshot.1"s) > 0);
+        check(server);
+        
+        server.RemoveDocument(2);
+        expected_server.RemoveDocument(2);
+        server.AddDocument(1, texts[1], DocumentStatus::ACTUAL, {1});
+        expected_server.AddDocument(1, texts[1], DocumentStatus::ACTUAL, {1});
+    }
+    
+    {
+        DurableSearchServer server(path, "and"sv);
+        check(server);
+        
+        server.Checkpoint();
+        ASSERT(std::ifstream(path + ".snapshot.1"s).fail());
+        
+        server.RemoveDocument(3);
+        expected_server.RemoveDocument(3);
+    }
+    
+    // a crash after the snapshot is saved but before the log is replaced leaves the next snapshot unused
+    {
+        std::ofstream output(path + ".snapshot.3"s, std::ios::binary);
+        output << "unused"s;
+    }
+    
+    {
+        DurableSearchServer server(path, "and"sv);
+        check(server);
+        ASSERT(std::ifstream(path + ".snapshot.3"s).fail());
+    }
+    
+    std::remove(path.c_str());
+    std::remove((path + ".snapshot.2"s).c_str());
+}
+
+void TestKeptDocumentTextsAreReturned() {
+    SearchServer server("and"s);
+    
+    std::string text = "funny cat and a long enough text to be kept on the heap"s;
+    const char* text_data = text.data();
+    
+    server.AddDocumentKeepingText(1, std::move(text), DocumentStatus::ACTUAL, {1});
+    
+    // the buffer is moved into the server, not copied
+    ASSERT_EQUAL(server.GetDocumentText(1), "funny cat and a long enough text to be kept on the heap"sv);
+    ASSERT_EQUAL(server.GetDocumentText(1).data(), text_data);
+    
+    // new words are not copied either, the dictionary refers to them in the buffer
+    ASSERT_EQUAL(std::get<0>(server.MatchDocument("funny"s, 1)).at(0).data(), text_data);
+    
+    const auto owner = std::make_shared<const std::string>("grumpy dog in the city"s);
+    server.AddDocumentKeepingText(2, *owner, owner, DocumentStatus::ACTUAL, {2});
+    ASSERT_EQUAL(server.GetDocumentText(2).data(), owner->data());
+    
+    // the document and its new words "grumpy", "dog", "in" and "city" keep the owner
+    ASSERT_EQUAL(owner.use_count(), 6);
+    
+    server.AddDocument(3, "cat in the hat"s, DocumentStatus::ACTUAL, {3});
+    ASSERT(server.GetDocumentText(3).empty());
+    ASSERT(server.GetDocumentText(4).empty());
+    
+    const auto batch_owner = std::make_shared<const std::string>("dog with a hat lonely cat"s);
+    const std::string_view batch = *batch_owner;
+    server.AddDocumentsKeepingTexts(std::execution::par, {{4, batch.substr(0, 14), DocumentStatus::ACTUAL, {4}}, {5, batch.substr(15), DocumentStatus::ACTUAL, {5}}}, batch_owner);
+    ASSERT_EQUAL(server.GetDocumentText(4), "dog with a hat"sv);
+    ASSERT_EQUAL(server.GetDocumentText(5).data(), batch_owner->data() + 15);
+    
+    ASSERT_EQUAL(server.FindTopDocuments("funny"s).size(), 1u);
+    ASSERT_EQUAL(server.FindTopDocuments("dog"s).size(), 2u);
+    
+    // texts are saved with the snapshot and stay in the mapped file
+    const std::string path = "/tmp/search_server_test_"s + std::to_string(getpid()) + ".snapshot"s;
+    server.SaveSnapshot(path);
+    
+    SearchServer loaded_server = SearchServer::LoadSnapshot(path);
+    std::remove(path.c_str());
+    
+    size_t text_bytes = 0;
+    for (const int document_id : server) {
+        ASSERT_EQUAL(loaded_server.GetDocumentText(document_id), server.GetDocumentText(document_id));
+        text_bytes += server.GetDocumentText(document_id).size();
+    }
+    
+    // texts of the loaded server are not on the heap
+    ASSERT_EQUAL(server.GetMemoryStats().document_texts.payload_bytes - loaded_server.GetMemoryStats().document_texts.payload_bytes, text_bytes);
+    
+    // the server lets the owner go with the document and its words
+    server.RemoveDocument(2);
+    server.RemoveDocument(4);
+    server.RemoveDocument(5);
+    ASSERT_EQUAL(batch_owner.use_count(), 1);
+    ASSERT(server.GetDocumentText(2).empty());
+    
+    // word "in" of document 3 is still in the buffer of document 2
+    ASSERT_EQUAL(owner.use_count(), 2);
+    ASSERT_EQUAL(std::get<0>(server.MatchDocument("in"s, 3)).at(0).data(), owner->data() + 11);
+    
+    server.RemoveDocument(3);
+    ASSERT_EQUAL(owner.use_count(), 1);
+    
+    ConcurrentSearchServer concurrent_server("and"s);
+    concurrent_server.AddDocumentKeepingText(1, "funny cat"s, DocumentStatus::ACTUAL, {1});
+    
+    ASSERT_EQUAL(concurrent_server.Read([](const SearchServer& server) {
+        return std::string(server.GetDocumentText(1));
+    }), "funny cat"s);
+}
+
+void TestWordFrequenciesStayBoundedUnderChurn() {
+    SearchServer server;
+    server.SetMaxMutableSegmentDocumentCount(1000);
+    
+    const auto make_text = [](int document_id) {
+        std::string text;
+        for (int i = 0; i < 60; ++i) {
+            text += "word"s + std::to_string((document_id * 7 + i) % 500) + " "s;
+        }
+        
+        return text;
+    };
+    
+    // 100 documents are kept, every new document replaces the oldest one
+    for (int document_id = 0; document_id < 100; ++document_id) {
+        server.AddDocument(document_id, make_text(document_id), DocumentStatus::ACTUAL, {1});
+    }
+    
+    const size_t live_entry_bytes = server.GetMemoryStats().word_frequencies.payload_bytes;
+    ASSERT_EQUAL(live_entry_bytes, 100 * 60 * sizeof(search_server_index::TermCount));
+    
+    for (int document_id = 100; document_id < 3000; ++document_id) {
+        server.AddDocument(document_id, make_text(document_id), DocumentStatus::ACTUAL, {1});
+        server.RemoveDocument(document_id - 100);
+        
+        // entries of the removed documents are dropped long before the slots are given back
+        const search_server_index::MemoryUsage usage = server.GetMemoryStats().word_frequencies;
+        ASSERT_EQUAL(usage.payload_bytes, live_entry_bytes);
+        ASSERT_HINT(usage.GetTotalBytes() <= 4 * live_entry_bytes, "forward index grows with the removed documents"s);
+    }
+    
+    ASSERT_EQUAL(server.GetWordFrequencies(2999).size(), 60u);
+    ASSERT_EQUAL(server.GetWordFrequencies(2899).size(), 0u);
+}
+
+void TestMemoryStatsFollowChanges() {
+    SearchServer server("and a very-long-stop-word-kept-on-the-heap"s);
+    
+    const SearchServer::MemoryStats empty_stats = server.GetMemoryStats();
+    
+    ASSERT(empty_stats.stop_words.payload_bytes > 0);
+    ASSERT_EQUAL(empty_stats.word_storage_words.GetTotalBytes(), 0u);
+    ASSERT_EQUAL(empty_stats.word_frequencies.GetTotalBytes(), 0u);
+    ASSERT_EQUAL(empty_stats.mapped_snapshot_bytes, 0u);
+    
+    server.SetMaxMutableSegmentDocumentCount(100);
+    
+    for (int document_id = 0; document_id < 1000; ++document_id) {
+        server.AddDocument(document_id, "cat and dog number"s + std::to_string(document_id % 300) + " in the city"s, DocumentStatus::ACTUAL, {1});
+    }
+    
+    server.WaitForMerges();
+    
+    const SearchServer::MemoryStats stats = server.GetMemoryStats();
+    
+    ASSERT_EQUAL(stats.stop_words.GetTotalBytes(), empty_stats.stop_words.GetTotalBytes());
+    
+    // 300 numbered words and 5 others
+    ASSERT_EQUAL(stats.word_storage_views.payload_bytes, 305 * sizeof(std::string_view));
+    // characters of the words: 1800 of "number" and 790 digits, 15 of the others
+    ASSERT_EQUAL(stats.word_storage_words.payload_bytes, 2605u);
+    ASSERT(stats.term_dictionary.payload_bytes > 0);
+    ASSERT(stats.inverted_index.payload_bytes >= 1000 * sizeof(double));
+    ASSERT(stats.document_data.payload_bytes >= 1000 * sizeof(int));
+    ASSERT_EQUAL(stats.word_frequencies.payload_bytes, 1000 * 6 * sizeof(search_server_index::TermCount));
+    ASSERT(stats.word_frequencies.overhead_bytes > 0);
+    
+    const search_server_index::MemoryUsage heap_usage = stats.GetHeapUsage();
+    ASSERT_EQUAL(heap_usage.GetTotalBytes(), heap_usage.payload_bytes + heap_usage.overhead_bytes);
+    ASSERT(heap_usage.GetTotalBytes() > stats.inverted_index.GetTotalBytes() + stats.word_frequencies.GetTotalBytes());
+    
+    // purged postings are freed
+    for (int document_id = 0; document_id < 1000; document_id += 2) {
+        server.RemoveDocument(document_id);
+    }
+    
+    server.CompactSegments();
+    
+    ASSERT(server.GetMemoryStats().inverted_index.payload_bytes < stats.inverted_index.payload_bytes);
+    ASSERT(server.GetMemoryStats().word_frequencies.payload_bytes < stats.word_frequencies.payload_bytes);
+    
+    // slots of the removed documents are given back
+    ASSERT_EQUAL(server.GetMemoryStats().removed_documents.payload_bytes, 0u);
+    ASSERT(server.GetMemoryStats().document_data.payload_bytes < stats.document_data.payload_bytes);
+    
+    // postings of a loaded server stay in the mapped file
+    const std::string path = "/tmp/search_server_test_"s + std::to_string(getpid()) + ".snapshot"s;
+    server.SaveSnapshot(path);
+    
+    const SearchServer loaded_server = SearchServer::LoadSnapshot(path);
+    const SearchServer::MemoryStats loaded_stats = loaded_server.GetMemoryStats();
+    
+    ASSERT(loaded_stats.mapped_snapshot_bytes > 0);
+    ASSERT_EQUAL(loaded_stats.word_storage_words.GetTotalBytes(), 0u);
+    ASSERT(loaded_stats.inverted_index.payload_bytes < server.GetMemoryStats().inverted_index.payload_bytes);
+    
+    std::remove(path.c_str());
+}
+
 void TestSearchServer() {
     RUN_TEST(TestStopWordsExclusion);
+    RUN_TEST(TestStopWordSetMatchesSet);
     RUN_TEST(TestAddedDocumentsCanBeFound);
     RUN_TEST(TestMinusWordsExcludeDocuments);
     RUN_TEST(TestMatchDocumentResults);
@@ -466,15 +2376,44 @@ void TestSearchServer() {
     RUN_TEST(TestRelevanceCalculation);
     RUN_TEST(TestSearchNonExistentWord);
     RUN_TEST(TestSplitIntoWordsEscapesSpaces);
+    RUN_TEST(TestWordScanMatchesScalarScan);
+    RUN_TEST(TestWordRangeMatchesScalarScan);
+    RUN_TEST(TestControlCharsAreFoundWhileSplitting);
     RUN_TEST(TestAddDocumentWithRepeatingId);
     RUN_TEST(TestAddDocumentWithNegativeId);
     RUN_TEST(TestAddDocumentWithSpecialSymbol);
     RUN_TEST(TestDoubleMinusWord);
     RUN_TEST(TestQueryWithSpecialSymbol);
     RUN_TEST(TestEmptyMinusWord);
+    RUN_TEST(TestDoubleSpacesInQueryAreAccepted);
+    RUN_TEST(TestQueryErrorsAreNotShared);
+    RUN_TEST(TestQueryErrorDoesNotDependOnPolicy);
     RUN_TEST(TestIteratingOverSearchServer);
     RUN_TEST(TestGetWordFrequencies);
     RUN_TEST(TestDeletingDocument);
     RUN_TEST(TestRemoveDuplicates);
+    RUN_TEST(TestPostingListKeepsDocumentsSorted);
+    RUN_TEST(TestPostingListRejectsCorruptedPostings);
+    RUN_TEST(TestReaddingRemovedDocumentId);
+    RUN_TEST(TestParallelFindTopDocumentsMatchesSequential);
+    RUN_TEST(TestMaxResultDocumentCount);
+    RUN_TEST(TestMaxScoreQueryModeMatchesExhaustive);
+    RUN_TEST(TestInverseDocumentFrequencyFollowsDocumentChanges);
+    RUN_TEST(TestRemovedWordsAreReclaimed);
+    RUN_TEST(TestSlotsOfRemovedDocumentsAreGivenBack);
+    RUN_TEST(TestWordFrequenciesStayBoundedUnderChurn);
+    RUN_TEST(TestWordStorageKeepsViewsStable);
+    RUN_TEST(TestSegmentedIndexMatchesSingleSegment);
+    RUN_TEST(TestCompactionPurgesRemovedDocuments);
+    RUN_TEST(TestAddDocumentsMatchesSequentialInsertion);
+    RUN_TEST(TestConcurrentReadersDuringWrites);
+    RUN_TEST(TestShardedSearchServerMatchesSingleServer);
+    RUN_TEST(TestRemoteShardedSearchServerMatchesSingleServer);
+    RUN_TEST(TestShardProcessServesRemoteServer);
+    RUN_TEST(TestSnapshotRoundTrip);
+    RUN_TEST(TestCorruptedSnapshotIsRejectedOrSafe);
+    RUN_TEST(TestDurableSearchServerRecoversChanges);
+    RUN_TEST(TestMemoryStatsFollowChanges);
+    RUN_TEST(TestKeptDocumentTextsAreReturned);
 }
 
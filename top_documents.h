@@ -0,0 +1,71 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+#include "document.h"
+
+namespace search_server_index {
+
+// relevances closer than this are equal and documents are ordered by rating
+static constexpr double kRelevanceAccuracy = 1e-6;
+
+inline bool IsMoreRelevant(const Document& left, const Document& right) {
+    if (std::abs(left.relevance - right.relevance) < kRelevanceAccuracy) {
+        return left.rating > right.rating;
+    }
+
+    return left.relevance > right.relevance;
+}
+
+// keeps the max_count most relevant of the pushed documents
+// documents are stored in a heap with the least relevant kept document on top
+class TopDocuments {
+public:
+    explicit TopDocuments(int max_count): max_count_(std::max(max_count, 0)) {}
+
+    void Push(const Document& document) {
+        if (static_cast<int>(documents_.size()) < max_count_) {
+            documents_.push_back(document);
+            std::push_heap(documents_.begin(), documents_.end(), IsMoreRelevant);
+            return;
+        }
+
+        if (max_count_ == 0 || !IsMoreRelevant(document, documents_.front())) {
+            return;
+        }
+
+        std::pop_heap(documents_.begin(), documents_.end(), IsMoreRelevant);
+        documents_.back() = document;
+        std::push_heap(documents_.begin(), documents_.end(), IsMoreRelevant);
+    }
+
+    void Merge(const TopDocuments& other) {
+        for (const Document& document : other.documents_) {
+            Push(document);
+        }
+    }
+
+    bool IsFull() const {
+        return max_count_ > 0 && static_cast<int>(documents_.size()) == max_count_;
+    }
+
+    // least relevant of the kept documents, there must be at least one
+    const Document& GetLeastRelevant() const {
+        return documents_.front();
+    }
+
+    // most relevant documents go first
+    std::vector<Document> Extract() {
+        std::sort_heap(documents_.begin(), documents_.end(), IsMoreRelevant);
+        return std::move(documents_);
+    }
+
+private:
+    int max_count_;
+    std::vector<Document> documents_;
+};
+
+} // namespace search_server_index
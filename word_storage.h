@@ -1,40 +1,238 @@
 #pragma once
 
-#include <list>
-#include <set>
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <memory>
 #include <string>
 #include <string_view>
+#include <unordered_map>
 #include <utility>
+#include <vector>
+
+#include "memory_usage.h"
 
 namespace search_server_storage_container {
 
+// interns words into large chunks of characters, so a word costs no heap allocation of its own
+// view of a stored word stays valid until the word is erased, chunks are never moved
+// space of erased words is reused by later words of the same size
 class WordStorage {
 public:
-    void Insert(std::string word) {
-        if (string_views_.count(word) == 0) {
-            data_.push_back(std::move(word));
-            string_views_.insert(data_.back());
+    WordStorage() = default;
+
+    // views of the stored words point into the chunks of this storage
+    WordStorage(const WordStorage&) = delete;
+    WordStorage& operator=(const WordStorage&) = delete;
+
+    // the chunks move with their words, the moved-from storage is left empty and can be used again
+    WordStorage(WordStorage&& other) noexcept {
+        Swap(other);
+    }
+
+    WordStorage& operator=(WordStorage&& other) noexcept {
+        WordStorage moved(std::move(other));
+        Swap(moved);
+
+        return *this;
+    }
+
+    // returns view of the stored copy of the word
+    std::string_view Insert(std::string_view word) {
+        if ((word_count_ + 1) * 4 > index_.size() * 3) {
+            Rehash(std::max<size_t>(kMinIndexSize, index_.size() * 2));
+        }
+
+        std::string_view& entry = FindEntry(word);
+
+        if (entry.data() == nullptr) {
+            entry = Store(word);
+            ++word_count_;
+        }
+
+        return entry;
+    }
+
+    // does nothing if the word is not stored
+    void Erase(std::string_view word) {
+        if (word_count_ == 0) {
+            return;
+        }
+
+        std::string_view& entry = FindEntry(word);
+
+        if (entry.data() == nullptr) {
+            return;
+        }
+
+        Release(entry);
+        --word_count_;
+
+        // entries after the erased one are moved back, so no probe sequence passes a free entry
+        const size_t mask = index_.size() - 1;
+        size_t free_position = static_cast<size_t>(&entry - index_.data());
+        index_[free_position] = {};
+
+        for (size_t position = (free_position + 1) & mask; index_[position].data() != nullptr; position = (position + 1) & mask) {
+            const size_t home_position = std::hash<std::string_view>{}(index_[position]) & mask;
+
+            // the entry can move back if its home is not between the free entry and the entry itself
+            if (((position - home_position) & mask) >= ((position - free_position) & mask)) {
+                index_[free_position] = index_[position];
+                index_[position] = {};
+                free_position = position;
+            }
+        }
+    }
+
+    // returns nullptr if the word is not stored
+    const std::string_view* Find(std::string_view word) const {
+        if (word_count_ == 0) {
+            return nullptr;
+        }
+
+        const std::string_view& entry = const_cast<WordStorage*>(this)->FindEntry(word);
+
+        return entry.data() == nullptr ? nullptr : &entry;
+    }
+
+    size_t GetWordCount() const {
+        return word_count_;
+    }
+
+    // characters of the words, unused and erased space of the chunks
+    search_server_index::MemoryUsage GetWordsMemoryUsage() const {
+        search_server_index::MemoryUsage usage = search_server_index::GetVectorMemoryUsage(chunks_);
+        usage.overhead_bytes += usage.payload_bytes;
+        usage.payload_bytes = stored_bytes_;
+        usage.overhead_bytes += allocated_bytes_ - stored_bytes_;
+
+        usage.overhead_bytes += search_server_index::GetHashMapMemoryUsage(long_words_).GetTotalBytes();
+
+        for (const std::vector<char*>& free_places : free_places_by_size_) {
+            usage.overhead_bytes += search_server_index::GetVectorMemoryUsage(free_places).GetTotalBytes();
         }
+        usage.overhead_bytes += search_server_index::GetVectorMemoryUsage(free_places_by_size_).GetTotalBytes();
+
+        return usage;
+    }
+
+    // hash index of the views of the words, free entries are overhead
+    search_server_index::MemoryUsage GetViewsMemoryUsage() const {
+        return {word_count_ * sizeof(std::string_view), (index_.size() - word_count_) * sizeof(std::string_view)};
     }
 
-    void Insert(std::string_view word) {
-        if (string_views_.count(word) == 0) {
-            data_.emplace_back(word);
-            string_views_.insert(data_.back());
+private:
+    static constexpr size_t kChunkSize = 64 * 1024;
+    static constexpr size_t kLongWordSize = kChunkSize / 4;
+    static constexpr size_t kMinIndexSize = 64;
+
+    // open addressing with linear probing, size of the index is a power of two and free entries have no data
+    std::string_view& FindEntry(std::string_view word) {
+        const size_t mask = index_.size() - 1;
+
+        for (size_t position = std::hash<std::string_view>{}(word) & mask;; position = (position + 1) & mask) {
+            std::string_view& entry = index_[position];
+
+            if (entry.data() == nullptr || entry == word) {
+                return entry;
+            }
         }
     }
 
-    std::set<std::string_view>::const_iterator Find(std::string_view word) {
-        return string_views_.find(word);
+    void Rehash(size_t index_size) {
+        std::vector<std::string_view> old_index(index_size);
+        old_index.swap(index_);
+
+        for (const std::string_view word : old_index) {
+            if (word.data() != nullptr) {
+                FindEntry(word) = word;
+            }
+        }
     }
 
-    auto end() {
-        return string_views_.end();
+    // words of at least kLongWordSize characters get allocations of their own, so the chunks are not wasted
+    std::string_view Store(std::string_view word) {
+        // an empty word still needs an address to tell its entry from a free one
+        const size_t size = std::max<size_t>(word.size(), 1);
+
+        char* place = nullptr;
+
+        if (size >= kLongWordSize) {
+            std::unique_ptr<char[]> long_word = std::make_unique<char[]>(size);
+            place = long_word.get();
+
+            long_words_.emplace(place, std::move(long_word));
+            allocated_bytes_ += size;
+        } else if (size < free_places_by_size_.size() && !free_places_by_size_[size].empty()) {
+            place = free_places_by_size_[size].back();
+            free_places_by_size_[size].pop_back();
+        } else {
+            if (size > chunk_free_size_) {
+                chunks_.push_back(std::make_unique<char[]>(kChunkSize));
+                allocated_bytes_ += kChunkSize;
+
+                chunk_free_begin_ = chunks_.back().get();
+                chunk_free_size_ = kChunkSize;
+            }
+
+            place = chunk_free_begin_;
+            chunk_free_begin_ += size;
+            chunk_free_size_ -= size;
+        }
+
+        std::memcpy(place, word.data(), word.size());
+        stored_bytes_ += word.size();
+
+        return {place, word.size()};
+    }
+
+    void Swap(WordStorage& other) noexcept {
+        std::swap(chunks_, other.chunks_);
+        std::swap(chunk_free_begin_, other.chunk_free_begin_);
+        std::swap(chunk_free_size_, other.chunk_free_size_);
+        std::swap(free_places_by_size_, other.free_places_by_size_);
+        std::swap(long_words_, other.long_words_);
+        std::swap(allocated_bytes_, other.allocated_bytes_);
+        std::swap(stored_bytes_, other.stored_bytes_);
+        std::swap(index_, other.index_);
+        std::swap(word_count_, other.word_count_);
+    }
+
+    void Release(std::string_view word) {
+        const size_t size = std::max<size_t>(word.size(), 1);
+        char* place = const_cast<char*>(word.data());
+
+        stored_bytes_ -= word.size();
+
+        if (size >= kLongWordSize) {
+            long_words_.erase(place);
+            allocated_bytes_ -= size;
+            return;
+        }
+
+        if (size >= free_places_by_size_.size()) {
+            free_places_by_size_.resize(size + 1);
+        }
+
+        free_places_by_size_[size].push_back(place);
     }
 
 private:
-    std::set<std::string_view> string_views_;
-    std::list<std::string> data_;
+    std::vector<std::unique_ptr<char[]>> chunks_;
+    char* chunk_free_begin_ = nullptr;
+    size_t chunk_free_size_ = 0;
+
+    // places of erased words in the chunks, indexed by size
+    std::vector<std::vector<char*>> free_places_by_size_;
+
+    std::unordered_map<const char*, std::unique_ptr<char[]>> long_words_;
+
+    size_t allocated_bytes_ = 0;
+    size_t stored_bytes_ = 0;
+
+    std::vector<std::string_view> index_;
+    size_t word_count_ = 0;
 };
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,276 @@
+#include "write_ahead_log.h"
+
+#include <array>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "index_snapshot.h"
+
+using namespace std::literals;
+
+namespace {
+
+// CRC-32 with the reflected polynomial 0xEDB88320
+uint32_t ComputeChecksum(std::string_view data) {
+    static const std::array<uint32_t, 256> table = [] {
+        std::array<uint32_t, 256> table{};
+
+        for (uint32_t i = 0; i < table.size(); ++i) {
+            uint32_t value = i;
+
+            for (int bit = 0; bit < 8; ++bit) {
+                value = value & 1 ? 0xEDB88320u ^ (value >> 1) : value >> 1;
+            }
+
+            table[i] = value;
+        }
+
+        return table;
+    }();
+
+    uint32_t checksum = ~0u;
+    for (const char c : data) {
+        checksum = table[(checksum ^ static_cast<uint8_t>(c)) & 0xFF] ^ (checksum >> 8);
+    }
+
+    return ~checksum;
+}
+
+void AppendUint32(std::string& output, uint32_t value) {
+    for (int shift = 0; shift < 32; shift += 8) {
+        output.push_back(static_cast<char>(value >> shift & 0xFF));
+    }
+}
+
+uint32_t ReadUint32(const char* data) {
+    uint32_t value = 0;
+
+    for (int i = 0; i < 4; ++i) {
+        value |= static_cast<uint32_t>(static_cast<uint8_t>(data[i])) << (8 * i);
+    }
+
+    return value;
+}
+
+void WriteAll(int file, const char* data, size_t size) {
+    while (size > 0) {
+        const ssize_t written = write(file, data, size);
+
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            throw std::runtime_error("failed to write the log: "s + std::strerror(errno));
+        }
+
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+}
+
+// a new file is durable only when its directory entry is
+void SyncDirectory(const std::string& path) {
+    const size_t separator = path.rfind('/');
+    const std::string directory = separator == std::string::npos ? "."s : separator == 0 ? "/"s : path.substr(0, separator);
+
+    const int directory_file = open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+    if (directory_file >= 0) {
+        fsync(directory_file);
+        close(directory_file);
+    }
+}
+
+} // namespace
+
+WriteAheadLog::WriteAheadLog(const std::string& path) {
+    file_ = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+
+    if (file_ < 0) {
+        throw std::runtime_error("failed to open the log "s + path + ": "s + std::strerror(errno));
+    }
+
+    struct stat file_status;
+    if (fstat(file_, &file_status) < 0) {
+        const std::string error = std::strerror(errno);
+        close(file_);
+
+        throw std::runtime_error("failed to open the log "s + path + ": "s + error);
+    }
+
+    if (file_status.st_size == 0) {
+        try {
+            WriteAll(file_, kMagic, sizeof(kMagic));
+        } catch (...) {
+            close(file_);
+            throw;
+        }
+
+        fdatasync(file_);
+        SyncDirectory(path);
+    }
+}
+
+WriteAheadLog::~WriteAheadLog() {
+    close(file_);
+}
+
+uint64_t WriteAheadLog::Append(std::string_view record) {
+    // the checksum is computed before taking the lock, so concurrent writers do not wait for it
+    std::string header;
+    AppendUint32(header, static_cast<uint32_t>(record.size()));
+    AppendUint32(header, ComputeChecksum(record));
+
+    const std::lock_guard guard(mutex_);
+
+    buffer_ += header;
+    buffer_.append(record);
+
+    return ++appended_sequence_number_;
+}
+
+void WriteAheadLog::WaitDurable(uint64_t sequence_number) {
+    std::unique_lock lock(mutex_);
+
+    while (durable_sequence_number_ < sequence_number) {
+        if (has_failed_) {
+            throw std::runtime_error("the log could not be written"s);
+        }
+
+        if (is_syncing_) {
+            durable_condition_.wait(lock);
+            continue;
+        }
+
+        // this writer syncs the records of all the writers that have appended so far
+        is_syncing_ = true;
+
+        std::string buffer;
+        buffer.swap(buffer_);
+        const uint64_t last_sequence_number = appended_sequence_number_;
+
+        lock.unlock();
+
+        bool is_written = true;
+        try {
+            WriteAll(file_, buffer.data(), buffer.size());
+
+            if (fdatasync(file_) < 0) {
+                throw std::runtime_error("failed to sync the log: "s + std::strerror(errno));
+            }
+        } catch (...) {
+            is_written = false;
+        }
+
+        lock.lock();
+
+        is_syncing_ = false;
+
+        if (is_written) {
+            durable_sequence_number_ = last_sequence_number;
+        } else {
+            // records after a failed write could follow a torn one, so nothing is written any more
+            has_failed_ = true;
+        }
+
+        durable_condition_.notify_all();
+    }
+} // WaitDurable
+
+void WriteAheadLog::Replay(const std::string& path, const std::function<void(const std::vector<std::string_view>&)>& function) {
+    if (access(path.c_str(), F_OK) != 0) {
+        return;
+    }
+
+    size_t valid_size = 0;
+    size_t file_size = 0;
+
+    {
+        const search_server_index::MappedFile file(path);
+        const char* data = file.GetData();
+        file_size = file.GetSize();
+
+        // the log could be created and not written before the crash
+        if (file_size < sizeof(kMagic)) {
+            valid_size = 0;
+        } else if (std::memcmp(data, kMagic, sizeof(kMagic)) != 0) {
+            throw std::runtime_error("file "s + path + " is not a log"s);
+        } else {
+            std::vector<std::string_view> records;
+            size_t offset = sizeof(kMagic);
+
+            while (file_size - offset >= 8) {
+                const uint32_t size = ReadUint32(data + offset);
+
+                if (size > file_size - offset - 8) {
+                    break;
+                }
+
+                const std::string_view record(data + offset + 8, size);
+
+                if (ReadUint32(data + offset + 4) != ComputeChecksum(record)) {
+                    break;
+                }
+
+                records.push_back(record);
+                offset += 8 + size;
+            }
+
+            valid_size = offset;
+
+            function(records);
+        }
+    }
+
+    // new records must not follow the torn one
+    if (valid_size < file_size && truncate(path.c_str(), static_cast<off_t>(valid_size)) < 0) {
+        throw std::runtime_error("failed to truncate the log "s + path + ": "s + std::strerror(errno));
+    }
+} // Replay
+
+void WriteAheadLog::Create(const std::string& path, const std::vector<std::string_view>& records) {
+    const std::string temporary_path = path + ".tmp"s;
+
+    std::string data(kMagic, sizeof(kMagic));
+    for (const std::string_view record : records) {
+        AppendUint32(data, static_cast<uint32_t>(record.size()));
+        AppendUint32(data, ComputeChecksum(record));
+        data.append(record);
+    }
+
+    const int file = open(temporary_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+    if (file < 0) {
+        throw std::runtime_error("failed to create the log "s + temporary_path + ": "s + std::strerror(errno));
+    }
+
+    try {
+        WriteAll(file, data.data(), data.size());
+
+        if (fdatasync(file) < 0) {
+            throw std::runtime_error("failed to sync the log: "s + std::strerror(errno));
+        }
+    } catch (...) {
+        close(file);
+        std::remove(temporary_path.c_str());
+        throw;
+    }
+
+    close(file);
+
+    if (std::rename(temporary_path.c_str(), path.c_str()) != 0) {
+        const std::string error = std::strerror(errno);
+        std::remove(temporary_path.c_str());
+
+        throw std::runtime_error("failed to replace the log "s + path + ": "s + error);
+    }
+
+    SyncDirectory(path);
+} // Create
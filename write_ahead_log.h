@@ -0,0 +1,62 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// append only log of records with group commit
+// a record is appended to the buffer in memory and becomes durable when a writer waiting for it writes the buffer and syncs the file,
+// records appended by other writers meanwhile are written by the same write and sync
+// the file starts with kMagic, every record is its 4 byte length, 4 byte checksum and the payload
+class WriteAheadLog {
+public:
+    // opens the log for appending, creates it if there is none
+    // throws std::runtime_error if the file can not be opened
+    explicit WriteAheadLog(const std::string& path);
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    ~WriteAheadLog();
+
+public:
+    // returns the sequence number of the record, the record is not durable yet
+    uint64_t Append(std::string_view record);
+
+    // returns when the record with the sequence number and all the records before it are synced to disk
+    // throws std::runtime_error if the log could not be written, the log is unusable after that
+    void WaitDurable(uint64_t sequence_number);
+
+    // calls function with all the complete records of the log in order, the views are valid during the call
+    // a torn record at the end, left by a crash in the middle of a write, and everything after it are cut off the file
+    // nothing is called if there is no log
+    // throws std::runtime_error if the file is not a log
+    static void Replay(const std::string& path, const std::function<void(const std::vector<std::string_view>&)>& function);
+
+    // puts a synced log with the records in place of the file at the path, a crash leaves the old log or the new one
+    // the file must not be open for appending
+    // throws std::runtime_error if the log can not be written
+    static void Create(const std::string& path, const std::vector<std::string_view>& records);
+
+private:
+    static constexpr char kMagic[8] = {'S', 'S', 'W', 'A', 'L', '0', '0', '1'};
+
+private:
+    int file_ = -1;
+
+    std::mutex mutex_;
+    std::condition_variable durable_condition_;
+
+    // records appended and not written yet
+    std::string buffer_;
+    uint64_t appended_sequence_number_ = 0;
+    uint64_t durable_sequence_number_ = 0;
+
+    // one of the waiting writers writes and syncs the buffer at a time
+    bool is_syncing_ = false;
+    bool has_failed_ = false;
+};